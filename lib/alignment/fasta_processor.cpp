@@ -29,18 +29,59 @@ bool FastaProcessor::FromFile (const std::string fn, SequenceSet& aln)
         LOG_WARN << "FASTA file '" << fn << "' does not exist.";
         return false;
     }
-    return FromString(FileRead(fn), aln);
+
+    if (InputStream::IsStreamFile(fn)) {
+        InputStream stream;
+        if (!stream.OpenFile(fn)) {
+            return false;
+        }
+        return FromStream(stream, aln);
+    }
+
+    InputSource source;
+    if (!source.OpenFile(fn)) {
+        return false;
+    }
+    return FromSource(source, aln);
 }
 
 /**
  * @brief
  */
 bool FastaProcessor::FromString (const std::string& fs, SequenceSet& aln)
+{
+    InputSource source;
+    source.OpenString(fs);
+    return FromSource(source, aln);
+}
+
+/**
+ * @brief
+ */
+bool FastaProcessor::FromSource (const InputSource& source, SequenceSet& aln)
 {
     // do stepwise lexing
     FastaLexer lexer;
-    lexer.ProcessString(fs, true);
+    lexer.ProcessSource(source, true);
+    return FromLexer(lexer, aln);
+}
 
+/**
+ * @brief
+ */
+bool FastaProcessor::FromStream (InputStream& stream, SequenceSet& aln)
+{
+    // do stepwise lexing
+    FastaLexer lexer;
+    lexer.ProcessStream(stream, true);
+    return FromLexer(lexer, aln);
+}
+
+/**
+ * @brief
+ */
+bool FastaProcessor::FromLexer (FastaLexer& lexer, SequenceSet& aln)
+{
     // basic checks
     if (lexer.empty()) {
         LOG_INFO << "FASTA document is empty.";
@@ -58,8 +99,8 @@ bool FastaProcessor::FromString (const std::string& fs, SequenceSet& aln)
     it.ConsumeWithTail(0);
     it.ProduceWithHead(0);
 
-    std::string        label;
-    std::ostringstream seq;
+    std::string label;
+    std::string seq;
 
     // process all sequences
     while (it != lexer.end()) {
@@ -68,19 +109,18 @@ bool FastaProcessor::FromString (const std::string& fs, SequenceSet& aln)
             LOG_WARN << "FASTA sequence does not start with '>' at " << it->at();
             return false;
         }
-        label = it->value();
+        label.assign(it->data(), it->size());
         ++it;
 
-        // parse sequence
-        seq.str("");
+        // parse sequence. the lines are appended without copying the tokens.
         seq.clear();
         while (it != lexer.end() && it->IsSymbol()) {
-            seq << it->value();
+            seq.append(it->data(), it->size());
             ++it;
         }
 
         // add to alignment
-        Sequence* nseq = new Sequence(label, seq.str());
+        Sequence* nseq = new Sequence(label, seq);
         aln.sequences.push_back(nseq);
 
         // there are no other lexer tokens than tag and symbol for fasta files!
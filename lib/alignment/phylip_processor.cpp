@@ -41,18 +41,59 @@ bool PhylipProcessor::FromFile (const std::string  fn, SequenceSet& aln)
         LOG_WARN << "Phylip file '" << fn << "' does not exist.";
         return false;
     }
-    return FromString(FileRead(fn), aln);
+
+    if (InputStream::IsStreamFile(fn)) {
+        InputStream stream;
+        if (!stream.OpenFile(fn)) {
+            return false;
+        }
+        return FromStream(stream, aln);
+    }
+
+    InputSource source;
+    if (!source.OpenFile(fn)) {
+        return false;
+    }
+    return FromSource(source, aln);
 }
 
 /**
  * @brief
  */
 bool PhylipProcessor::FromString (const std::string& fs, SequenceSet& aln)
+{
+    InputSource source;
+    source.OpenString(fs);
+    return FromSource(source, aln);
+}
+
+/**
+ * @brief
+ */
+bool PhylipProcessor::FromSource (const InputSource& source, SequenceSet& aln)
 {
     // do stepwise lexing
     PhylipLexer lexer;
-    lexer.ProcessString(fs, true);
+    lexer.ProcessSource(source, true);
+    return FromLexer(lexer, aln);
+}
 
+/**
+ * @brief
+ */
+bool PhylipProcessor::FromStream (InputStream& stream, SequenceSet& aln)
+{
+    // do stepwise lexing
+    PhylipLexer lexer;
+    lexer.ProcessStream(stream, true);
+    return FromLexer(lexer, aln);
+}
+
+/**
+ * @brief
+ */
+bool PhylipProcessor::FromLexer (PhylipLexer& lexer, SequenceSet& aln)
+{
     // basic checks
     if (lexer.empty()) {
         LOG_INFO << "Phylip document is empty.";
@@ -11,6 +11,8 @@
 #include <assert.h>
 #include <string>
 
+#include "utils/input_source.hpp"
+#include "utils/input_stream.hpp"
 #include "utils/lexer.hpp"
 
 namespace genesis {
@@ -60,8 +62,10 @@ public:
 
     static size_t label_length;
 
-    static bool FromFile   (const std::string  fn, SequenceSet& aln);
-    static bool FromString (const std::string& fs, SequenceSet& aln);
+    static bool FromFile   (const std::string  fn,     SequenceSet& aln);
+    static bool FromString (const std::string& fs,     SequenceSet& aln);
+    static bool FromSource (const InputSource& source, SequenceSet& aln);
+    static bool FromStream (InputStream&       stream, SequenceSet& aln);
 
     // ---------------------------------------------------------------------
     //     Printing
@@ -70,6 +74,10 @@ public:
     static bool ToFile   (const std::string fn, const SequenceSet& aln);
     static void ToString (std::string& fs,      const SequenceSet& aln);
     static std::string ToString (               const SequenceSet& aln);
+
+protected:
+
+    static bool FromLexer (PhylipLexer& lexer, SequenceSet& aln);
 };
 
 } // namespace genesis
@@ -0,0 +1,421 @@
+/**
+ * @brief Implementation of Bplace Processor functions.
+ *
+ * @file
+ * @ingroup placement
+ */
+
+#include "placement/bplace_processor.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "placement/placement_map.hpp"
+#include "tree/newick_processor.hpp"
+#include "utils/input_source.hpp"
+#include "utils/logging.hpp"
+#include "utils/utils.hpp"
+
+namespace genesis {
+
+const uint32_t BplaceProcessor::kByteOrder;
+
+/**
+ * @brief Returns the version number of the binary format that this class writes.
+ */
+std::string BplaceProcessor::GetVersion ()
+{
+    return "1";
+}
+
+/**
+ * @brief Checks whether the version of the binary format works with this parser.
+ */
+bool BplaceProcessor::CheckVersion (const std::string version)
+{
+    return version == "1";
+}
+
+// =============================================================================
+//     Parsing
+// =============================================================================
+
+/**
+ * @brief Reads a file in the binary format into a PlacementMap object.
+ *
+ * On systems that support it, the file is mapped into memory instead of being read into a buffer,
+ * see InputSource.
+ *
+ * Returns true iff successful.
+ */
+bool BplaceProcessor::FromFile (const std::string& fn, PlacementMap& placements)
+{
+    if (!FileExists(fn)) {
+        LOG_WARN << "Bplace file '" << fn << "' does not exist.";
+        return false;
+    }
+
+    InputSource source;
+    if (!source.OpenFile(fn)) {
+        return false;
+    }
+    if (source.empty()) {
+        LOG_WARN << "Bplace file '" << fn << "' is empty.";
+        return false;
+    }
+    return FromMemory(source.data(), source.size(), placements);
+}
+
+/**
+ * @brief Parses a string containing data in the binary format into a PlacementMap object.
+ *
+ * Returns true iff successful.
+ */
+bool BplaceProcessor::FromString (const std::string& bplace, PlacementMap& placements)
+{
+    return FromMemory(bplace.data(), bplace.size(), placements);
+}
+
+/**
+ * @brief Parses a buffer of `size` bytes containing data in the binary format into a PlacementMap
+ * object.
+ *
+ * The buffer does not need to be aligned. All offsets and sizes are checked against the buffer
+ * size, so that corrupted data is reported instead of being read out of bounds.
+ *
+ * Returns true iff successful.
+ */
+bool BplaceProcessor::FromMemory (const char* data, const size_t size, PlacementMap& placements)
+{
+    placements.clear();
+
+    // read and check the header
+    Header header;
+    if (size < sizeof(Header)) {
+        LOG_WARN << "Bplace data is too short to contain a header.";
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(Header));
+    if (std::memcmp(header.magic, "BPLACE\0\0", 8) != 0) {
+        LOG_WARN << "Bplace data does not start with the correct identifier.";
+        return false;
+    }
+    if (header.byte_order != kByteOrder) {
+        LOG_WARN << "Bplace data was written on a machine with different byte order.";
+        return false;
+    }
+    if (!CheckVersion(std::to_string(header.version))) {
+        LOG_WARN << "Bplace data has version '" << header.version << "', however this parser "
+                 << "is written for version " << GetVersion() << " of the format.";
+        return false;
+    }
+
+    // get the positions of all columns
+    size_t pos = sizeof(Header);
+    const char* tree_col;
+    const char* pqry_place_col;
+    const char* pqry_name_col;
+    const char* edge_num_col;
+    const char* parsimony_col;
+    const char* likelihood_col;
+    const char* like_weight_ratio_col;
+    const char* proximal_length_col;
+    const char* pendant_length_col;
+    const char* multiplicity_col;
+    const char* name_offset_col;
+    const char* name_col;
+    const char* metadata_offset_col;
+    const char* metadata_col;
+
+    const size_t pqry_count  = header.pquery_count;
+    const size_t place_count = header.placement_count;
+    const size_t name_count  = header.name_count;
+    const size_t meta_count  = header.metadata_count;
+    if (
+        pqry_count  >= size || place_count >= size ||
+        name_count  >= size || meta_count  >= size ||
+        !ReadColumn<char>    (data, size, pos, header.tree_size, tree_col)                 ||
+        !ReadColumn<uint64_t>(data, size, pos, pqry_count + 1,   pqry_place_col)           ||
+        !ReadColumn<uint64_t>(data, size, pos, pqry_count + 1,   pqry_name_col)            ||
+        !ReadColumn<int32_t> (data, size, pos, place_count,      edge_num_col)             ||
+        !ReadColumn<int32_t> (data, size, pos, place_count,      parsimony_col)            ||
+        !ReadColumn<double>  (data, size, pos, place_count,      likelihood_col)           ||
+        !ReadColumn<double>  (data, size, pos, place_count,      like_weight_ratio_col)    ||
+        !ReadColumn<double>  (data, size, pos, place_count,      proximal_length_col)      ||
+        !ReadColumn<double>  (data, size, pos, place_count,      pendant_length_col)       ||
+        !ReadColumn<double>  (data, size, pos, name_count,       multiplicity_col)         ||
+        !ReadColumn<uint64_t>(data, size, pos, name_count + 1,   name_offset_col)          ||
+        !ReadColumn<char>    (data, size, pos, header.names_size, name_col)                ||
+        !ReadColumn<uint64_t>(data, size, pos, 2 * meta_count + 1, metadata_offset_col)    ||
+        !ReadColumn<char>    (data, size, pos, header.metadata_size, metadata_col)
+    ) {
+        LOG_WARN << "Bplace data is truncated or contains invalid sizes.";
+        return false;
+    }
+
+    // check that the offsets are valid, so that we do not need to check them again later.
+    auto check_offsets = [] (const char* col, const size_t count, const size_t total) {
+        if (ReadValue<uint64_t>(col, 0) != 0 || ReadValue<uint64_t>(col, count) != total) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (ReadValue<uint64_t>(col, i) > ReadValue<uint64_t>(col, i + 1)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    if (
+        !check_offsets(pqry_place_col,      pqry_count,     place_count)        ||
+        !check_offsets(pqry_name_col,       pqry_count,     name_count)         ||
+        !check_offsets(name_offset_col,     name_count,     header.names_size)  ||
+        !check_offsets(metadata_offset_col, 2 * meta_count, header.metadata_size)
+    ) {
+        LOG_WARN << "Bplace data contains invalid offsets.";
+        return false;
+    }
+
+    // read the tree and create the index from edge nums to the edges.
+    if (!NewickProcessor::FromString(std::string(tree_col, header.tree_size), placements.tree)) {
+        LOG_WARN << "Bplace data does not contain a valid Newick tree.";
+        return false;
+    }
+    if (!placements.UpdateEdgeNumIndex()) {
+        LOG_WARN << "Bplace data contains an invalid tree.";
+        return false;
+    }
+
+    // create the pqueries, placements and names.
+    for (size_t p = 0; p < pqry_count; ++p) {
+        Pquery* pqry = placements.AddPquery();
+
+        const size_t place_end = ReadValue<uint64_t>(pqry_place_col, p + 1);
+        for (size_t i = ReadValue<uint64_t>(pqry_place_col, p); i < place_end; ++i) {
+            PqueryPlacement* place   = placements.AddPlacement(pqry);
+            place->edge_num          = ReadValue<int32_t>(edge_num_col,          i);
+            place->parsimony         = ReadValue<int32_t>(parsimony_col,         i);
+            place->likelihood        = ReadValue<double> (likelihood_col,        i);
+            place->like_weight_ratio = ReadValue<double> (like_weight_ratio_col, i);
+            place->proximal_length   = ReadValue<double> (proximal_length_col,   i);
+            place->pendant_length    = ReadValue<double> (pendant_length_col,    i);
+
+            place->edge = placements.EdgeByNum(place->edge_num);
+            if (!place->edge) {
+                LOG_WARN << "Bplace data contains a placement with edge num '" << place->edge_num
+                         << "', which is not marked in the given tree as an edge num.";
+                return false;
+            }
+            place->edge->placements.push_back(place);
+        }
+
+        const size_t name_end = ReadValue<uint64_t>(pqry_name_col, p + 1);
+        for (size_t i = ReadValue<uint64_t>(pqry_name_col, p); i < name_end; ++i) {
+            const size_t begin = ReadValue<uint64_t>(name_offset_col, i);
+            const size_t end   = ReadValue<uint64_t>(name_offset_col, i + 1);
+
+            PqueryName* name   = placements.AddName(pqry);
+            name->name         = std::string(name_col + begin, end - begin);
+            name->multiplicity = ReadValue<double>(multiplicity_col, i);
+        }
+    }
+
+    // read the metadata, which is stored as alternating keys and values.
+    for (size_t i = 0; i < 2 * meta_count; i += 2) {
+        const size_t key_begin = ReadValue<uint64_t>(metadata_offset_col, i);
+        const size_t val_begin = ReadValue<uint64_t>(metadata_offset_col, i + 1);
+        const size_t val_end   = ReadValue<uint64_t>(metadata_offset_col, i + 2);
+        placements.metadata[std::string(metadata_col + key_begin, val_begin - key_begin)]
+            = std::string(metadata_col + val_begin, val_end - val_begin);
+    }
+
+    return true;
+}
+
+// =============================================================================
+//     Printing
+// =============================================================================
+
+/**
+ * @brief Writes a PlacementMap to a file in the binary format.
+ *
+ * If the file already exists, the function does not overwrite it.
+ */
+bool BplaceProcessor::ToFile (const std::string fn, const PlacementMap& placements)
+{
+    if (FileExists(fn)) {
+        LOG_WARN << "Bplace file '" << fn << "' already exist. Will not overwrite it.";
+        return false;
+    }
+
+    std::string bs;
+    ToString(bs, placements);
+
+    std::ofstream outfile(fn, std::ios::binary);
+    if (!outfile.good()) {
+        LOG_WARN << "Cannot write to file '" << fn << "'.";
+        return false;
+    }
+    outfile.write(bs.data(), bs.size());
+    return outfile.good();
+}
+
+/**
+ * @brief Stores a PlacementMap in the binary format in a string.
+ */
+void BplaceProcessor::ToString (std::string& bplace, const PlacementMap& placements)
+{
+    bplace = ToString(placements);
+}
+
+/**
+ * @brief Returns a string containing a PlacementMap in the binary format.
+ */
+std::string BplaceProcessor::ToString (const PlacementMap& placements)
+{
+    // write the tree with full precision, so that the branch lengths are not changed.
+    NewickProcessor::print_names          = true;
+    NewickProcessor::print_branch_lengths = true;
+    NewickProcessor::print_comments       = false;
+    NewickProcessor::print_tags           = true;
+    int old_precision = NewickProcessor::precision;
+    NewickProcessor::precision = 17;
+    std::string tree = NewickProcessor::ToString(placements.tree);
+    NewickProcessor::precision = old_precision;
+
+    // collect the columns of the placements and names.
+    std::vector<uint64_t> pqry_place_offsets (1, 0);
+    std::vector<uint64_t> pqry_name_offsets  (1, 0);
+    std::vector<int32_t>  edge_nums;
+    std::vector<int32_t>  parsimonies;
+    std::vector<double>   likelihoods;
+    std::vector<double>   like_weight_ratios;
+    std::vector<double>   proximal_lengths;
+    std::vector<double>   pendant_lengths;
+    std::vector<double>   multiplicities;
+    std::vector<uint64_t> name_offsets       (1, 0);
+    std::string           names;
+
+    const size_t place_count = placements.PlacementCount();
+    pqry_place_offsets.reserve(placements.pqueries.size() + 1);
+    pqry_name_offsets.reserve(placements.pqueries.size() + 1);
+    edge_nums.reserve(place_count);
+    parsimonies.reserve(place_count);
+    likelihoods.reserve(place_count);
+    like_weight_ratios.reserve(place_count);
+    proximal_lengths.reserve(place_count);
+    pendant_lengths.reserve(place_count);
+
+    for (const Pquery* pqry : placements.pqueries) {
+        for (const PqueryPlacement* place : pqry->placements) {
+            edge_nums.push_back(place->edge_num);
+            parsimonies.push_back(place->parsimony);
+            likelihoods.push_back(place->likelihood);
+            like_weight_ratios.push_back(place->like_weight_ratio);
+            proximal_lengths.push_back(place->proximal_length);
+            pendant_lengths.push_back(place->pendant_length);
+        }
+        for (const PqueryName* name : pqry->names) {
+            multiplicities.push_back(name->multiplicity);
+            names += name->name;
+            name_offsets.push_back(names.size());
+        }
+        pqry_place_offsets.push_back(edge_nums.size());
+        pqry_name_offsets.push_back(multiplicities.size());
+    }
+
+    // collect the metadata as alternating keys and values.
+    std::vector<uint64_t> metadata_offsets   (1, 0);
+    std::string           metadata;
+    for (const auto& meta_pair : placements.metadata) {
+        metadata += meta_pair.first;
+        metadata_offsets.push_back(metadata.size());
+        metadata += meta_pair.second;
+        metadata_offsets.push_back(metadata.size());
+    }
+
+    // fill the header.
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, "BPLACE\0\0", 8);
+    header.version         = std::stoi(GetVersion());
+    header.byte_order      = kByteOrder;
+    header.pquery_count    = placements.pqueries.size();
+    header.placement_count = edge_nums.size();
+    header.name_count      = multiplicities.size();
+    header.metadata_count  = placements.metadata.size();
+    header.tree_size       = tree.size();
+    header.names_size      = names.size();
+    header.metadata_size   = metadata.size();
+
+    // write everything, in the same order as it is read in FromMemory().
+    std::string bplace;
+    bplace.append(reinterpret_cast<const char*>(&header), sizeof(Header));
+    AppendColumn(bplace, tree.data(),               tree.size());
+    AppendColumn(bplace, pqry_place_offsets.data(), pqry_place_offsets.size());
+    AppendColumn(bplace, pqry_name_offsets.data(),  pqry_name_offsets.size());
+    AppendColumn(bplace, edge_nums.data(),          edge_nums.size());
+    AppendColumn(bplace, parsimonies.data(),        parsimonies.size());
+    AppendColumn(bplace, likelihoods.data(),        likelihoods.size());
+    AppendColumn(bplace, like_weight_ratios.data(), like_weight_ratios.size());
+    AppendColumn(bplace, proximal_lengths.data(),   proximal_lengths.size());
+    AppendColumn(bplace, pendant_lengths.data(),    pendant_lengths.size());
+    AppendColumn(bplace, multiplicities.data(),     multiplicities.size());
+    AppendColumn(bplace, name_offsets.data(),       name_offsets.size());
+    AppendColumn(bplace, names.data(),              names.size());
+    AppendColumn(bplace, metadata_offsets.data(),   metadata_offsets.size());
+    AppendColumn(bplace, metadata.data(),           metadata.size());
+    return bplace;
+}
+
+// =============================================================================
+//     Internal Members
+// =============================================================================
+
+/**
+ * @brief Appends `count` values to the buffer and pads it with zeros to a multiple of 8 bytes.
+ */
+template <typename T>
+void BplaceProcessor::AppendColumn (std::string& buffer, const T* data, const size_t count)
+{
+    buffer.append(reinterpret_cast<const char*>(data), count * sizeof(T));
+    buffer.append((8 - buffer.size() % 8) % 8, '\0');
+}
+
+/**
+ * @brief Sets `column` to the position `pos` in the data and advances `pos` past a column of
+ * `count` values and its padding.
+ *
+ * Returns false if the column does not fit into the data.
+ */
+template <typename T>
+bool BplaceProcessor::ReadColumn (
+    const char*  data,
+    const size_t size,
+    size_t&      pos,
+    const size_t count,
+    const char*& column
+) {
+    if (pos > size || count > (size - pos) / sizeof(T)) {
+        return false;
+    }
+    column = data + pos;
+    pos   += count * sizeof(T);
+    pos   += (8 - pos % 8) % 8;
+    return pos <= size;
+}
+
+/**
+ * @brief Returns the value at `index` of a column.
+ *
+ * The value is copied, because the column is not necessarily aligned in memory.
+ */
+template <typename T>
+T BplaceProcessor::ReadValue (const char* column, const size_t index)
+{
+    T value;
+    std::memcpy(&value, column + index * sizeof(T), sizeof(T));
+    return value;
+}
+
+} // namespace genesis
@@ -0,0 +1,112 @@
+#ifndef GENESIS_PLACEMENT_BPLACEPROCESSOR_H_
+#define GENESIS_PLACEMENT_BPLACEPROCESSOR_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup placement
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace genesis {
+
+// =============================================================================
+//     Forward Declarations
+// =============================================================================
+
+class PlacementMap;
+
+// =============================================================================
+//     Bplace Processor
+// =============================================================================
+
+/**
+ * @brief Parser and printer for a compact binary representation of a PlacementMap.
+ *
+ * Parsing Jplace documents is slow for large files, because all numbers are stored as text. This
+ * class provides a binary format instead, which can be used to store a PlacementMap between
+ * different steps of a pipeline. It is not meant as a replacement for the Jplace format, as it is
+ * not portable between machines with different byte order.
+ *
+ * The format stores the reference tree once as a Newick string with full precision, followed by
+ * the placements in columns (edge_num, likelihood, like_weight_ratio, proximal_length,
+ * pendant_length, parsimony). The assignment of placements and names to their pqueries is stored
+ * as offsets into those columns, and the names and the metadata are stored as string tables. All
+ * sections are aligned to 8 bytes.
+ *
+ * Reading a file maps it into memory (on systems that support this), so that the columns can be
+ * processed directly without reading the file into a buffer first.
+ *
+ * Converting a PlacementMap to the binary format and back is lossless. Thus, a Jplace file that is
+ * converted to the binary format yields the same PlacementMap as parsing the Jplace file directly.
+ */
+class BplaceProcessor
+{
+public:
+
+    static std::string GetVersion   ();
+    static bool        CheckVersion (const std::string version);
+
+    // ---------------------------------------------------------------------
+    //     Parsing
+    // ---------------------------------------------------------------------
+
+    static bool FromFile   (const std::string& fn,     PlacementMap& placements);
+    static bool FromString (const std::string& bplace, PlacementMap& placements);
+    static bool FromMemory (const char* data, const size_t size, PlacementMap& placements);
+
+    // ---------------------------------------------------------------------
+    //     Printing
+    // ---------------------------------------------------------------------
+
+    static bool        ToFile   (const std::string   fn,     const PlacementMap& placements);
+    static void        ToString (      std::string&  bplace, const PlacementMap& placements);
+    static std::string ToString (                            const PlacementMap& placements);
+
+    // ---------------------------------------------------------------------
+    //     Internal Members
+    // ---------------------------------------------------------------------
+
+protected:
+
+    /** @brief POD struct for the header at the beginning of the binary format. */
+    typedef struct {
+        char     magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+
+        uint64_t pquery_count;
+        uint64_t placement_count;
+        uint64_t name_count;
+        uint64_t metadata_count;
+
+        uint64_t tree_size;
+        uint64_t names_size;
+        uint64_t metadata_size;
+    } Header;
+
+    static const uint32_t kByteOrder = 0x01020304;
+
+    template <typename T>
+    static void AppendColumn (std::string& buffer, const T* data, const size_t count);
+
+    template <typename T>
+    static bool ReadColumn (
+        const char*  data,
+        const size_t size,
+        size_t&      pos,
+        const size_t count,
+        const char*& column
+    );
+
+    template <typename T>
+    static T ReadValue (const char* column, const size_t index);
+};
+
+} // namespace genesis
+
+#endif // include guard
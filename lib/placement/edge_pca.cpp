@@ -0,0 +1,519 @@
+/**
+ * @brief Implementation of Edge PCA class.
+ *
+ * @file
+ * @ingroup placement
+ */
+
+#include "placement/edge_pca.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <string>
+#include <utility>
+
+#ifdef PTHREADS
+#    include <thread>
+#endif
+
+#include "placement/placement_map.hpp"
+#include "utils/logging.hpp"
+#include "utils/options.hpp"
+
+namespace genesis {
+
+const size_t EdgePCA::kParallelBlockSize;
+const size_t EdgePCA::kMaxJacobiSweeps;
+
+// =============================================================================
+//     Constructor & Analysis
+// =============================================================================
+
+/**
+ * @brief Constructor that sets the default settings.
+ */
+EdgePCA::EdgePCA () :
+    components(5),
+    oversampling(10),
+    iterations(4),
+    seed(0),
+    sample_count_(0),
+    edge_count_(0)
+{}
+
+/**
+ * @brief Runs the edge PCA on the given samples.
+ *
+ * Any previous result is cleared. If the reference trees of the samples differ in topology, taxa
+ * names or edge_nums, a warning is issued and false is returned. If there are fewer samples or
+ * edges than #components, only as many components as possible are computed.
+ */
+bool EdgePCA::Run (const std::vector<const PlacementMap*>& maps)
+{
+    clear();
+    if (maps.empty()) {
+        return true;
+    }
+
+    if (!ImbalanceMatrix(maps)) {
+        LOG_WARN << "Edge PCA on different reference trees not possible.";
+        clear();
+        return false;
+    }
+
+    // get the number of vectors for the iteration, and the number of components that we can get.
+    const size_t width = std::min(components + oversampling, std::min(sample_count_, edge_count_));
+    const size_t count = std::min(components, width);
+    if (count == 0) {
+        return true;
+    }
+
+    // start with random vectors in edge space, and improve them by multiplying them with the
+    // covariance matrix, which is done via the centered sample matrix and its transpose.
+    std::mt19937_64 engine (seed);
+    std::normal_distribution<double> normal (0.0, 1.0);
+    Matrix<double> basis   (edge_count_,   width);
+    Matrix<double> samples (sample_count_, width);
+    for (size_t i = 0; i < edge_count_; ++i) {
+        for (size_t j = 0; j < width; ++j) {
+            basis(i, j) = normal(engine);
+        }
+    }
+    Orthonormalize(basis);
+
+    for (size_t it = 0; it < iterations; ++it) {
+        MultiplyRows(basis, samples);
+        Orthonormalize(samples);
+        MultiplyCols(samples, basis);
+        Orthonormalize(basis);
+    }
+    MultiplyRows(basis, samples);
+
+    // the covariance matrix restricted to the basis is small, so that we can solve it directly.
+    const double norm = sample_count_ > 1 ? 1.0 / (sample_count_ - 1) : 1.0;
+    Matrix<double> restricted (width, width, 0.0);
+    for (size_t i = 0; i < sample_count_; ++i) {
+        for (size_t j = 0; j < width; ++j) {
+            for (size_t k = j; k < width; ++k) {
+                restricted(j, k) += samples(i, j) * samples(i, k) * norm;
+            }
+        }
+    }
+    for (size_t j = 0; j < width; ++j) {
+        for (size_t k = 0; k < j; ++k) {
+            restricted(j, k) = restricted(k, j);
+        }
+    }
+
+    std::vector<double> values;
+    Matrix<double>      vectors;
+    SymmetricEigen(restricted, values, vectors);
+
+    // transform the eigenvectors back to edge space, and the samples onto the components.
+    eigenvalues_.assign(values.begin(), values.begin() + count);
+    eigenvectors_ = Matrix<double>(edge_count_,   count, 0.0);
+    projections_  = Matrix<double>(sample_count_, count, 0.0);
+    for (size_t c = 0; c < count; ++c) {
+        for (size_t i = 0; i < edge_count_; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                eigenvectors_(i, c) += basis(i, j) * vectors(j, c);
+            }
+        }
+        for (size_t i = 0; i < sample_count_; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                projections_(i, c) += samples(i, j) * vectors(j, c);
+            }
+        }
+
+        // the sign of an eigenvector is arbitrary. make the largest entry positive, so that the
+        // result does not depend on the random start vectors.
+        size_t max_i = 0;
+        for (size_t i = 1; i < edge_count_; ++i) {
+            if (std::abs(eigenvectors_(i, c)) > std::abs(eigenvectors_(max_i, c))) {
+                max_i = i;
+            }
+        }
+        if (eigenvectors_(max_i, c) < 0.0) {
+            for (size_t i = 0; i < edge_count_; ++i) {
+                eigenvectors_(i, c) = -eigenvectors_(i, c);
+            }
+            for (size_t i = 0; i < sample_count_; ++i) {
+                projections_(i, c) = -projections_(i, c);
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Clears the result of the analysis. The settings are kept.
+ */
+void EdgePCA::clear()
+{
+    sample_count_ = 0;
+    edge_count_   = 0;
+    rows_         = SparseMatrix();
+    cols_         = SparseMatrix();
+    means_.clear();
+
+    eigenvalues_.clear();
+    eigenvectors_ = Matrix<double>();
+    projections_  = Matrix<double>();
+}
+
+// =============================================================================
+//     Imbalance Matrix
+// =============================================================================
+
+/**
+ * @brief Calculates the imbalance vectors of all samples, shifted by +1, and stores them as the
+ * rows and columns of the sparse sample matrix, together with their mean.
+ *
+ * Returns false if the trees of the samples differ in topology, taxa names or edge_nums.
+ */
+bool EdgePCA::ImbalanceMatrix (const std::vector<const PlacementMap*>& maps)
+{
+    // store the structure of the first tree in postorder, without the root. all trees are then
+    // traversed in the same order, and compared to this.
+    const PlacementTree& ref_tree = maps[0]->tree;
+    std::vector<size_t>      ref_edges;
+    std::vector<size_t>      ref_nodes;
+    std::vector<size_t>      ref_parents;
+    std::vector<int>         ref_ranks;
+    std::vector<int>         ref_edge_nums;
+    std::vector<std::string> ref_names;
+    for (
+        PlacementTree::ConstIteratorPostorder it = ref_tree.BeginPostorder();
+        it != ref_tree.EndPostorder();
+        ++it
+    ) {
+        if (it.IsLastIteration()) {
+            continue;
+        }
+        ref_edges.push_back(it.Edge()->Index());
+        ref_nodes.push_back(it.Node()->Index());
+        ref_parents.push_back(it.Edge()->PrimaryNode()->Index());
+        ref_ranks.push_back(it.Node()->Rank());
+        ref_edge_nums.push_back(it.Edge()->edge_num);
+        ref_names.push_back(it.Node()->name);
+    }
+
+    sample_count_ = maps.size();
+    edge_count_   = ref_tree.EdgeCount();
+
+    std::vector<std::vector<std::pair<size_t, double>>> sample_rows (maps.size());
+    std::vector<char> compatible (maps.size(), true);
+    ParallelFor(maps.size(), [&] (size_t s) {
+        const PlacementTree& tree = maps[s]->tree;
+        if (tree.NodeCount() != ref_tree.NodeCount() || tree.EdgeCount() != edge_count_) {
+            compatible[s] = false;
+            return;
+        }
+
+        // collect the masses of the subtrees in a postorder traversal, using the node indices of
+        // the first tree. the imbalance of an edge is below - (1 - below - own), so the shifted
+        // value is 2 * below + own.
+        const double total = maps[s]->PlacementMass();
+        std::vector<double> below (tree.NodeCount(), 0.0);
+        std::vector<std::pair<size_t, double>>& row = sample_rows[s];
+        size_t pos = 0;
+        for (
+            PlacementTree::ConstIteratorPostorder it = tree.BeginPostorder();
+            it != tree.EndPostorder();
+            ++it
+        ) {
+            if (it.IsLastIteration()) {
+                continue;
+            }
+            if (
+                it.Node()->Rank()   != ref_ranks[pos]     ||
+                it.Edge()->edge_num != ref_edge_nums[pos] ||
+                it.Node()->name     != ref_names[pos]
+            ) {
+                compatible[s] = false;
+                return;
+            }
+
+            double own = 0.0;
+            for (const PqueryPlacement* place : it.Edge()->placements) {
+                own += place->like_weight_ratio;
+            }
+            own = total > 0.0 ? own / total : 0.0;
+
+            const double sub = below[ref_nodes[pos]];
+            below[ref_parents[pos]] += sub + own;
+            if (sub + own > 0.0) {
+                row.emplace_back(ref_edges[pos], 2.0 * sub + own);
+            }
+            ++pos;
+        }
+        std::sort(row.begin(), row.end());
+    });
+    if (std::find(compatible.begin(), compatible.end(), false) != compatible.end()) {
+        return false;
+    }
+
+    // store the rows, and count the entries of each column.
+    means_.assign(edge_count_, 0.0);
+    cols_.offsets.assign(edge_count_ + 1, 0);
+    rows_.offsets.push_back(0);
+    for (const std::vector<std::pair<size_t, double>>& row : sample_rows) {
+        for (const std::pair<size_t, double>& entry : row) {
+            rows_.indices.push_back(entry.first);
+            rows_.values.push_back(entry.second);
+            means_[entry.first] += entry.second / sample_count_;
+            ++cols_.offsets[entry.first + 1];
+        }
+        rows_.offsets.push_back(rows_.indices.size());
+    }
+
+    // store the columns, which is the transposed of the rows.
+    for (size_t e = 0; e < edge_count_; ++e) {
+        cols_.offsets[e + 1] += cols_.offsets[e];
+    }
+    std::vector<size_t> fill (cols_.offsets.begin(), cols_.offsets.end() - 1);
+    cols_.indices.resize(rows_.indices.size());
+    cols_.values.resize(rows_.values.size());
+    for (size_t s = 0; s < sample_count_; ++s) {
+        for (size_t k = rows_.offsets[s]; k < rows_.offsets[s + 1]; ++k) {
+            size_t pos = fill[rows_.indices[k]]++;
+            cols_.indices[pos] = s;
+            cols_.values[pos]  = rows_.values[k];
+        }
+    }
+    return true;
+}
+
+// =============================================================================
+//     Linear Algebra
+// =============================================================================
+
+/**
+ * @brief Calls the given function for all indices from 0 to `n - 1`, distributed over
+ * Options::number_of_threads threads if compiled with `PTHREADS`.
+ *
+ * The indices are processed in blocks of kParallelBlockSize. The function has to be safe to be
+ * called concurrently for different indices.
+ */
+void EdgePCA::ParallelFor (const size_t n, const std::function<void (size_t)>& body)
+{
+#ifdef PTHREADS
+
+    std::atomic<size_t> next_block (0);
+    auto worker = [&] () {
+        size_t begin;
+        while ((begin = next_block.fetch_add(kParallelBlockSize)) < n) {
+            for (size_t i = begin; i < std::min(begin + kParallelBlockSize, n); ++i) {
+                body(i);
+            }
+        }
+    };
+
+    // start all threads and wait for them to finish.
+    const size_t blocks      = (n + kParallelBlockSize - 1) / kParallelBlockSize;
+    const size_t num_threads = std::min(
+        static_cast<size_t>(std::max(Options::number_of_threads, 1u)), blocks
+    );
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+#else
+
+    // do all the work in one "thread".
+    for (size_t i = 0; i < n; ++i) {
+        body(i);
+    }
+
+#endif
+}
+
+/**
+ * @brief Multiplies the centered sample matrix with a matrix in edge space, giving a matrix in
+ * sample space.
+ */
+void EdgePCA::MultiplyRows (const Matrix<double>& in, Matrix<double>& out) const
+{
+    assert(in.Rows() == edge_count_ && out.Rows() == sample_count_ && in.Cols() == out.Cols());
+    const size_t width = in.Cols();
+
+    // centering subtracts the product of the mean with the input from each row.
+    std::vector<double> shift (width, 0.0);
+    for (size_t e = 0; e < edge_count_; ++e) {
+        for (size_t j = 0; j < width; ++j) {
+            shift[j] += means_[e] * in(e, j);
+        }
+    }
+
+    ParallelFor(sample_count_, [&] (size_t s) {
+        for (size_t j = 0; j < width; ++j) {
+            out(s, j) = -shift[j];
+        }
+        for (size_t k = rows_.offsets[s]; k < rows_.offsets[s + 1]; ++k) {
+            const size_t e = rows_.indices[k];
+            const double v = rows_.values[k];
+            for (size_t j = 0; j < width; ++j) {
+                out(s, j) += v * in(e, j);
+            }
+        }
+    });
+}
+
+/**
+ * @brief Multiplies the transposed centered sample matrix with a matrix in sample space, giving
+ * a matrix in edge space.
+ */
+void EdgePCA::MultiplyCols (const Matrix<double>& in, Matrix<double>& out) const
+{
+    assert(in.Rows() == sample_count_ && out.Rows() == edge_count_ && in.Cols() == out.Cols());
+    const size_t width = in.Cols();
+
+    // centering subtracts the mean times the sum of the input from each row.
+    std::vector<double> sums (width, 0.0);
+    for (size_t s = 0; s < sample_count_; ++s) {
+        for (size_t j = 0; j < width; ++j) {
+            sums[j] += in(s, j);
+        }
+    }
+
+    ParallelFor(edge_count_, [&] (size_t e) {
+        for (size_t j = 0; j < width; ++j) {
+            out(e, j) = -means_[e] * sums[j];
+        }
+        for (size_t k = cols_.offsets[e]; k < cols_.offsets[e + 1]; ++k) {
+            const size_t s = cols_.indices[k];
+            const double v = cols_.values[k];
+            for (size_t j = 0; j < width; ++j) {
+                out(e, j) += v * in(s, j);
+            }
+        }
+    });
+}
+
+/**
+ * @brief Orthonormalizes the columns of a matrix using the modified Gram-Schmidt process.
+ *
+ * Columns that are linearly dependent on the previous ones are set to zero.
+ */
+void EdgePCA::Orthonormalize (Matrix<double>& mat)
+{
+    for (size_t j = 0; j < mat.Cols(); ++j) {
+        double before = 0.0;
+        for (size_t i = 0; i < mat.Rows(); ++i) {
+            before += mat(i, j) * mat(i, j);
+        }
+
+        for (size_t k = 0; k < j; ++k) {
+            double dot = 0.0;
+            for (size_t i = 0; i < mat.Rows(); ++i) {
+                dot += mat(i, k) * mat(i, j);
+            }
+            for (size_t i = 0; i < mat.Rows(); ++i) {
+                mat(i, j) -= dot * mat(i, k);
+            }
+        }
+
+        double after = 0.0;
+        for (size_t i = 0; i < mat.Rows(); ++i) {
+            after += mat(i, j) * mat(i, j);
+        }
+        const double scale = (after > 1e-20 * before) ? 1.0 / std::sqrt(after) : 0.0;
+        for (size_t i = 0; i < mat.Rows(); ++i) {
+            mat(i, j) *= scale;
+        }
+    }
+}
+
+/**
+ * @brief Computes the eigenvalues and eigenvectors of a small symmetric matrix using the cyclic
+ * Jacobi eigenvalue algorithm.
+ *
+ * The matrix is destroyed in the process. The eigenvalues are returned in decreasing order, and
+ * the columns of `vectors` contain the corresponding eigenvectors.
+ */
+void EdgePCA::SymmetricEigen (
+    Matrix<double>&      mat,
+    std::vector<double>& values,
+    Matrix<double>&      vectors
+) {
+    const size_t n = mat.Rows();
+    Matrix<double> rot (n, n, 0.0);
+    for (size_t i = 0; i < n; ++i) {
+        rot(i, i) = 1.0;
+    }
+
+    for (size_t sweep = 0; sweep < kMaxJacobiSweeps; ++sweep) {
+        double off  = 0.0;
+        double diag = 0.0;
+        for (size_t p = 0; p < n; ++p) {
+            diag += mat(p, p) * mat(p, p);
+            for (size_t q = p + 1; q < n; ++q) {
+                off += mat(p, q) * mat(p, q);
+            }
+        }
+        if (off <= 1e-30 * diag) {
+            break;
+        }
+
+        // rotate each off-diagonal element to zero.
+        for (size_t p = 0; p < n; ++p) {
+            for (size_t q = p + 1; q < n; ++q) {
+                if (mat(p, q) == 0.0) {
+                    continue;
+                }
+                double theta = (mat(q, q) - mat(p, p)) / (2.0 * mat(p, q));
+                double t = (theta >= 0.0 ? 1.0 : -1.0)
+                         / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                double c = 1.0 / std::sqrt(t * t + 1.0);
+                double s = t * c;
+
+                for (size_t k = 0; k < n; ++k) {
+                    double kp = mat(k, p);
+                    double kq = mat(k, q);
+                    mat(k, p) = c * kp - s * kq;
+                    mat(k, q) = s * kp + c * kq;
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    double pk = mat(p, k);
+                    double qk = mat(q, k);
+                    mat(p, k) = c * pk - s * qk;
+                    mat(q, k) = s * pk + c * qk;
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    double kp = rot(k, p);
+                    double kq = rot(k, q);
+                    rot(k, p) = c * kp - s * kq;
+                    rot(k, q) = s * kp + c * kq;
+                }
+            }
+        }
+    }
+
+    // sort the eigenvalues and their vectors.
+    std::vector<size_t> order (n);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&] (size_t lhs, size_t rhs) {
+        return mat(lhs, lhs) > mat(rhs, rhs);
+    });
+
+    values.resize(n);
+    vectors = Matrix<double>(n, n);
+    for (size_t i = 0; i < n; ++i) {
+        values[i] = mat(order[i], order[i]);
+        for (size_t k = 0; k < n; ++k) {
+            vectors(k, i) = rot(k, order[i]);
+        }
+    }
+}
+
+} // namespace genesis
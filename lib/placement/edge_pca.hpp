@@ -0,0 +1,151 @@
+#ifndef GENESIS_PLACEMENT_EDGE_PCA_H_
+#define GENESIS_PLACEMENT_EDGE_PCA_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup placement
+ */
+
+#include <functional>
+#include <stddef.h>
+#include <vector>
+
+#include "utils/matrix.hpp"
+
+namespace genesis {
+
+// =============================================================================
+//     Forward Declarations
+// =============================================================================
+
+class PlacementMap;
+
+// =============================================================================
+//     Edge PCA
+// =============================================================================
+
+/**
+ * @brief Edge principal components analysis of samples of placements on a common reference tree.
+ *
+ * Edge PCA (Matsen and Evans, 2013) represents each sample by its imbalance vector: For each edge
+ * of the tree, the imbalance is the placement mass in the subtree below the edge (away from the
+ * root) minus the mass on the other side, using the masses normalized by the total mass of the
+ * sample. The mass on the edge itself is counted on neither side. The principal components of
+ * these vectors are the eigenvectors of their covariance matrix with the largest eigenvalues.
+ *
+ * Each edge whose subtree does not contain any placements has an imbalance of -1. Thus, the
+ * vectors are stored shifted by +1, which makes them sparse, as only edges on the paths from the
+ * placements to the root have non-zero values. The vectors are stored as rows and columns of a
+ * sparse matrix, and are centered implicitly when multiplying, so that the covariance matrix is
+ * never built. Its top eigenvectors are then computed via randomized subspace iteration
+ * (Halko et al., 2011), whose sparse matrix products are run using Options::number_of_threads
+ * threads if compiled with `PTHREADS`. The computation is controlled via the public members:
+ *
+ *   * #components: Number of principal components to compute.
+ *   * #oversampling: Number of additional vectors used in the iteration, for better accuracy.
+ *   * #iterations: Number of power iterations. More iterations give more accurate results for
+ *     samples whose eigenvalues decay slowly.
+ *   * #seed: Seed for the random start vectors.
+ *
+ * Use Run() to do the analysis. The eigenvectors are indexed by the Edge::Index() of the tree of
+ * the first sample.
+ */
+class EdgePCA
+{
+public:
+    // -----------------------------------------------------
+    //     Constructor & Analysis
+    // -----------------------------------------------------
+
+    EdgePCA ();
+
+    bool Run (const std::vector<const PlacementMap*>& maps);
+    void clear();
+
+    // -----------------------------------------------------
+    //     Accessors
+    // -----------------------------------------------------
+
+    /** @brief Returns the eigenvalues of the principal components, in decreasing order. */
+    inline const std::vector<double>& Eigenvalues() const
+    {
+        return eigenvalues_;
+    }
+
+    /**
+     * @brief Returns the principal components as a matrix with one row per edge of the tree and
+     * one column per component.
+     */
+    inline const Matrix<double>& Eigenvectors() const
+    {
+        return eigenvectors_;
+    }
+
+    /**
+     * @brief Returns the coordinates of the centered samples on the principal components, as a
+     * matrix with one row per sample and one column per component.
+     */
+    inline const Matrix<double>& Projections() const
+    {
+        return projections_;
+    }
+
+    // -----------------------------------------------------
+    //     Settings
+    // -----------------------------------------------------
+
+    size_t        components;
+    size_t        oversampling;
+    size_t        iterations;
+    unsigned long seed;
+
+    // -----------------------------------------------------
+    //     Internal Members
+    // -----------------------------------------------------
+
+protected:
+
+    /** @brief POD struct that stores a sparse matrix in compressed row or column format. */
+    typedef struct {
+        std::vector<size_t> offsets;
+        std::vector<size_t> indices;
+        std::vector<double> values;
+    } SparseMatrix;
+
+    static void ParallelFor (const size_t n, const std::function<void (size_t)>& body);
+
+    bool ImbalanceMatrix (const std::vector<const PlacementMap*>& maps);
+
+    void MultiplyRows (const Matrix<double>& in, Matrix<double>& out) const;
+    void MultiplyCols (const Matrix<double>& in, Matrix<double>& out) const;
+
+    static void Orthonormalize (Matrix<double>& mat);
+    static void SymmetricEigen (
+        Matrix<double>&      mat,
+        std::vector<double>& values,
+        Matrix<double>&      vectors
+    );
+
+    /** @brief Number of consecutive items that a thread of ParallelFor() processes at once. */
+    static const size_t kParallelBlockSize = 64;
+
+    /** @brief Maximal number of sweeps of the Jacobi eigenvalue algorithm. */
+    static const size_t kMaxJacobiSweeps = 100;
+
+    size_t              sample_count_;
+    size_t              edge_count_;
+
+    SparseMatrix        rows_;
+    SparseMatrix        cols_;
+    std::vector<double> means_;
+
+    std::vector<double> eigenvalues_;
+    Matrix<double>      eigenvectors_;
+    Matrix<double>      projections_;
+};
+
+} // namespace genesis
+
+#endif // include guard
@@ -0,0 +1,325 @@
+/**
+ * @brief Implementation of EMDProfile class.
+ *
+ * @file
+ * @ingroup placement
+ */
+
+#include "placement/emd_profile.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+
+#include "placement/placement_map.hpp"
+
+namespace genesis {
+
+// =============================================================================
+//     Constructor & Destructor
+// =============================================================================
+
+/**
+ * @brief Constructor that creates the profile of a PlacementMap. See Init() for details.
+ */
+EMDProfile::EMDProfile (const PlacementMap& map)
+{
+    Init(map);
+}
+
+/**
+ * @brief Creates the profile of a PlacementMap.
+ *
+ * Any previous content of the profile is cleared. The masses of the placements are normalized by
+ * the total mass of all placements of the map, as in PlacementMap::EMD().
+ */
+void EMDProfile::Init (const PlacementMap& map)
+{
+    clear();
+
+    // use the sum of masses as normalization factor for the masses.
+    double totalmass = map.PlacementMass();
+
+    // do a postorder traversal, so that the edges are stored in the order in which the EMD
+    // calculation moves the masses towards the root.
+    for (
+        PlacementTree::ConstIteratorPostorder it = map.tree.BeginPostorder();
+        it != map.tree.EndPostorder();
+        ++it
+    ) {
+        // the root does not have an edge towards the root. see PlacementMap::EMD() for details.
+        if (it.IsLastIteration()) {
+            continue;
+        }
+
+        child_counts_.push_back(it.Node()->Rank());
+        edge_nums_.push_back(it.Edge()->edge_num);
+        node_names_.push_back(it.Node()->name);
+        branch_lengths_.push_back(it.Edge()->branch_length);
+
+        // add the placements of the edge, then sort them by their position on the branch.
+        size_t begin = entries_.size();
+        for (const PqueryPlacement* place : it.Edge()->placements) {
+            pendant_distance_ += place->like_weight_ratio * place->pendant_length / totalmass;
+
+            Entry entry;
+            entry.proximal_length = place->proximal_length;
+            entry.mass            = place->like_weight_ratio / totalmass;
+            entries_.push_back(entry);
+        }
+        std::sort(
+            entries_.begin() + begin, entries_.end(),
+            [] (const Entry& lhs, const Entry& rhs) {
+                return lhs.proximal_length < rhs.proximal_length;
+            }
+        );
+        offsets_.push_back(begin);
+    }
+    offsets_.push_back(entries_.size());
+}
+
+/**
+ * @brief Clears all data of this profile.
+ */
+void EMDProfile::clear()
+{
+    child_counts_.clear();
+    edge_nums_.clear();
+    node_names_.clear();
+    branch_lengths_.clear();
+    offsets_.clear();
+    entries_.clear();
+    pendant_distance_ = 0.0;
+}
+
+/**
+ * @brief Collects the placement masses of each edge into `bins` many equally sized intervals.
+ *
+ * The mass of all placements in one interval of an edge is moved to the center of the interval, and
+ * stored as one entry. Thus, the profile afterwards contains at most `bins` entries per edge. This
+ * changes the EMD by at most half the length of an interval times the mass of the placements. If
+ * `bins` is zero, nothing is done.
+ */
+void EMDProfile::Discretize (const size_t bins)
+{
+    if (bins == 0) {
+        return;
+    }
+
+    std::vector<Entry>  entries;
+    std::vector<size_t> offsets;
+    entries.reserve(std::min(entries_.size(), EdgeCount() * bins));
+    offsets.reserve(offsets_.size());
+
+    for (size_t pos = 0; pos < EdgeCount(); ++pos) {
+        offsets.push_back(entries.size());
+        const double branch_length = branch_lengths_[pos];
+
+        // the entries are sorted by position, so entries of the same bin are adjacent.
+        for (size_t i = offsets_[pos]; i < offsets_[pos + 1]; ++i) {
+            size_t bin = 0;
+            if (branch_length > 0.0) {
+                double rel = std::max(entries_[i].proximal_length / branch_length, 0.0);
+                bin = std::min(static_cast<size_t>(rel * bins), bins - 1);
+            }
+            double position = (bin + 0.5) * branch_length / bins;
+
+            if (entries.size() > offsets.back() && entries.back().proximal_length == position) {
+                entries.back().mass += entries_[i].mass;
+            } else {
+                Entry entry;
+                entry.proximal_length = position;
+                entry.mass            = entries_[i].mass;
+                entries.push_back(entry);
+            }
+        }
+    }
+    offsets.push_back(entries.size());
+
+    entries_.swap(entries);
+    offsets_.swap(offsets);
+}
+
+/**
+ * @brief Returns the weighted average of two profiles.
+ *
+ * The masses of the left hand side profile are multiplied by `lhs_weight`, and the ones of the
+ * right hand side by `1 - lhs_weight`. The result is the profile of the sample that contains the
+ * placements of both samples with these masses. Placements of both profiles at the same position
+ * of an edge are combined into one entry. The tree data is taken from the left hand side profile.
+ *
+ * The profiles need to be Compatible(), which is not checked here.
+ */
+EMDProfile EMDProfile::Average (
+    const EMDProfile& lhs,
+    const EMDProfile& rhs,
+    const double      lhs_weight
+) {
+    assert(lhs.branch_lengths_.size() == rhs.branch_lengths_.size());
+    const double rhs_weight = 1.0 - lhs_weight;
+
+    EMDProfile res;
+    res.child_counts_     = lhs.child_counts_;
+    res.edge_nums_        = lhs.edge_nums_;
+    res.node_names_       = lhs.node_names_;
+    res.branch_lengths_   = lhs.branch_lengths_;
+    res.pendant_distance_ = lhs_weight * lhs.pendant_distance_ + rhs_weight * rhs.pendant_distance_;
+    res.offsets_.reserve(lhs.offsets_.size());
+    res.entries_.reserve(lhs.entries_.size() + rhs.entries_.size());
+
+    // merge the sorted entries of each edge.
+    for (size_t pos = 0; pos < lhs.branch_lengths_.size(); ++pos) {
+        res.offsets_.push_back(res.entries_.size());
+
+        size_t it_l = lhs.offsets_[pos];
+        size_t it_r = rhs.offsets_[pos];
+        while (it_l < lhs.offsets_[pos + 1] || it_r < rhs.offsets_[pos + 1]) {
+            bool take_l = it_r == rhs.offsets_[pos + 1] || (
+                it_l < lhs.offsets_[pos + 1] &&
+                lhs.entries_[it_l].proximal_length <= rhs.entries_[it_r].proximal_length
+            );
+
+            Entry entry;
+            if (take_l) {
+                entry.proximal_length = lhs.entries_[it_l].proximal_length;
+                entry.mass            = lhs.entries_[it_l].mass * lhs_weight;
+                ++it_l;
+            } else {
+                entry.proximal_length = rhs.entries_[it_r].proximal_length;
+                entry.mass            = rhs.entries_[it_r].mass * rhs_weight;
+                ++it_r;
+            }
+
+            if (
+                res.entries_.size() > res.offsets_.back() &&
+                res.entries_.back().proximal_length == entry.proximal_length
+            ) {
+                res.entries_.back().mass += entry.mass;
+            } else {
+                res.entries_.push_back(entry);
+            }
+        }
+    }
+    res.offsets_.push_back(res.entries_.size());
+
+    return res;
+}
+
+// =============================================================================
+//     Accessors
+// =============================================================================
+
+/**
+ * @brief Returns true iff the profiles were created from reference trees with identical topology,
+ * taxa names and edge_nums.
+ *
+ * Branch lengths are not checked, because usually those differ slightly.
+ */
+bool EMDProfile::Compatible (const EMDProfile& other) const
+{
+    return child_counts_ == other.child_counts_ &&
+           edge_nums_    == other.edge_nums_    &&
+           node_names_   == other.node_names_;
+}
+
+// =============================================================================
+//     Earth Movers Distance
+// =============================================================================
+
+/**
+ * @brief Calculates the Earth Movers Distance between two profiles, using a given buffer as
+ * intermediate storage.
+ *
+ * This is the same as EMD(lhs, rhs, with_pendant_length), but the buffer can be reused for
+ * repeated calls, so that no memory needs to be allocated. Also, in order to keep repeated calls
+ * cheap, this function does not check whether the profiles are Compatible(). This has to be done
+ * by the caller.
+ */
+double EMDProfile::EMD (
+    const EMDProfile&    lhs,
+    const EMDProfile&    rhs,
+    const bool           with_pendant_length,
+    std::vector<double>& buffer
+) {
+    assert(lhs.branch_lengths_.size() == rhs.branch_lengths_.size());
+
+    // keep track of the total resulting distance.
+    double distance = 0.0;
+    if (with_pendant_length) {
+        distance += lhs.pendant_distance_ + rhs.pendant_distance_;
+    }
+
+    // the buffer is used as a stack of the rest masses of the subtrees that were already
+    // processed. as the edges are stored in postorder, the top elements of the stack always
+    // belong to the children of the current node.
+    buffer.clear();
+
+    for (size_t pos = 0; pos < lhs.branch_lengths_.size(); ++pos) {
+        // collect the rest mass of the subtrees...
+        double cur_mass = 0.0;
+        for (size_t c = 0; c < lhs.child_counts_[pos]; ++c) {
+            assert(buffer.size() > 0);
+            cur_mass += buffer.back();
+            buffer.pop_back();
+        }
+
+        // ... and move it along the branch, starting at its lower end. the placements of both
+        // samples are sorted by their position, so we simply merge them from their ends, using
+        // positive mass for the left and negative mass for the right hand side.
+        double cur_pos = lhs.branch_lengths_[pos];
+        const Entry* it_l  = lhs.entries_.data() + lhs.offsets_[pos + 1];
+        const Entry* beg_l = lhs.entries_.data() + lhs.offsets_[pos];
+        const Entry* it_r  = rhs.entries_.data() + rhs.offsets_[pos + 1];
+        const Entry* beg_r = rhs.entries_.data() + rhs.offsets_[pos];
+        while (it_l != beg_l || it_r != beg_r) {
+            double next_pos;
+            double next_mass;
+            bool take_l = it_r == beg_r || (
+                it_l != beg_l && (it_l - 1)->proximal_length >= (it_r - 1)->proximal_length
+            );
+            if (take_l) {
+                --it_l;
+                next_pos  = it_l->proximal_length;
+                next_mass = +it_l->mass;
+            } else {
+                --it_r;
+                next_pos  = it_r->proximal_length;
+                next_mass = -it_r->mass;
+            }
+
+            distance += std::abs(cur_mass) * (cur_pos - next_pos);
+            cur_pos   = next_pos;
+            cur_mass += next_mass;
+        }
+
+        // finally, move the rest to the end of the branch and store its mass, so that it can be
+        // used for the nodes further up in the tree.
+        distance += std::abs(cur_mass) * cur_pos;
+        buffer.push_back(cur_mass);
+    }
+
+    return distance;
+}
+
+/**
+ * @brief Calculates the Earth Movers Distance between two profiles.
+ *
+ * The result is the same as the one of PlacementMap::EMD() for the maps that the profiles were
+ * created from. The branch lengths are taken from the left hand side profile. If the profiles are
+ * not Compatible(), -1.0 is returned.
+ */
+double EMDProfile::EMD (
+    const EMDProfile& lhs,
+    const EMDProfile& rhs,
+    const bool        with_pendant_length
+) {
+    if (!lhs.Compatible(rhs)) {
+        return -1.0;
+    }
+
+    std::vector<double> buffer;
+    buffer.reserve(lhs.branch_lengths_.size());
+    return EMD(lhs, rhs, with_pendant_length, buffer);
+}
+
+} // namespace genesis
@@ -0,0 +1,127 @@
+#ifndef GENESIS_PLACEMENT_EMD_PROFILE_H_
+#define GENESIS_PLACEMENT_EMD_PROFILE_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup placement
+ */
+
+#include <string>
+#include <vector>
+
+namespace genesis {
+
+// =============================================================================
+//     Forward Declarations
+// =============================================================================
+
+class PlacementMap;
+
+// =============================================================================
+//     EMD Profile
+// =============================================================================
+
+/**
+ * @brief Precomputed per-edge placement masses of one PlacementMap, used for fast repeated
+ * Earth Movers Distance calculations.
+ *
+ * The profile stores the edges of the reference tree in the order of a postorder traversal,
+ * together with the branch lengths and the number of children of the node at their lower end.
+ * For each edge, the placements are stored as (proximal_length, normalized mass) entries, which are
+ * sorted by their position once when creating the profile. The entries of all edges are stored in
+ * one contiguous array, with an offset per edge. Also, the contribution of the pendant lengths to
+ * the EMD is precomputed, as it does not depend on the other sample.
+ *
+ * The EMD between two profiles is then calculated by merging the sorted entries of each edge,
+ * without any further allocations. In the same way, two profiles can be combined into their
+ * weighted Average(), for example for clustering samples. Using Discretize(), the placements of
+ * each edge can be collected into a fixed number of bins, so that the size of the profiles, and
+ * thus the time needed for the EMD and averaging, does not depend on the number of placements.
+ */
+class EMDProfile
+{
+public:
+    // -----------------------------------------------------
+    //     Types
+    // -----------------------------------------------------
+
+    /** @brief POD struct that stores the position and normalized mass of one placement. */
+    typedef struct {
+        double proximal_length;
+        double mass;
+    } Entry;
+
+    // -----------------------------------------------------
+    //     Constructor & Destructor
+    // -----------------------------------------------------
+
+    EMDProfile () : pendant_distance_(0.0) {}
+    EMDProfile (const PlacementMap& map);
+
+    void Init (const PlacementMap& map);
+    void clear();
+
+    void Discretize (const size_t bins);
+
+    static EMDProfile Average (
+        const EMDProfile& lhs,
+        const EMDProfile& rhs,
+        const double      lhs_weight
+    );
+
+    // -----------------------------------------------------
+    //     Accessors
+    // -----------------------------------------------------
+
+    bool Compatible (const EMDProfile& other) const;
+
+    /** @brief Number of edges in the profile. */
+    inline size_t EdgeCount() const
+    {
+        return branch_lengths_.size();
+    }
+
+    /** @brief Number of placements in the profile. */
+    inline size_t PlacementCount() const
+    {
+        return entries_.size();
+    }
+
+    // -----------------------------------------------------
+    //     Earth Movers Distance
+    // -----------------------------------------------------
+
+    static double EMD (
+        const EMDProfile&    lhs,
+        const EMDProfile&    rhs,
+        const bool           with_pendant_length,
+        std::vector<double>& buffer
+    );
+
+    static double EMD (
+        const EMDProfile& lhs,
+        const EMDProfile& rhs,
+        const bool        with_pendant_length = true
+    );
+
+    // -----------------------------------------------------
+    //     Members
+    // -----------------------------------------------------
+
+protected:
+    std::vector<size_t>      child_counts_;
+    std::vector<int>         edge_nums_;
+    std::vector<std::string> node_names_;
+    std::vector<double>      branch_lengths_;
+
+    std::vector<size_t>      offsets_;
+    std::vector<Entry>       entries_;
+
+    double                   pendant_distance_;
+};
+
+} // namespace genesis
+
+#endif // include guard
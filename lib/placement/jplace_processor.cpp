@@ -7,6 +7,7 @@
 
 #include "placement/jplace_processor.hpp"
 
+#include <assert.h>
 #include <string>
 #include <vector>
 
@@ -16,6 +17,7 @@
 #include "utils/json_processor.hpp"
 #include "utils/logging.hpp"
 #include "utils/options.hpp"
+#include "utils/output_stream.hpp"
 #include "utils/utils.hpp"
 
 namespace genesis {
@@ -43,6 +45,9 @@ bool JplaceProcessor::CheckVersion (const std::string version)
 /**
  * @brief Reads a file and parses it as a Jplace document into a PlacementMap object.
  *
+ * The file is mapped into memory if possible, see InputSource. Compressed files and pipes are
+ * read as a stream instead, see InputStream.
+ *
  * Returns true iff successful.
  */
 bool JplaceProcessor::FromFile (const std::string& fn, PlacementMap& placements)
@@ -51,21 +56,95 @@ bool JplaceProcessor::FromFile (const std::string& fn, PlacementMap& placements)
         LOG_WARN << "Jplace file '" << fn << "' does not exist.";
         return false;
     }
-    return FromString(FileRead(fn), placements);
+
+    if (InputStream::IsStreamFile(fn)) {
+        InputStream stream;
+        if (!stream.OpenFile(fn)) {
+            return false;
+        }
+        return FromStream(stream, placements);
+    }
+
+    InputSource source;
+    if (!source.OpenFile(fn)) {
+        return false;
+    }
+    return FromSource(source, placements);
 }
 
 /**
  * @brief Parses a string as a Jplace document into a PlacementMap object.
  *
+ * The string is parsed directly from the JsonLexer tokens, without building a JsonDocument first.
+ * The pqueries are created while reading the "placements" array, so that large documents do not
+ * need to be held in memory twice. See FromLexer() for details.
+ *
  * Returns true iff successful.
  */
 bool JplaceProcessor::FromString (const std::string& jplace, PlacementMap& placements)
 {
-    JsonDocument doc;
-    if (!JsonProcessor::FromString(jplace, doc)) {
+    InputSource source;
+    source.OpenString(jplace);
+    return FromSource(source, placements);
+}
+
+/**
+ * @brief Parses the contents of an InputSource as a Jplace document into a PlacementMap object.
+ *
+ * See FromString() for details.
+ *
+ * Returns true iff successful.
+ */
+bool JplaceProcessor::FromSource (const InputSource& source, PlacementMap& placements)
+{
+    // do stepwise lexing
+    JsonLexer lexer;
+    lexer.ProcessSource(source, true);
+    return FromLexer(lexer, placements);
+}
+
+/**
+ * @brief Parses the contents of an InputStream as a Jplace document into a PlacementMap object.
+ *
+ * The stream is read in chunks while parsing, see Lexer::ProcessStream(). Thus, large or
+ * compressed files do not need to be held in memory as a whole. See FromString() for details.
+ *
+ * Returns true iff successful.
+ */
+bool JplaceProcessor::FromStream (InputStream& stream, PlacementMap& placements)
+{
+    // do stepwise lexing
+    JsonLexer lexer;
+    lexer.ProcessStream(stream, true);
+    return FromLexer(lexer, placements);
+}
+
+/**
+ * @brief Parses the tokens of a JsonLexer that was started in stepwise mode as a Jplace document
+ * into a PlacementMap object.
+ *
+ * Returns true iff successful.
+ */
+bool JplaceProcessor::FromLexer (JsonLexer& lexer, PlacementMap& placements)
+{
+    if (lexer.empty()) {
+        LOG_INFO << "Jplace document is empty.";
+        return false;
+    }
+    if (lexer.HasError()) {
+        LOG_WARN << "Lexing error at " << lexer.back().at()
+                 << " with message: " << lexer.back().value();
         return false;
     }
-    return FromDocument(doc, placements);
+
+    Lexer::iterator begin = lexer.begin();
+    Lexer::iterator end   = lexer.end();
+
+    // delete tailing tokens immediately, produce tokens in time (needed for stepwise lexing).
+    begin.ConsumeWithTail(0);
+    begin.ProduceWithHead(0);
+
+    return FromLexer(begin, end, placements);
 }
 
 /**
@@ -78,89 +157,27 @@ bool JplaceProcessor::FromDocument (const JsonDocument& doc, PlacementMap& place
     placements.clear();
 
     // check if the version is correct
-    JsonValue* val = doc.Get("version");
-    if (!val) {
-        LOG_WARN << "Jplace document does not contain a valid version number at key 'version'."
-                 << "Now continuing to parse in the hope that it still works.";
-    }
-    if (!CheckVersion(val->ToString())) {
-        LOG_WARN << "Jplace document has version '" << val->ToString() << "', however this parser "
-                 << "is written for version " << GetVersion() << " of the Jplace format. "
-                 << "Now continuing to parse in the hope that it still works.";
-    }
+    ProcessVersion(doc.Get("version"));
 
     // find and process the reference tree
-    val = doc.Get("tree");
-    if (!val || !val->IsString() || !NewickProcessor::FromString(val->ToString(), placements.tree)) {
-        LOG_WARN << "Jplace document does not contain a valid Newick tree at key 'tree'.";
+    if (!ProcessTree(doc.Get("tree"), placements)) {
         return false;
     }
 
-    // create a map from edge nums to the actual edge pointers, for later use when processing
-    // the pqueries. we do not use PlacementMap::EdgeNumMap() here, because we need to do extra
-    // checking for validity first!
-    std::unordered_map<int, PlacementTree::EdgeType*> edge_num_map;
-    for (
-        PlacementTree::ConstIteratorEdges it = placements.tree.BeginEdges();
-        it != placements.tree.EndEdges();
-        ++it
-    ) {
-        PlacementTree::EdgeType* edge = *it;
-        if (edge_num_map.count(edge->edge_num) > 0) {
-            LOG_WARN << "Jplace document contains a tree where the edge num tag '"
-                     << edge->edge_num << "' is used more than once.";
-            return false;
-        }
-        edge_num_map.emplace(edge->edge_num, edge);
-    }
-
     // get the field names and store them in array fields
-    val = doc.Get("fields");
-    if (!val || !val->IsArray()) {
-        LOG_WARN << "Jplace document does not contain field names at key 'fields'.";
-        return false;
-    }
-    JsonValueArray* fields_arr = JsonValueToArray(val);
     std::vector<std::string> fields;
-    bool has_edge_num = false;
-    for (JsonValue* fields_val : *fields_arr) {
-        if (!fields_val->IsString()) {
-            LOG_WARN << "Jplace document contains a value of type '" << fields_val->TypeToString()
-                     << "' instead of a string with a field name at key 'fields'.";
-            return false;
-        }
-
-        // check field validity
-        std::string field = fields_val->ToString();
-        if (field == "edge_num"      || field == "likelihood"     || field == "like_weight_ratio" ||
-            field == "distal_length" || field == "pendant_length" || field == "parsimony"
-        ) {
-            for (std::string fn : fields) {
-                if (fn == field) {
-                    LOG_WARN << "Jplace document contains field name '" << field << "' more than "
-                             << "once at key 'fields'.";
-                    return false;
-                }
-            }
-            fields.push_back(field);
-        } else {
-            LOG_WARN << "Jplace document contains a field name '" << field << "' "
-                     << "at key 'fields', which is not used by this parser and thus skipped.";
-        }
-        has_edge_num |= (field == "edge_num");
-    }
-    if (!has_edge_num) {
-        LOG_WARN << "Jplace document does not contain necessary field 'edge_num' at key 'fields'.";
+    if (!ProcessFields(doc.Get("fields"), fields)) {
         return false;
     }
 
     // find and process the pqueries
-    val = doc.Get("placements");
+    JsonValue* val = doc.Get("placements");
     if (!val || !val->IsArray()) {
         LOG_WARN << "Jplace document does not contain pqueries at key 'placements'.";
         return false;
     }
     JsonValueArray* placements_arr = JsonValueToArray(val);
+    std::vector<double> values;
     for (JsonValue* pqry_val : *placements_arr) {
         if (!pqry_val->IsObject()) {
             LOG_WARN << "Jplace document contains a value of type '" << pqry_val->TypeToString()
@@ -175,7 +192,7 @@ bool JplaceProcessor::FromDocument (const JsonDocument& doc, PlacementMap& place
         }
 
         // create new pquery
-        Pquery* pqry = new Pquery();
+        Pquery* pqry = placements.AddPquery();
 
         // process the placements and store them in the pquery
         JsonValueArray* pqry_p_arr = JsonValueToArray(pqry_obj->Get("p"));
@@ -191,141 +208,647 @@ bool JplaceProcessor::FromDocument (const JsonDocument& doc, PlacementMap& place
                 return false;
             }
 
-            // process all fields of the placement
-            PqueryPlacement* pqry_place = new PqueryPlacement();
+            // up to version 3 of the jplace specification, the p-fields in a jplace document
+            // only contain numbers (float or int), so we can do this check here once for all
+            // fields, instead of repetition for every field. if in the future there are fields
+            // with non-number type, this check has to go into the single field assignments.
+            values.clear();
             for (size_t i = 0; i < pqry_fields->size(); ++i) {
-                // up to version 3 of the jplace specification, the p-fields in a jplace document
-                // only contain numbers (float or int),so we can do this check here once for all
-                // fields, instead of repetition for everyfield. if in the future there are fields
-                // with non-number type, this check has to go into the single field assignments.
                 if (!pqry_fields->at(i)->IsNumber()) {
                     LOG_WARN << "Jplace document contains pquery where field " << fields[i]
                              << " is of type '" << pqry_fields->at(i)->TypeToString()
                              << "' instead of a number.";
                     return false;
                 }
+                values.push_back(JsonValueToNumber(pqry_fields->at(i))->value);
+            }
 
-                // switch on the field name to set the correct value
-                double pqry_place_val = JsonValueToNumber(pqry_fields->at(i))->value;
-                if        (fields[i] == "edge_num") {
-                    pqry_place->edge_num          = pqry_place_val;
-                    if (edge_num_map.count(pqry_place_val) == 0) {
-                        LOG_WARN << "Jplace document contains a pquery where field 'edge_num' "
-                                 << "has value '" << pqry_place_val << "', which is not marked "
-                                 << "in the given tree as an edge num.";
-                        return false;
-                    }
-                    pqry_place->edge = edge_num_map.at(pqry_place_val);
-                    pqry_place->edge->placements.push_back(pqry_place);
-                } else if (fields[i] == "likelihood") {
-                    pqry_place->likelihood        = pqry_place_val;
-                } else if (fields[i] == "like_weight_ratio") {
-                    pqry_place->like_weight_ratio = pqry_place_val;
-                } else if (fields[i] == "distal_length") {
-                    // the jplace format uses distal length, but we use proximal,
-                    // so we need to convert here.
-                    pqry_place->proximal_length   = pqry_place->edge->branch_length - pqry_place_val;
-                } else if (fields[i] == "pendant_length") {
-                    pqry_place->pendant_length    = pqry_place_val;
-                } else if (fields[i] == "parsimony") {
-                    pqry_place->parsimony         = pqry_place_val;
-                }
+            PqueryPlacement* pqry_place = placements.AddPlacement(pqry);
+            if (!ProcessPlacementFields(fields, values, placements, pqry_place)) {
+                return false;
             }
-            pqry_place->pquery = pqry;
-            pqry->placements.push_back(pqry_place);
         }
 
-        // check name/named multiplicity validity
-        if (pqry_obj->Has("n") && pqry_obj->Has("nm")) {
-            LOG_WARN << "Jplace document contains a pquery with both an 'n' and an 'nm' key.";
+        // process names and named multiplicities
+        if (!ProcessNames(pqry_obj->Get("n"), pqry_obj->Get("nm"), pqry, placements)) {
+            return false;
+        }
+    }
+
+    // check if there is metadata
+    ProcessMetadata(doc.Get("metadata"), placements);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//     Streaming
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Parses a Jplace document directly from the tokens of a JsonLexer.
+ *
+ * The iterator `ct` is advanced until it points to the token after the closing bracket of the
+ * document. All members of the document except "placements" are small, so they are parsed into
+ * JsonValue%s using JsonProcessor::ParseValue() and then processed the same way as in
+ * FromDocument(). The "placements" array however is processed token by token, see
+ * ParsePlacements().
+ *
+ * If the "tree" and the "fields" of the document are already known when reading the placements,
+ * those are finished immediately. Otherwise, the numbers of the placements are buffered and the
+ * placements are finished after the whole document was read, see ResolvePlacements(). This is
+ * needed because some programs (e.g., pplacer) write the "fields" at the end of the document. As
+ * the buffer only contains the plain numbers, this is still much cheaper than building a
+ * JsonDocument.
+ *
+ * Returns true iff successful.
+ */
+bool JplaceProcessor::FromLexer (
+    Lexer::iterator& ct,
+    Lexer::iterator& end,
+    PlacementMap&    placements
+) {
+    placements.clear();
+
+    StreamState state;
+    state.has_tree   = false;
+    state.has_fields = false;
+    bool has_version    = false;
+    bool has_placements = false;
+
+    if (ct == end || !ct->IsBracket('{')) {
+        LOG_WARN << "Jplace document does not start with JSON object opener '{'.";
+        return false;
+    }
+    ++ct;
+
+    while (ct != end && !ct->IsBracket('}')) {
+        // check for name string and delimiter colon
+        if (!ct->IsString()) {
+            LOG_WARN << "JSON object member does not start with name string at " << ct->at() << ".";
             return false;
         }
-        if (!pqry_obj->Has("n") && !pqry_obj->Has("nm")) {
-            LOG_WARN << "Jplace document contains a pquery with neither an 'n' nor an 'nm' key.";
+        std::string key = ct->value();
+        ++ct;
+        if (ct == end || !ct->IsOperator(':')) {
+            LOG_WARN << "JSON object member does not contain colon between name and value.";
             return false;
         }
+        ++ct;
+        if (ct == end) {
+            break;
+        }
 
-        // process names
-        if (pqry_obj->Has("n")) {
-            if (!pqry_obj->Get("n")->IsArray()) {
-                LOG_WARN << "Jplace document contains a pquery with key 'n' that is not array.";
+        if (key == "placements") {
+            if (!ParsePlacements(ct, end, state, placements)) {
+                return false;
+            }
+            has_placements = true;
+        } else {
+            JsonValue* value = nullptr;
+            if (!JsonProcessor::ParseValue(ct, end, value)) {
+                delete value;
                 return false;
             }
 
-            JsonValueArray* pqry_n_arr = JsonValueToArray(pqry_obj->Get("n"));
-            for (JsonValue* pqry_n_val : *pqry_n_arr) {
-                if (!pqry_n_val->IsString()) {
-                    LOG_WARN << "Jplace document contains a pquery where key 'n' has a "
-                             << "non-string field.";
-                    return false;
+            bool success = true;
+            if (key == "version") {
+                ProcessVersion(value);
+                has_version = true;
+            } else if (key == "tree") {
+                success = ProcessTree(value, placements);
+                state.has_tree = true;
+            } else if (key == "fields") {
+                success = ProcessFields(value, state.fields);
+                state.has_fields = true;
+            } else if (key == "metadata") {
+                ProcessMetadata(value, placements);
+            }
+            delete value;
+            if (!success) {
+                return false;
+            }
+        }
+
+        // check for end of object, leave if found
+        if (ct == end || ct->IsBracket('}')) {
+            break;
+        }
+
+        // check for delimiter comma (indicates that there are more members following)
+        if (!ct->IsOperator(',')) {
+            LOG_WARN << "JSON object does not contain comma between members at " << ct->at() << ".";
+            return false;
+        }
+        ++ct;
+    }
+
+    if (ct == end) {
+        LOG_WARN << "Jplace document ended unexpectedly.";
+        return false;
+    }
+    ++ct;
+    if (ct != end) {
+        LOG_WARN << "Jplace document contains more information after the closing bracket.";
+        return false;
+    }
+
+    // report missing members, in the same way as the document based parsing does.
+    if (!has_version) {
+        ProcessVersion(nullptr);
+    }
+    if (!state.has_tree) {
+        return ProcessTree(nullptr, placements);
+    }
+    if (!state.has_fields) {
+        return ProcessFields(nullptr, state.fields);
+    }
+    if (!has_placements) {
+        LOG_WARN << "Jplace document does not contain pqueries at key 'placements'.";
+        return false;
+    }
+
+    return ResolvePlacements(state, placements);
+}
+
+/**
+ * @brief Parses the "placements" array of a Jplace document from the lexer tokens and adds its
+ * pqueries to the PlacementMap.
+ */
+bool JplaceProcessor::ParsePlacements (
+    Lexer::iterator& ct,
+    Lexer::iterator& end,
+    StreamState&     state,
+    PlacementMap&    placements
+) {
+    if (ct == end || !ct->IsBracket('[')) {
+        LOG_WARN << "Jplace document does not contain pqueries at key 'placements'.";
+        return false;
+    }
+    ++ct;
+    if (ct != end && ct->IsBracket(']')) {
+        ++ct;
+        return true;
+    }
+
+    while (ct != end) {
+        if (!ct->IsBracket('{')) {
+            LOG_WARN << "Jplace document contains a value instead of an object with a pquery at "
+                     << "key 'placements' at " << ct->at() << ".";
+            return false;
+        }
+        ++ct;
+
+        // process the members of the pquery object.
+        Pquery*    pqry    = placements.AddPquery();
+        JsonValue* n_val   = nullptr;
+        JsonValue* nm_val  = nullptr;
+        bool       has_p   = false;
+        bool       success = true;
+        while (ct != end && !ct->IsBracket('}')) {
+            if (!ct->IsString()) {
+                LOG_WARN << "JSON object member does not start with name string at "
+                         << ct->at() << ".";
+                success = false;
+                break;
+            }
+            std::string key = ct->value();
+            ++ct;
+            if (ct == end || !ct->IsOperator(':')) {
+                LOG_WARN << "JSON object member does not contain colon between name and value.";
+                success = false;
+                break;
+            }
+            ++ct;
+            if (ct == end) {
+                break;
+            }
+
+            if (key == "p") {
+                success = ParsePqueryPlacements(ct, end, state, pqry, placements);
+                has_p   = true;
+            } else {
+                // names are processed after the whole pquery was read, because we need to check
+                // the presence of both keys. all other keys are not used and thus skipped.
+                JsonValue* value = nullptr;
+                success = JsonProcessor::ParseValue(ct, end, value);
+                if (key == "n" && !n_val) {
+                    n_val = value;
+                } else if (key == "nm" && !nm_val) {
+                    nm_val = value;
+                } else {
+                    delete value;
                 }
+            }
 
-                PqueryName* pqry_name   = new PqueryName();
-                pqry_name->name         = pqry_n_val->ToString();
-                pqry_name->multiplicity = 0.0;
-                pqry_name->pquery = pqry;
-                pqry->names.push_back(pqry_name);
+            if (!success || ct == end || ct->IsBracket('}')) {
+                break;
+            }
+            if (!ct->IsOperator(',')) {
+                LOG_WARN << "JSON object does not contain comma between members at "
+                         << ct->at() << ".";
+                success = false;
+                break;
             }
+            ++ct;
+        }
+
+        if (success && ct == end) {
+            LOG_WARN << "Jplace document ended unexpectedly.";
+            success = false;
+        }
+        if (success && !has_p) {
+            LOG_WARN << "Jplace document contains a pquery at key 'placements' that does not "
+                     << "contain an array of placements at sub-key 'p'.";
+            success = false;
+        }
+        if (success) {
+            success = ProcessNames(n_val, nm_val, pqry, placements);
+        }
+        delete n_val;
+        delete nm_val;
+        if (!success) {
+            return false;
+        }
+        ++ct;
+
+        // check for end of array, leave if found
+        if (ct == end || ct->IsBracket(']')) {
+            break;
         }
+        if (!ct->IsOperator(',')) {
+            LOG_WARN << "JSON array does not contain comma between elements at " << ct->at() << ".";
+            return false;
+        }
+        ++ct;
+    }
 
-        // process named multiplicities
-        if (pqry_obj->Has("nm")) {
-            if (!pqry_obj->Get("nm")->IsArray()) {
-                LOG_WARN << "Jplace document contains a pquery with key 'nm' that is not array.";
+    if (ct == end) {
+        LOG_WARN << "Jplace document ended unexpectedly.";
+        return false;
+    }
+    ++ct;
+    return true;
+}
+
+/**
+ * @brief Parses the array of placements at key "p" of a pquery from the lexer tokens and adds
+ * them to the pquery.
+ *
+ * If the tree and fields are not yet known, the numbers of the placements are stored in the
+ * state, so that they can be processed later by ResolvePlacements().
+ */
+bool JplaceProcessor::ParsePqueryPlacements (
+    Lexer::iterator& ct,
+    Lexer::iterator& end,
+    StreamState&     state,
+    Pquery*          pqry,
+    PlacementMap&    placements
+) {
+    if (!ct->IsBracket('[')) {
+        LOG_WARN << "Jplace document contains a pquery at key 'placements' that does not "
+                 << "contain an array of placements at sub-key 'p'.";
+        return false;
+    }
+    ++ct;
+
+    const bool deferred = !state.has_tree || !state.has_fields;
+    while (ct != end && !ct->IsBracket(']')) {
+        if (!ct->IsBracket('[')) {
+            LOG_WARN << "Jplace document contains a pquery with invalid placement at key 'p'.";
+            return false;
+        }
+        ++ct;
+
+        // read all numbers of the placement.
+        std::vector<double>& values = (deferred ? state.deferred_values : state.values);
+        const size_t begin = (deferred ? values.size() : 0);
+        if (!deferred) {
+            values.clear();
+        }
+        while (ct != end && !ct->IsBracket(']')) {
+            if (!ct->IsNumber()) {
+                LOG_WARN << "Jplace document contains pquery where a field is of type '"
+                         << ct->TypeToString() << "' instead of a number.";
                 return false;
             }
+            values.push_back(ct->ToDouble());
+            ++ct;
 
-            JsonValueArray* pqry_nm_arr = JsonValueToArray(pqry_obj->Get("nm"));
-            for (JsonValue* pqry_nm_val : *pqry_nm_arr) {
-                if (!pqry_nm_val->IsArray()) {
-                    LOG_WARN << "Jplace document contains a pquery where key 'nm' has a "
-                             << "non-array field.";
-                    return false;
-                }
+            if (ct != end && ct->IsOperator(',')) {
+                ++ct;
+            } else if (ct != end && !ct->IsBracket(']')) {
+                LOG_WARN << "JSON array does not contain comma between elements at "
+                         << ct->at() << ".";
+                return false;
+            }
+        }
+        if (ct == end) {
+            break;
+        }
+        ++ct;
 
-                JsonValueArray * pqry_nm_val_arr = JsonValueToArray(pqry_nm_val);
-                if (pqry_nm_val_arr->size() != 2) {
-                    LOG_WARN << "Jplace document contains a pquery where key 'nm' has an array "
-                             << "field with size != 2 (one for the name, one for the multiplicity).";
-                    return false;
-                }
-                if (!pqry_nm_val_arr->at(0)->IsString()) {
-                    LOG_WARN << "Jplace document contains a pquery where key 'nm' has an array "
-                             << "whose first value is not a string for the name.";
-                    return false;
-                }
-                if (!pqry_nm_val_arr->at(1)->IsNumber()) {
-                    LOG_WARN << "Jplace document contains a pquery where key 'nm' has an array "
-                             << "whose second value is not a number for the multiplicity.";
+        PqueryPlacement* pqry_place = placements.AddPlacement(pqry);
+        if (deferred) {
+            state.deferred_placements.push_back(pqry_place);
+            state.deferred_offsets.push_back(begin);
+        } else {
+            if (values.size() != state.fields.size()) {
+                LOG_WARN << "Jplace document contains a placement fields array with different "
+                         << "size than the fields name array.";
+                return false;
+            }
+            if (!ProcessPlacementFields(state.fields, values, placements, pqry_place)) {
+                return false;
+            }
+        }
+
+        // check for delimiter comma or end of array
+        if (ct != end && ct->IsOperator(',')) {
+            ++ct;
+        } else if (ct != end && !ct->IsBracket(']')) {
+            LOG_WARN << "JSON array does not contain comma between elements at " << ct->at() << ".";
+            return false;
+        }
+    }
+
+    if (ct == end) {
+        LOG_WARN << "Jplace document ended unexpectedly.";
+        return false;
+    }
+    ++ct;
+    return true;
+}
+
+/**
+ * @brief Processes the placements whose numbers were buffered by ParsePqueryPlacements() because
+ * the tree or the fields were not known at the time.
+ */
+bool JplaceProcessor::ResolvePlacements (StreamState& state, const PlacementMap& placements)
+{
+    assert(state.deferred_placements.size() == state.deferred_offsets.size());
+    state.deferred_offsets.push_back(state.deferred_values.size());
+
+    for (size_t i = 0; i < state.deferred_placements.size(); ++i) {
+        const size_t begin = state.deferred_offsets[i];
+        const size_t end   = state.deferred_offsets[i + 1];
+        if (end - begin != state.fields.size()) {
+            LOG_WARN << "Jplace document contains a placement fields array with different size "
+                     << "than the fields name array.";
+            return false;
+        }
+
+        state.values.assign(
+            state.deferred_values.begin() + begin, state.deferred_values.begin() + end
+        );
+        if (!ProcessPlacementFields(
+            state.fields, state.values, placements, state.deferred_placements[i]
+        )) {
+            return false;
+        }
+    }
+
+    std::vector<double>().swap(state.deferred_values);
+    std::vector<size_t>().swap(state.deferred_offsets);
+    std::vector<PqueryPlacement*>().swap(state.deferred_placements);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//     Processing Helpers
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Checks the version value of a Jplace document and issues a warning if it does not fit.
+ *
+ * The value can be a `nullptr`, in case that the document does not contain a version.
+ */
+void JplaceProcessor::ProcessVersion (JsonValue* val)
+{
+    if (!val) {
+        LOG_WARN << "Jplace document does not contain a valid version number at key 'version'."
+                 << "Now continuing to parse in the hope that it still works.";
+        return;
+    }
+    if (!CheckVersion(val->ToString())) {
+        LOG_WARN << "Jplace document has version '" << val->ToString() << "', however this parser "
+                 << "is written for version " << GetVersion() << " of the Jplace format. "
+                 << "Now continuing to parse in the hope that it still works.";
+    }
+}
+
+/**
+ * @brief Parses the reference tree of a Jplace document into the PlacementMap and updates its
+ * index of edge nums, which also checks that every edge num is used only once.
+ */
+bool JplaceProcessor::ProcessTree (JsonValue* val, PlacementMap& placements)
+{
+    if (!val || !val->IsString() || !NewickProcessor::FromString(val->ToString(), placements.tree)) {
+        LOG_WARN << "Jplace document does not contain a valid Newick tree at key 'tree'.";
+        return false;
+    }
+    if (!placements.UpdateEdgeNumIndex()) {
+        LOG_WARN << "Jplace document contains an invalid tree at key 'tree'.";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Checks the field names of a Jplace document and stores them in a vector.
+ *
+ * Fields that are not used by this parser are stored as empty strings, so that the positions of
+ * the other fields are kept.
+ */
+bool JplaceProcessor::ProcessFields (JsonValue* val, std::vector<std::string>& fields)
+{
+    if (!val || !val->IsArray()) {
+        LOG_WARN << "Jplace document does not contain field names at key 'fields'.";
+        return false;
+    }
+
+    fields.clear();
+    bool has_edge_num = false;
+    for (JsonValue* fields_val : *JsonValueToArray(val)) {
+        if (!fields_val->IsString()) {
+            LOG_WARN << "Jplace document contains a value of type '" << fields_val->TypeToString()
+                     << "' instead of a string with a field name at key 'fields'.";
+            return false;
+        }
+
+        // check field validity
+        std::string field = fields_val->ToString();
+        if (field == "edge_num"      || field == "likelihood"     || field == "like_weight_ratio" ||
+            field == "distal_length" || field == "pendant_length" || field == "parsimony"
+        ) {
+            for (const std::string& fn : fields) {
+                if (fn == field) {
+                    LOG_WARN << "Jplace document contains field name '" << field << "' more than "
+                             << "once at key 'fields'.";
                     return false;
                 }
+            }
+            fields.push_back(field);
+        } else {
+            LOG_WARN << "Jplace document contains a field name '" << field << "' "
+                     << "at key 'fields', which is not used by this parser and thus skipped.";
+            fields.push_back("");
+        }
+        has_edge_num |= (field == "edge_num");
+    }
+    if (!has_edge_num) {
+        LOG_WARN << "Jplace document does not contain necessary field 'edge_num' at key 'fields'.";
+        return false;
+    }
+    return true;
+}
 
-                PqueryName* pqry_name   = new PqueryName();
-                pqry_name->name         = pqry_nm_val_arr->at(0)->ToString();
-                pqry_name->multiplicity = JsonValueToNumber(pqry_nm_val_arr->at(1))->value;
-                if (pqry_name->multiplicity < 0.0) {
-                    LOG_WARN << "Jplace document contains pquery with negative multiplicity at "
-                             << "name '" << pqry_name->name << "'.";
-                }
-                pqry_name->pquery = pqry;
-                pqry->names.push_back(pqry_name);
+/**
+ * @brief Sets the values of a placement, given in the order of the field names, and adds the
+ * placement to its edge.
+ *
+ * The edge is set first, independently of the position of the "edge_num" field, because the
+ * conversion of the "distal_length" needs the branch length of the edge.
+ */
+bool JplaceProcessor::ProcessPlacementFields (
+    const std::vector<std::string>& fields,
+    const std::vector<double>&      values,
+    const PlacementMap&             placements,
+    PqueryPlacement*                pqry_place
+) {
+    assert(fields.size() == values.size());
+
+    // find the edge of the placement first.
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (fields[i] != "edge_num") {
+            continue;
+        }
+        pqry_place->edge_num = values[i];
+        pqry_place->edge     = placements.EdgeByNum(pqry_place->edge_num);
+        if (!pqry_place->edge) {
+            LOG_WARN << "Jplace document contains a pquery where field 'edge_num' "
+                     << "has value '" << values[i] << "', which is not marked "
+                     << "in the given tree as an edge num.";
+            return false;
+        }
+        pqry_place->edge->placements.push_back(pqry_place);
+    }
+    assert(pqry_place->edge);
+
+    // switch on the field name to set the correct value
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if        (fields[i] == "likelihood") {
+            pqry_place->likelihood        = values[i];
+        } else if (fields[i] == "like_weight_ratio") {
+            pqry_place->like_weight_ratio = values[i];
+        } else if (fields[i] == "distal_length") {
+            // the jplace format uses distal length, but we use proximal,
+            // so we need to convert here.
+            pqry_place->proximal_length   = pqry_place->edge->branch_length - values[i];
+        } else if (fields[i] == "pendant_length") {
+            pqry_place->pendant_length    = values[i];
+        } else if (fields[i] == "parsimony") {
+            pqry_place->parsimony         = values[i];
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Processes the names ("n") or named multiplicities ("nm") of a pquery and adds them to it.
+ *
+ * Either of the values can be a `nullptr`, in case that the pquery does not contain the key.
+ */
+bool JplaceProcessor::ProcessNames (
+    JsonValue*       n_val,
+    JsonValue*       nm_val,
+    Pquery*          pqry,
+    PlacementMap&    placements
+) {
+    // check name/named multiplicity validity
+    if (n_val && nm_val) {
+        LOG_WARN << "Jplace document contains a pquery with both an 'n' and an 'nm' key.";
+        return false;
+    }
+    if (!n_val && !nm_val) {
+        LOG_WARN << "Jplace document contains a pquery with neither an 'n' nor an 'nm' key.";
+        return false;
+    }
+
+    // process names
+    if (n_val) {
+        if (!n_val->IsArray()) {
+            LOG_WARN << "Jplace document contains a pquery with key 'n' that is not array.";
+            return false;
+        }
+
+        for (JsonValue* pqry_n_val : *JsonValueToArray(n_val)) {
+            if (!pqry_n_val->IsString()) {
+                LOG_WARN << "Jplace document contains a pquery where key 'n' has a "
+                         << "non-string field.";
+                return false;
             }
+
+            PqueryName* pqry_name   = placements.AddName(pqry);
+            pqry_name->name         = pqry_n_val->ToString();
+            pqry_name->multiplicity = 0.0;
+        }
+    }
+
+    // process named multiplicities
+    if (nm_val) {
+        if (!nm_val->IsArray()) {
+            LOG_WARN << "Jplace document contains a pquery with key 'nm' that is not array.";
+            return false;
         }
 
-        // finally, add the pquery to the placements object
-        placements.pqueries.push_back(pqry);
+        for (JsonValue* pqry_nm_val : *JsonValueToArray(nm_val)) {
+            if (!pqry_nm_val->IsArray()) {
+                LOG_WARN << "Jplace document contains a pquery where key 'nm' has a "
+                         << "non-array field.";
+                return false;
+            }
+
+            JsonValueArray* pqry_nm_val_arr = JsonValueToArray(pqry_nm_val);
+            if (pqry_nm_val_arr->size() != 2) {
+                LOG_WARN << "Jplace document contains a pquery where key 'nm' has an array "
+                         << "field with size != 2 (one for the name, one for the multiplicity).";
+                return false;
+            }
+            if (!pqry_nm_val_arr->at(0)->IsString()) {
+                LOG_WARN << "Jplace document contains a pquery where key 'nm' has an array "
+                         << "whose first value is not a string for the name.";
+                return false;
+            }
+            if (!pqry_nm_val_arr->at(1)->IsNumber()) {
+                LOG_WARN << "Jplace document contains a pquery where key 'nm' has an array "
+                         << "whose second value is not a number for the multiplicity.";
+                return false;
+            }
+
+            PqueryName* pqry_name   = placements.AddName(pqry);
+            pqry_name->name         = pqry_nm_val_arr->at(0)->ToString();
+            pqry_name->multiplicity = JsonValueToNumber(pqry_nm_val_arr->at(1))->value;
+            if (pqry_name->multiplicity < 0.0) {
+                LOG_WARN << "Jplace document contains pquery with negative multiplicity at "
+                         << "name '" << pqry_name->name << "'.";
+            }
+        }
     }
 
-    // check if there is metadata
-    val = doc.Get("metadata");
+    return true;
+}
+
+/**
+ * @brief Stores the metadata of a Jplace document in the PlacementMap, if there is any.
+ */
+void JplaceProcessor::ProcessMetadata (JsonValue* val, PlacementMap& placements)
+{
     if (val && val->IsObject()) {
-        JsonValueObject* meta_obj = JsonValueToObject(val);
-        for (JsonValueObject::ObjectPair meta_pair : *meta_obj) {
+        for (JsonValueObject::ObjectPair meta_pair : *JsonValueToObject(val)) {
             placements.metadata[meta_pair.first] = meta_pair.second->ToString();
         }
     }
-
-    return true;
 }
 
 // =============================================================================
@@ -333,35 +856,135 @@ bool JplaceProcessor::FromDocument (const JsonDocument& doc, PlacementMap& place
 // =============================================================================
 
 /**
- * @brief
+ * @brief Writes the placements to a file in Jplace format. Returns true iff successful.
+ *
+ * If the file already exists, the function does not overwrite it. If `compress` is set, the file
+ * is written with gzip compression, which needs genesis to be compiled with `ZLIB`.
+ *
+ * The file is streamed via ToStream(), so that the Jplace document is never held in memory.
  */
-bool JplaceProcessor::ToFile (const std::string fn, const PlacementMap& placements)
-{
+bool JplaceProcessor::ToFile (
+    const std::string   fn,
+    const PlacementMap& placements,
+    const bool          compress
+) {
     if (FileExists(fn)) {
         LOG_WARN << "Jplace file '" << fn << "' already exist. Will not overwrite it.";
         return false;
     }
-    std::string ts;
-    ToString(ts, placements);
-    return FileWrite(fn, ts);
+    OutputStream os;
+    if (!os.OpenFile(fn, compress)) {
+        return false;
+    }
+    ToStream(os, placements);
+    return os.Close();
 }
 
 /**
- * @brief
+ * @brief Gives the Jplace string representation of the placements.
  */
 void JplaceProcessor::ToString (std::string&  jplace, const PlacementMap& placements)
 {
-    jplace = ToString(placements);
+    jplace.clear();
+    OutputStream os;
+    os.OpenString(jplace);
+    ToStream(os, placements);
+    os.Close();
 }
 
 /**
- * @brief
+ * @brief Returns the Jplace string representation of the placements.
  */
 std::string JplaceProcessor::ToString (const PlacementMap& placements)
 {
-    JsonDocument json;
-    ToDocument(json, placements);
-    return JsonProcessor::ToString(json);
+    std::string jplace;
+    ToString(jplace, placements);
+    return jplace;
+}
+
+/**
+ * @brief Writes the placements in Jplace format to an OutputStream.
+ *
+ * The document is written piece by piece while iterating the pqueries, without building a
+ * JsonDocument first. Floating point values are printed with the shortest representation that
+ * reads back to the same value (see OutputStream::FormatDouble()), so that no precision is lost
+ * when reading the file again. The fields are written before the placements, so that the
+ * document can be read back in one pass.
+ */
+void JplaceProcessor::ToStream (OutputStream& os, const PlacementMap& placements)
+{
+    // set tree
+    NewickProcessor::print_names          = true;
+    NewickProcessor::print_branch_lengths = true;
+    NewickProcessor::print_comments       = false;
+    NewickProcessor::print_tags           = true;
+    os.Write("{\n    \"tree\": \"");
+    os.Write(StringEscape(NewickProcessor::ToString(placements.tree)));
+    os.Write("\",\n");
+
+    // write fields and version first, so that readers can process the placements directly
+    // instead of buffering them until the fields are known, see ParsePlacements().
+    os.Write("    \"fields\": [ \"edge_num\", \"likelihood\", \"like_weight_ratio\", ");
+    os.Write("\"distal_length\", \"pendant_length\" ],\n");
+
+    // write version
+    os.Write("    \"version\": 3,\n");
+
+    // write placements
+    os.Write("    \"placements\": [");
+    bool first_pqry = true;
+    for (const Pquery* pqry : placements.pqueries) {
+        os.Write(first_pqry ? "\n        {\n" : ",\n        {\n");
+        first_pqry = false;
+
+        // write placements
+        os.Write("            \"p\": [");
+        bool first_place = true;
+        for (const PqueryPlacement* pqry_place : pqry->placements) {
+            os.Write(first_place ? "\n                [ " : ",\n                [ ");
+            first_place = false;
+
+            os.WriteInteger(pqry_place->edge_num);
+            os.Write(", ").WriteDouble(pqry_place->likelihood);
+            os.Write(", ").WriteDouble(pqry_place->like_weight_ratio);
+
+            // convert from proximal to distal length.
+            os.Write(", ").WriteDouble(pqry_place->edge->branch_length - pqry_place->proximal_length);
+            os.Write(", ").WriteDouble(pqry_place->pendant_length);
+            os.Write(" ]");
+        }
+        os.Write("\n            ],\n");
+
+        // find out whether names have multiplicity
+        bool has_nm = false;
+        for (const PqueryName* pqry_name : pqry->names) {
+            has_nm |= pqry_name->multiplicity != 0.0;
+        }
+
+        // write named multiplicity / name
+        os.Write(has_nm ? "            \"nm\": [ " : "            \"n\": [ ");
+        bool first_name = true;
+        for (const PqueryName* pqry_name : pqry->names) {
+            if (!first_name) {
+                os.Write(", ");
+            }
+            first_name = false;
+
+            if (has_nm) {
+                os.Write("[ \"").Write(StringEscape(pqry_name->name)).Write("\", ");
+                os.WriteDouble(pqry_name->multiplicity).Write(" ]");
+            } else {
+                os.Write('"').Write(StringEscape(pqry_name->name)).Write('"');
+            }
+        }
+        os.Write(" ]\n        }");
+    }
+    os.Write(placements.pqueries.empty() ? "],\n" : "\n    ],\n");
+
+    // write metadata
+    os.Write("    \"metadata\": {\n        \"invocation\": \"");
+    os.Write(StringEscape(Options::GetCommandLineString()));
+    os.Write("\"\n    }\n}\n");
 }
 
 /**
@@ -9,6 +9,12 @@
  */
 
 #include <string>
+#include <vector>
+
+#include "placement/placement_tree.hpp"
+#include "utils/input_source.hpp"
+#include "utils/input_stream.hpp"
+#include "utils/lexer.hpp"
 
 namespace genesis {
 
@@ -18,7 +24,11 @@ namespace genesis {
 
 class JsonDocument;
 class JsonLexer;
+class JsonValue;
+class OutputStream;
 class PlacementMap;
+struct Pquery;
+struct PqueryPlacement;
 
 // =============================================================================
 //     Jplace Processor
@@ -32,6 +42,11 @@ class PlacementMap;
  * A Format for Phylogenetic PlacementMap.
  * PLoS ONE 7(2): e31009. doi:10.1371/journal.pone.0031009
  * http://journals.plos.org/plosone/article?id=10.1371/journal.pone.0031009
+ *
+ * Parsing a string or file does not build a JsonDocument, but reads the tokens of the JsonLexer
+ * directly and creates the pqueries while reading them. Likewise, printing to a string or file
+ * does not build a JsonDocument, but streams the pqueries to a buffered OutputStream, so that
+ * the memory needed for writing is independent of the size of the PlacementMap.
  */
 class JplaceProcessor
 {
@@ -46,15 +61,83 @@ public:
 
     static bool FromFile     (const std::string&  fn,     PlacementMap& placements);
     static bool FromString   (const std::string&  jplace, PlacementMap& placements);
+    static bool FromSource   (const InputSource&  source, PlacementMap& placements);
+    static bool FromStream   (InputStream&        stream, PlacementMap& placements);
     static bool FromDocument (const JsonDocument& doc,    PlacementMap& placements);
 
+protected:
+
+    /**
+     * @brief Intermediate data used while streaming a Jplace document in FromLexer().
+     */
+    typedef struct {
+        std::vector<std::string>      fields;
+        bool                          has_tree;
+        bool                          has_fields;
+
+        std::vector<double>           values;
+
+        std::vector<PqueryPlacement*> deferred_placements;
+        std::vector<size_t>           deferred_offsets;
+        std::vector<double>           deferred_values;
+    } StreamState;
+
+    static bool FromLexer (JsonLexer& lexer, PlacementMap& placements);
+
+    static bool FromLexer (
+        Lexer::iterator& ct,
+        Lexer::iterator& end,
+        PlacementMap&    placements
+    );
+
+    static bool ParsePlacements (
+        Lexer::iterator& ct,
+        Lexer::iterator& end,
+        StreamState&     state,
+        PlacementMap&    placements
+    );
+
+    static bool ParsePqueryPlacements (
+        Lexer::iterator& ct,
+        Lexer::iterator& end,
+        StreamState&     state,
+        Pquery*          pqry,
+        PlacementMap&    placements
+    );
+
+    static bool ResolvePlacements (StreamState& state, const PlacementMap& placements);
+
+    static void ProcessVersion  (JsonValue* val);
+    static bool ProcessTree     (JsonValue* val, PlacementMap& placements);
+    static bool ProcessFields   (JsonValue* val, std::vector<std::string>& fields);
+    static bool ProcessPlacementFields (
+        const std::vector<std::string>& fields,
+        const std::vector<double>&      values,
+        const PlacementMap&             placements,
+        PqueryPlacement*                pqry_place
+    );
+    static bool ProcessNames    (
+        JsonValue*       n_val,
+        JsonValue*       nm_val,
+        Pquery*          pqry,
+        PlacementMap&    placements
+    );
+    static void ProcessMetadata (JsonValue* val, PlacementMap& placements);
+
+public:
+
     // ---------------------------------------------------------------------
     //     Printing
     // ---------------------------------------------------------------------
 
-    static bool        ToFile     (const std::string   fn,     const PlacementMap& placements);
+    static bool        ToFile     (
+        const std::string   fn,
+        const PlacementMap& placements,
+        const bool          compress = false
+    );
     static void        ToString   (      std::string&  jplace, const PlacementMap& placements);
     static std::string ToString   (                            const PlacementMap& placements);
+    static void        ToStream   (      OutputStream& os,     const PlacementMap& placements);
     static void        ToDocument (      JsonDocument& doc,    const PlacementMap& placements);
 };
 
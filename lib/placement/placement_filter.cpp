@@ -0,0 +1,111 @@
+/**
+ * @brief Implementation of Placement Filter class.
+ *
+ * @file
+ * @ingroup placement
+ */
+
+#include "placement/placement_filter.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+
+#include "placement/placement_map.hpp"
+
+namespace genesis {
+
+// =============================================================================
+//     Constructor
+// =============================================================================
+
+/**
+ * @brief Constructor that sets the rules so that no placements are removed.
+ */
+PlacementFilter::PlacementFilter () :
+    min_weight_ratio(0.0),
+    max_count(std::numeric_limits<size_t>::max()),
+    max_accumulated_weight(std::numeric_limits<double>::infinity()),
+    normalize(false)
+{}
+
+// =============================================================================
+//     Filtering
+// =============================================================================
+
+/**
+ * @brief Applies the rules of this filter to all pqueries of a PlacementMap.
+ */
+void PlacementFilter::Apply (PlacementMap& placements) const
+{
+    // filter the placements of each pquery, and keep the pqueries that still have some.
+    size_t count = 0;
+    auto pqry_end = std::remove_if(
+        placements.pqueries.begin(), placements.pqueries.end(),
+        [&] (Pquery* pqry) {
+            FilterPlacements(pqry->placements);
+            count += pqry->placements.size();
+            return pqry->placements.empty();
+        }
+    );
+    placements.pqueries.erase(pqry_end, placements.pqueries.end());
+
+    // rebuild the placement lists of the edges. the removed placements and pqueries are owned by
+    // the arenas of the map, so they are freed when the map is cleared.
+    PlacementTree& tree = placements.tree;
+    std::vector<size_t> edge_counts (tree.EdgeCount(), 0);
+    for (const Pquery* pqry : placements.pqueries) {
+        for (const PqueryPlacement* place : pqry->placements) {
+            ++edge_counts[place->edge->Index()];
+        }
+    }
+    for (size_t i = 0; i < tree.EdgeCount(); ++i) {
+        std::vector<PqueryPlacement*>& edge_places = tree.EdgeAt(i)->placements;
+        edge_places.clear();
+        edge_places.reserve(edge_counts[i]);
+    }
+    for (Pquery* pqry : placements.pqueries) {
+        for (PqueryPlacement* place : pqry->placements) {
+            place->edge->placements.push_back(place);
+        }
+    }
+    assert(count == placements.PlacementCount());
+}
+
+/**
+ * @brief Applies the rules of this filter to the placements of one pquery.
+ *
+ * The placements are sorted by descending `like_weight_ratio`, so that all rules can be applied
+ * by finding the number of placements to keep.
+ */
+void PlacementFilter::FilterPlacements (std::vector<PqueryPlacement*>& placements) const
+{
+    std::stable_sort(
+        placements.begin(), placements.end(),
+        [] (const PqueryPlacement* lhs, const PqueryPlacement* rhs) {
+            return lhs->like_weight_ratio > rhs->like_weight_ratio;
+        }
+    );
+
+    size_t keep = 0;
+    double accumulated = 0.0;
+    while (
+        keep < placements.size() && keep < max_count && accumulated < max_accumulated_weight
+        && placements[keep]->like_weight_ratio >= min_weight_ratio
+    ) {
+        accumulated += placements[keep]->like_weight_ratio;
+        ++keep;
+    }
+    placements.resize(keep);
+
+    if (!normalize || placements.empty()) {
+        return;
+    }
+    for (PqueryPlacement* place : placements) {
+        place->like_weight_ratio = (accumulated > 0.0)
+                                 ? place->like_weight_ratio / accumulated
+                                 : 1.0 / placements.size();
+    }
+}
+
+} // namespace genesis
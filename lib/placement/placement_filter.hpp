@@ -0,0 +1,76 @@
+#ifndef GENESIS_PLACEMENT_PLACEMENT_FILTER_H_
+#define GENESIS_PLACEMENT_PLACEMENT_FILTER_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup placement
+ */
+
+#include <stddef.h>
+#include <vector>
+
+namespace genesis {
+
+// =============================================================================
+//     Forward Declarations
+// =============================================================================
+
+class  PlacementMap;
+struct PqueryPlacement;
+
+// =============================================================================
+//     Placement Filter
+// =============================================================================
+
+/**
+ * @brief Removes placements from the pqueries of a PlacementMap, according to a set of rules.
+ *
+ * The rules are set via the public members of this class. By default, they do not remove
+ * anything:
+ *
+ *   * #min_weight_ratio: Placements with a `like_weight_ratio` below this value are removed.
+ *   * #max_count: Only the #max_count most likely placements of each pquery are kept.
+ *   * #max_accumulated_weight: The most likely placements of each pquery are kept until their
+ *     accumulated `like_weight_ratio` reaches this value. The placement that reaches it is kept.
+ *   * #normalize: After filtering, the `like_weight_ratio`s of the remaining placements of each
+ *     pquery are rescaled so that they sum up to 1.0.
+ *
+ * All rules are applied in a single pass over the pqueries by Apply(). Afterwards, the placements
+ * of each pquery are sorted by descending `like_weight_ratio`. Pqueries that lose all their
+ * placements are removed from the map. The placement lists of the edges are rebuilt once at the
+ * end, so that the whole filtering takes time linear in the number of placements.
+ */
+class PlacementFilter
+{
+public:
+    // -----------------------------------------------------
+    //     Constructor & Filtering
+    // -----------------------------------------------------
+
+    PlacementFilter ();
+
+    void Apply (PlacementMap& placements) const;
+
+    // -----------------------------------------------------
+    //     Settings
+    // -----------------------------------------------------
+
+    double min_weight_ratio;
+    size_t max_count;
+    double max_accumulated_weight;
+    bool   normalize;
+
+    // -----------------------------------------------------
+    //     Internal Members
+    // -----------------------------------------------------
+
+protected:
+
+    void FilterPlacements (std::vector<PqueryPlacement*>& placements) const;
+};
+
+} // namespace genesis
+
+#endif // include guard
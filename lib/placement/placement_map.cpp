@@ -11,15 +11,21 @@
 #include <assert.h>
 #include <cmath>
 #include <iomanip>
-#include <map>
+#include <memory>
 #include <sstream>
-#include <thread>
 #include <unordered_map>
 
 #ifdef PTHREADS
 #    include <thread>
 #endif
 
+#if defined(__AVX2__) || defined(__AVX512F__)
+#    include <immintrin.h>
+#endif
+
+#include "placement/emd_profile.hpp"
+#include "placement/jplace_processor.hpp"
+#include "placement/placement_filter.hpp"
 #include "utils/logging.hpp"
 #include "utils/matrix.hpp"
 #include "utils/options.hpp"
@@ -63,22 +69,29 @@ PlacementMap::PlacementMap (const PlacementMap& other)
     // the trees are copies. they should take equal iterations to finish a traversal.
     assert(it_n == tree.EndPreorder() && it_o == other.tree.EndPreorder());
 
+    // reserve contiguous storage for all pqueries, placements and names at once.
+    ReserveFor(other);
+
+    // the edges of both trees have the same indices, so the edge num index stays valid.
+    edge_num_index_  = other.edge_num_index_;
+    edge_num_offset_ = other.edge_num_offset_;
+
     // copy all (o)ther pqueries to (n)ew pqueries
-    EdgeNumMapType* edge_num_map = EdgeNumMap();
     for (Pquery* opqry : other.pqueries) {
-        Pquery* npqry = new Pquery();
-        pqueries.push_back(npqry);
+        Pquery* npqry = AddPquery();
+        npqry->placements.reserve(opqry->placements.size());
+        npqry->names.reserve(opqry->names.size());
 
         for (PqueryPlacement* op : opqry->placements) {
-            PqueryPlacement* np = new PqueryPlacement(op);
+            PqueryPlacement* np = placement_arena_.Create(op);
 
-            np->edge   = (*edge_num_map)[np->edge_num];
+            np->edge   = tree.EdgeAt(op->edge->Index());
             np->edge->placements.push_back(np);
             np->pquery = npqry;
             npqry->placements.push_back(np);
         }
         for (PqueryName* on : opqry->names) {
-            PqueryName* nn = new PqueryName(on);
+            PqueryName* nn = name_arena_.Create(on);
             nn->pquery = npqry;
             npqry->names.push_back(nn);
         }
@@ -99,12 +112,26 @@ PlacementMap& PlacementMap::operator = (const PlacementMap& other)
     // copy constructor). we can thus simply swap the arrays, and upon leaving the function,
     // tmp is automatically destroyed, so that its arrays are cleared and the data freed.
     PlacementMap tmp(other);
-    std::swap(pqueries, tmp.pqueries);
-    tree.swap(tmp.tree);
-    std::swap(metadata, tmp.metadata);
+    swap(tmp);
     return *this;
 }
 
+/**
+ * @brief Swaps all data of two PlacementMap%s. Pointers to their pqueries, placements and names
+ * stay valid.
+ */
+void PlacementMap::swap (PlacementMap& other)
+{
+    std::swap(pqueries, other.pqueries);
+    tree.swap(other.tree);
+    std::swap(metadata, other.metadata);
+    pquery_arena_.swap(other.pquery_arena_);
+    placement_arena_.swap(other.placement_arena_);
+    name_arena_.swap(other.name_arena_);
+    std::swap(edge_num_index_, other.edge_num_index_);
+    std::swap(edge_num_offset_, other.edge_num_offset_);
+}
+
 /**
  * @brief Destructor. Calls clear() to delete all data.
  */
@@ -116,40 +143,171 @@ PlacementMap::~PlacementMap()
 /**
  * @brief Clears all data of this object.
  *
- * The pqueries, the tree and the metadata are deleted.
+ * The pqueries, the tree and the metadata are deleted. As the pqueries and their placements and
+ * names are stored in Arena%s, they are freed in bulk instead of one by one.
  */
 void PlacementMap::clear()
 {
-    for (Pquery* pqry : pqueries) {
-        delete pqry;
-    }
     std::vector<Pquery*>().swap(pqueries);
+    pquery_arena_.clear();
+    placement_arena_.clear();
+    name_arena_.clear();
     tree.clear();
     metadata.clear();
+    std::vector<size_t>().swap(edge_num_index_);
+    edge_num_offset_ = 0;
 }
 
 /**
- * @brief Returns a mapping of edge_num integers to the corresponding Edge object.
+ * @brief Creates a new Pquery that is owned by this PlacementMap, adds it to the pqueries and
+ * returns a pointer to it.
+ */
+Pquery* PlacementMap::AddPquery()
+{
+    Pquery* pqry = pquery_arena_.Create();
+    pqueries.push_back(pqry);
+    return pqry;
+}
+
+/**
+ * @brief Creates a new PqueryPlacement that is owned by this PlacementMap, adds it to the given
+ * Pquery and returns a pointer to it.
  *
- * This function depends on the tree only and does not involve any pqueries.
+ * The Pquery needs to be owned by this PlacementMap. The edge of the placement is not set by this
+ * function, so it is the responsibility of the caller to set it and add the placement to the
+ * placements of that edge.
  */
-PlacementMap::EdgeNumMapType* PlacementMap::EdgeNumMap() const
+PqueryPlacement* PlacementMap::AddPlacement (Pquery* pqry)
 {
-    EdgeNumMapType* edge_num_map = new EdgeNumMapType();
-    for (
-        PlacementTree::ConstIteratorEdges it = tree.BeginEdges();
-        it != tree.EndEdges();
-        ++it
-    ) {
-        PlacementTree::EdgeType* edge = *it;
-        assert(edge_num_map->count(edge->edge_num) == 0);
-        edge_num_map->emplace(edge->edge_num, edge);
+    PqueryPlacement* place = placement_arena_.Create();
+    place->pquery = pqry;
+    pqry->placements.push_back(place);
+    return place;
+}
+
+/**
+ * @brief Creates a new PqueryName that is owned by this PlacementMap, adds it to the given
+ * Pquery and returns a pointer to it.
+ *
+ * The Pquery needs to be owned by this PlacementMap.
+ */
+PqueryName* PlacementMap::AddName (Pquery* pqry)
+{
+    PqueryName* name = name_arena_.Create();
+    name->pquery = pqry;
+    pqry->names.push_back(name);
+    return name;
+}
+
+/**
+ * @brief Reserves storage for adding copies of all pqueries of another PlacementMap to this one.
+ *
+ * The sizes are taken from the pqueries of the other map, not from its Arena%s. The latter also
+ * count objects that were removed from the map, e.g. by RestrainToMaxWeightPlacements(), as an
+ * Arena does not free single objects.
+ */
+void PlacementMap::ReserveFor (const PlacementMap& other)
+{
+    size_t placement_count = 0;
+    size_t name_count      = 0;
+    for (const Pquery* pqry : other.pqueries) {
+        placement_count += pqry->placements.size();
+        name_count      += pqry->names.size();
+    }
+
+    pqueries.reserve(pqueries.size() + other.pqueries.size());
+    pquery_arena_.Reserve(other.pqueries.size());
+    placement_arena_.Reserve(placement_count);
+    name_arena_.Reserve(name_count);
+}
+
+/**
+ * @brief Creates the index that is used by EdgeByNum() for finding edges by their edge_num.
+ *
+ * The index is a vector that contains the index of the edge for each edge_num. It needs to be
+ * updated whenever the tree is changed. This is done by the functions of this class and by the
+ * processors that read a PlacementMap, but needs to be done manually when changing the tree
+ * directly. If the index is outdated, EdgeByNum() still works, but is slower.
+ *
+ * If the edge_nums of the tree are too sparse for a dense index, no index is created, see
+ * kEdgeNumIndexMaxSparsity. If an edge_num is used more than once, a warning is issued, no index
+ * is created and false is returned.
+ */
+bool PlacementMap::UpdateEdgeNumIndex()
+{
+    std::vector<size_t>().swap(edge_num_index_);
+    edge_num_offset_ = 0;
+    if (tree.EdgeCount() == 0) {
+        return true;
+    }
+
+    // find the range of edge_nums.
+    int min_num = tree.EdgeAt(0)->edge_num;
+    int max_num = min_num;
+    for (size_t i = 1; i < tree.EdgeCount(); ++i) {
+        min_num = std::min(min_num, tree.EdgeAt(i)->edge_num);
+        max_num = std::max(max_num, tree.EdgeAt(i)->edge_num);
+    }
+
+    // if the edge_nums are too sparse, we do not create an index, but still check for duplicates.
+    const size_t range = static_cast<size_t>(static_cast<long>(max_num) - min_num) + 1;
+    if (range > kEdgeNumIndexMaxSparsity * tree.EdgeCount()) {
+        std::vector<int> nums;
+        for (size_t i = 0; i < tree.EdgeCount(); ++i) {
+            nums.push_back(tree.EdgeAt(i)->edge_num);
+        }
+        std::sort(nums.begin(), nums.end());
+        auto dup = std::adjacent_find(nums.begin(), nums.end());
+        if (dup != nums.end()) {
+            LOG_WARN << "Tree contains the edge num tag '" << *dup << "' more than once.";
+            return false;
+        }
+        return true;
     }
-    return edge_num_map;
+
+    // fill the index, using the number of edges as marker for unused edge_nums.
+    std::vector<size_t> index (range, tree.EdgeCount());
+    for (size_t i = 0; i < tree.EdgeCount(); ++i) {
+        const int    edge_num = tree.EdgeAt(i)->edge_num;
+        const size_t pos      = static_cast<size_t>(static_cast<long>(edge_num) - min_num);
+        if (index[pos] != tree.EdgeCount()) {
+            LOG_WARN << "Tree contains the edge num tag '" << edge_num << "' more than once.";
+            return false;
+        }
+        index[pos] = i;
+    }
+
+    edge_num_index_.swap(index);
+    edge_num_offset_ = min_num;
+    return true;
+}
+
+/**
+ * @brief Returns the edge with the given edge_num, or a `nullptr` if there is no such edge.
+ *
+ * The edge is looked up in the index that is created by UpdateEdgeNumIndex(). The result is
+ * checked against the tree, so that an outdated index is detected. In this case, or if there is
+ * no index, the edges are searched linearly.
+ */
+PlacementTree::EdgeType* PlacementMap::EdgeByNum (const int edge_num) const
+{
+    const size_t pos = static_cast<size_t>(static_cast<long>(edge_num) - edge_num_offset_);
+    if (pos < edge_num_index_.size()) {
+        const size_t index = edge_num_index_[pos];
+        if (index < tree.EdgeCount() && tree.EdgeAt(index)->edge_num == edge_num) {
+            return tree.EdgeAt(index);
+        }
+    }
+
+    for (size_t i = 0; i < tree.EdgeCount(); ++i) {
+        if (tree.EdgeAt(i)->edge_num == edge_num) {
+            return tree.EdgeAt(i);
+        }
+    }
+    return nullptr;
 }
 
 // TODO add option for averaging branch_length
-// TODO write another merge function (static) that takes multiple placements and outputs a new placements object.
 /**
  * @brief Adds the pqueries from another PlacementMap objects to this one.
  */
@@ -157,47 +315,241 @@ bool PlacementMap::Merge(const PlacementMap& other)
 {
     // check for identical topology, taxa names and edge_nums.
     // we do not check here for branch_length, because usually those differ slightly.
-    auto comparator = [] (
-        PlacementTree::ConstIteratorPreorder& it_l,
-        PlacementTree::ConstIteratorPreorder& it_r
-    ) {
-        return it_l.Node()->name     == it_r.Node()->name     &&
-               it_l.Edge()->edge_num == it_r.Edge()->edge_num;
-    };
-
-    if (!tree.Equal(other.tree, comparator)) {
+    if (TreeFingerprint() != other.TreeFingerprint()) {
         LOG_WARN << "Cannot merge PlacementMap with different reference trees.";
         return false;
     }
 
     // we need to assign edge pointers to the correct edge objects, so we need a mapping
-    EdgeNumMapType* edge_num_map = EdgeNumMap();
+    std::vector<PlacementTree::EdgeType*> edge_map = EdgeMap(other);
+
+    // reserve contiguous storage for all new pqueries, placements and names at once.
+    ReserveFor(other);
 
     // copy all (o)ther pqueries to (n)ew pqueries
     for (const Pquery* opqry : other.pqueries) {
-        Pquery* npqry = new Pquery;
+        Pquery* npqry = AddPquery();
         for (const PqueryPlacement* op : opqry->placements) {
-            PqueryPlacement* np = new PqueryPlacement(op);
-
-            // assuming that the trees have identical topology (checked at the beginning of this
-            // function), there will be an edge for every placement. if this assertion fails,
-            // something broke the integrity of our in memory representation of the data.
-            assert(edge_num_map->count(np->edge_num) > 0);
-            np->edge = (*edge_num_map)[np->edge_num];
+            PqueryPlacement* np = placement_arena_.Create(op);
+            np->edge = edge_map[op->edge->Index()];
             np->edge->placements.push_back(np);
             np->pquery = npqry;
             npqry->placements.push_back(np);
         }
         for (const PqueryName* on : opqry->names) {
-            PqueryName* nn = new PqueryName(on);
+            PqueryName* nn = name_arena_.Create(on);
             nn->pquery = npqry;
             npqry->names.push_back(nn);
         }
-        this->pqueries.push_back(npqry);
     }
     return true;
 }
 
+/**
+ * @brief Reads a list of Jplace files and adds their pqueries to this PlacementMap.
+ *
+ * The files are parsed concurrently, using Options::number_of_threads threads (if compiled with
+ * PTHREADS). The reference tree of each file is compared to the tree of this map using
+ * TreeFingerprint(). If this map does not contain a tree yet, the tree of the first file is used.
+ * The placements of each file are then assigned to the edges of this tree via their edge_num, so
+ * that the tree of the file can be freed right after the check. Only the pqueries are kept, and
+ * moved into this map in the order of the files, without copying them.
+ *
+ * The files are processed in windows of kMergeFilesWindow files per thread, so that only the
+ * files of one window are held before their pqueries are collected.
+ *
+ * If any of the files cannot be read, or has a different reference tree, this map is not changed
+ * and false is returned.
+ */
+bool PlacementMap::MergeFiles (const std::vector<std::string>& fns)
+{
+    if (fns.empty()) {
+        return true;
+    }
+
+    // the pqueries of all files are first collected here, so that this map stays unchanged if one
+    // of the files fails. if this map does not have a tree yet, the first file provides it.
+    PlacementMap merged;
+    const bool   empty = tree.NodeCount() == 0;
+    size_t       first = 0;
+    if (empty) {
+        if (!JplaceProcessor::FromFile(fns[0], merged)) {
+            LOG_WARN << "Cannot merge Jplace file '" << fns[0] << "', as it cannot be read.";
+            return false;
+        }
+        first = 1;
+    }
+    PlacementMap&     reference   = (empty ? merged : *this);
+    const std::string fingerprint = reference.TreeFingerprint();
+    reference.UpdateEdgeNumIndex();
+
+    // the pqueries of the first file, if any, are already assigned to the edges.
+    const size_t first_new = merged.pqueries.size();
+
+    const size_t num_threads = std::max(Options::number_of_threads, 1u);
+    const size_t window      = num_threads * kMergeFilesWindow;
+    for (size_t begin = first; begin < fns.size(); begin += window) {
+        const size_t               end = std::min(begin + window, fns.size());
+        std::vector<PlacementMap*> maps (end - begin, nullptr);
+        std::atomic<size_t>        next_file (begin);
+
+#ifdef PTHREADS
+
+        // parse the files in parallel. each thread takes the next file that is not yet parsed.
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < std::min(num_threads, end - begin); ++i) {
+            threads.emplace_back(
+                &PlacementMap::MergeFilesThread,
+                &reference, &fingerprint, &fns, begin, &next_file, &maps
+            );
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+
+#else
+
+        // do all the work in one "thread".
+        MergeFilesThread(&reference, &fingerprint, &fns, begin, &next_file, &maps);
+
+#endif
+
+        // collect the pqueries of the window in the order of the files.
+        bool success = true;
+        for (PlacementMap* map : maps) {
+            if (!map) {
+                success = false;
+                continue;
+            }
+            merged.pqueries.insert(merged.pqueries.end(), map->pqueries.begin(), map->pqueries.end());
+            merged.pquery_arena_.Splice(map->pquery_arena_);
+            merged.placement_arena_.Splice(map->placement_arena_);
+            merged.name_arena_.Splice(map->name_arena_);
+            map->pqueries.clear();
+        }
+        for (PlacementMap* map : maps) {
+            delete map;
+        }
+        if (!success) {
+            return false;
+        }
+    }
+
+    // all files are fine, so the placements can be added to the edges of the reference tree.
+    for (size_t i = first_new; i < merged.pqueries.size(); ++i) {
+        for (PqueryPlacement* place : merged.pqueries[i]->placements) {
+            place->edge->placements.push_back(place);
+        }
+    }
+
+    // move the collected pqueries to this map. if it was empty, simply take over everything.
+    if (empty) {
+        swap(merged);
+        return true;
+    }
+    pqueries.insert(pqueries.end(), merged.pqueries.begin(), merged.pqueries.end());
+    pquery_arena_.Splice(merged.pquery_arena_);
+    placement_arena_.Splice(merged.placement_arena_);
+    name_arena_.Splice(merged.name_arena_);
+    merged.pqueries.clear();
+    return true;
+}
+
+/**
+ * @brief Thread function that parses Jplace files for MergeFiles().
+ *
+ * Each call takes the next file index from the shared counter until all files of the current
+ * window are parsed. The reference tree of each file is checked against the given fingerprint,
+ * and the placements are assigned to the edges of the reference map, but not yet added to the
+ * edges. The tree of the file is then freed. Files that cannot be read or have a different tree
+ * result in a warning and a `nullptr` entry.
+ */
+void PlacementMap::MergeFilesThread (
+    const PlacementMap*             reference,
+    const std::string*              fingerprint,
+    const std::vector<std::string>* fns,
+    const size_t                    begin,
+    std::atomic<size_t>*            next_file,
+    std::vector<PlacementMap*>*     maps
+) {
+    size_t i;
+    while ((i = next_file->fetch_add(1)) < begin + maps->size()) {
+        PlacementMap* map = new PlacementMap();
+        if (!JplaceProcessor::FromFile((*fns)[i], *map)) {
+            LOG_WARN << "Cannot merge Jplace file '" << (*fns)[i] << "', as it cannot be read.";
+            delete map;
+            continue;
+        }
+        if (map->TreeFingerprint() != *fingerprint) {
+            LOG_WARN << "Cannot merge Jplace file '" << (*fns)[i] << "' with different reference tree.";
+            delete map;
+            continue;
+        }
+
+        // equal fingerprints imply equal edge_nums, so every placement finds its edge.
+        for (Pquery* pqry : map->pqueries) {
+            for (PqueryPlacement* place : pqry->placements) {
+                place->edge = reference->EdgeByNum(place->edge_num);
+            }
+        }
+        map->tree.clear();
+        std::vector<size_t>().swap(map->edge_num_index_);
+        (*maps)[i - begin] = map;
+    }
+}
+
+/**
+ * @brief Returns a string that identifies the topology, the taxa names and the edge_nums of the
+ * reference tree.
+ *
+ * Two PlacementMap%s have the same fingerprint iff their trees are equal in a preorder traversal,
+ * regarding the number of children and the name of each node and the edge_num of each edge.
+ * Branch lengths are not taken into account, because usually those differ slightly. This is the
+ * condition for merging maps, see Merge() and MergeFiles().
+ */
+std::string PlacementMap::TreeFingerprint() const
+{
+    std::string fingerprint;
+    for (
+        PlacementTree::ConstIteratorPreorder it = tree.BeginPreorder();
+        it != tree.EndPreorder();
+        ++it
+    ) {
+        fingerprint += std::to_string(it.Node()->Rank()) + ":";
+        fingerprint += std::to_string(it.Node()->name.size()) + ":" + it.Node()->name + ":";
+        if (!it.IsFirstIteration()) {
+            fingerprint += std::to_string(it.Edge()->edge_num);
+        }
+        fingerprint += ";";
+    }
+    return fingerprint;
+}
+
+/**
+ * @brief Returns a vector that maps from the indices of the edges of another tree to the
+ * corresponding edges of this tree.
+ *
+ * The trees need to have the same TreeFingerprint().
+ */
+std::vector<PlacementTree::EdgeType*> PlacementMap::EdgeMap (const PlacementMap& other)
+{
+    std::vector<PlacementTree::EdgeType*> edge_map (other.tree.EdgeCount(), nullptr);
+
+    PlacementTree::IteratorPreorder      it_t = tree.BeginPreorder();
+    PlacementTree::ConstIteratorPreorder it_o = other.tree.BeginPreorder();
+    for (
+        ;
+        it_t != tree.EndPreorder() && it_o != other.tree.EndPreorder();
+        ++it_t, ++it_o
+    ) {
+        if (it_t.IsFirstIteration()) {
+            continue;
+        }
+        edge_map[it_o.Edge()->Index()] = it_t.Edge();
+    }
+    return edge_map;
+}
+
 /**
  * @brief Recalculates the `like_weight_ratio` of the placements of each Pquery so that their sum
  * is 1.0, while maintaining their ratio to each other.
@@ -226,58 +578,15 @@ void PlacementMap::NormalizeWeightRatios()
  * This function removes all but the most likely placement (the one which has the maximal
  * `like_weight_ratio`) from each Pquery. It additionally sets the `like_weight_ratio` of the
  * remaining placement to 1.0, as this one now is the only one left, thus it's "sum" has to be 1.0.
+ *
+ * This is a shortcut for a PlacementFilter with `max_count = 1` and `normalize = true`.
  */
 void PlacementMap::RestrainToMaxWeightPlacements()
 {
-    for (Pquery* pqry : pqueries) {
-        // init
-        double           max_w = -1.0;
-        PqueryPlacement* max_p;
-
-        for (PqueryPlacement* place : pqry->placements) {
-            // find the maximum of the weight ratios in the placements of this pquery
-            if (place->like_weight_ratio > max_w) {
-                max_w = place->like_weight_ratio;
-                max_p = place;
-            }
-
-            // delete the reference from the edge to the current placement. we will later add the
-            // one that points to the remaining (max weight) placement.
-            PlacementTree::EdgeType* edge = place->edge;
-            std::vector<PqueryPlacement*>::iterator it = edge->placements.begin();
-            for (; it != edge->placements.end(); ++it) {
-                if (*it == place) {
-                    break;
-                }
-            }
-
-            // assert that the edge actually contains a reference to this pquery. if not,
-            // this means that we messed up somewhere else while adding/removing placements...
-            assert(it != edge->placements.end());
-            edge->placements.erase(it);
-        }
-
-        // remove all but the max element from placements by creating a new vector and swapping it.
-        // this is faster and simpler than removing all but one element.
-        std::vector<PqueryPlacement*> np;
-        np.push_back(max_p);
-        pqry->placements.swap(np);
-
-        // np now contains the old placements. delete them (except the one we still need).
-        for (PqueryPlacement* op : np) {
-            if (op != max_p) {
-                delete op;
-            }
-        }
-
-        // now add back the reference from the edge to the pquery.
-        // assert that we now have a single placement in the pquery (the most likely one).
-        assert(pqry->placements.size() == 1 && pqry->placements[0] == max_p);
-        max_p->edge->placements.push_back(max_p);
-
-        // also, set the like_weight_ratio to 1.0, because we do not have any other placements left.
-        max_p->like_weight_ratio = 1.0;
-    }
+    PlacementFilter filter;
+    filter.max_count = 1;
+    filter.normalize = true;
+    filter.Apply(*this);
 }
 
 // =============================================================================
@@ -487,9 +796,11 @@ std::vector<int> PlacementMap::ClosestLeafDistanceHistogramAuto (
     }
 
     // now we know min and max of the distances, so we can calculate the histogram.
+    // values close to the max can still end up in one bin too far due to rounding, so clamp them.
     double bin_size = (max_d - min_d) / bins;
     for (double ld : distrib) {
         int bin = static_cast <int> (std::floor( (ld - min_d) / bin_size ));
+        bin = std::min(bin, bins - 1);
         assert(bin >=0 && bin < bins);
         ++hist[bin];
     }
@@ -512,181 +823,124 @@ double PlacementMap::EMD(const PlacementMap& right, const bool with_pendant_leng
 /**
  * @brief Calculates the Earth Movers Distance between two sets of placements on a fixed reference
  * tree.
+ *
+ * The placement masses are moved from the leaves towards the root in a postorder traversal, and
+ * their movement (mass * distance) is summed up. In theory, it does not matter where we start the
+ * traversal - however, the positions of the placements are given as "proximal_length" on their
+ * branch, which always points away from the root. Thus, we start at the root, to keep it simple.
+ * The masses are normalized by the total mass of each set of placements.
+ *
+ * The calculation is done on an EMDProfile of both sets, which contains their placement masses
+ * sorted by their position on each edge. When calculating many distances, it is thus faster to
+ * create the profiles once and use EMDProfile::EMD() directly, or to use EMDMatrix().
+ *
+ * If the reference trees differ in topology, taxa names or edge_nums, a warning is issued and
+ * -1.0 is returned.
  */
 double PlacementMap::EMD(const PlacementMap& lhs, const PlacementMap& rhs, const bool with_pendant_length)
 {
-    // keep track of the total resulting distance.
-    double distance = 0.0;
-
-    // store a per-node balance of mass. each element in this map contains information about how
-    // much placement mass is pushing from the direction of this node towards the root.
-    // caveat: the masses that are stored here are already fully pushed towards the root, but are
-    // stored here using the node at the lower end of the branch as key.
-    std::unordered_map<const PlacementTree::NodeType*, double> balance;
-
-    // use the sum of masses as normalization factor for the masses.
-    double totalmass_l = lhs.PlacementMass();
-    double totalmass_r = rhs.PlacementMass();
-
-    // disable all debug messages for this function...
-    Logging::LoggingLevel ll = Logging::max_level();
-    Logging::max_level(Logging::kInfo);
-
-    LOG_DBG << "totalmass_l " << totalmass_l;
-    LOG_DBG << "totalmass_r " << totalmass_r;
-
-    // do a postorder traversal on both trees in parallel. while doing so, move placements
-    // from the leaves towards the root and store their movement (mass * distance) in balance[].
-    // in theory, it does not matter where we start the traversal - however, the positions of the
-    // placements are given as "proximal_length" on their branch, which always points away from the
-    // root. thus, if we decided to traverse from a different node than the root, we would have to
-    // take this into account. so we do start at the root, to keep it simple.
-    PlacementTree::ConstIteratorPostorder it_l = lhs.tree.BeginPostorder();
-    PlacementTree::ConstIteratorPostorder it_r = rhs.tree.BeginPostorder();
-    for (
-        ;
-        it_l != lhs.tree.EndPostorder() && it_r != rhs.tree.EndPostorder();
-        ++it_l, ++it_r
-    ) {
-        LOG_DBG << "\033[1;31miteration at node " << it_l.Node()->index_ << ": " << it_l.Node()->name << "\033[0m";
-        LOG_DBG << "current distance " << distance;
+    EMDProfile profile_l (lhs);
+    EMDProfile profile_r (rhs);
 
-        // check whether both trees have identical topology. if they have, the ranks of all nodes
-        // are the same. however, if not, at some point their ranks will differ.
-        if (it_l.Node()->Rank() != it_r.Node()->Rank()) {
-            LOG_WARN << "Calculating EMD on different reference trees not possible.";
-            return -1.0;
-        }
-
-        // if we are at the last iteration, we reached the root, thus we have moved all masses now
-        // and don't need to proceed. if we did, we would count an edge of the root again.
-        if (it_l.IsLastIteration()) {
-            LOG_DBG1 << "last iteration";
-            // we do a check for the mass at the root here for debug purposes.
-            double root_mass = 0.0;
-            for (
-                PlacementTree::NodeType::ConstIteratorLinks n_it = it_l.Node()->BeginLinks();
-                n_it != it_l.Node()->EndLinks();
-                ++n_it
-            ) {
-                assert(balance.count(n_it.Link()->Outer()->Node()));
-                root_mass += balance[n_it.Link()->Outer()->Node()];
-            }
+    if (!profile_l.Compatible(profile_r)) {
+        LOG_WARN << "Calculating EMD on different reference trees not possible.";
+        return -1.0;
+    }
 
-            LOG_DBG << "Mass at root: " << root_mass;
+    return EMDProfile::EMD(profile_l, profile_r, with_pendant_length);
+}
 
-            continue;
-        }
+// =============================================================================
+//     EMD Matrix
+// =============================================================================
 
-        // check whether the data on both reference trees is the same. this has to be done after the
-        // check for last iteration / root node, because we don't want to check this for the root.
-        if (it_l.Node()->name     != it_r.Node()->name ||
-            it_l.Edge()->edge_num != it_r.Edge()->edge_num
-        ) {
-            LOG_WARN << "Inconsistent reference trees in EMD calculation.";
-            return -1.0;
+/**
+ * @brief Calculates the pairwise Earth Movers Distances between all given sets of placements on
+ * a fixed reference tree.
+ *
+ * The result is a SymmetricMatrix of size `n * n` for `n` given PlacementMap%s, where the entry
+ * `(i, j)` contains the same value as `EMD(*maps[i], *maps[j], with_pendant_length)` would.
+ *
+ * In contrast to calling EMD() for every pair of samples, this function creates the EMDProfile
+ * of each sample only once, and checks their reference trees for identical topology, taxa names and
+ * edge_nums only once per sample. The pairwise distances are then calculated from the profiles,
+ * using Options::number_of_threads threads if compiled with `PTHREADS`.
+ *
+ * If the reference trees of the samples are not compatible, a warning is issued and an empty
+ * matrix is returned.
+ */
+SymmetricMatrix<double> PlacementMap::EMDMatrix (
+    const std::vector<const PlacementMap*>& maps, const bool with_pendant_length
+) {
+    // create the profiles of all samples, and check them against the first one.
+    std::vector<EMDProfile> profiles(maps.size());
+    for (size_t i = 0; i < maps.size(); ++i) {
+        profiles[i].Init(*maps[i]);
+        if (!profiles[i].Compatible(profiles[0])) {
+            LOG_WARN << "Calculating EMD on different reference trees not possible.";
+            return SymmetricMatrix<double>();
         }
+    }
 
-        // we now start a "normal" EMD caluclation on the current edge. for this, we store the
-        // masses of all placements sorted by their position on the branch.
-        std::multimap<double, double> edge_balance;
-        LOG_DBG1 << "placing on branch...";
+    SymmetricMatrix<double> matrix (maps.size(), 0.0);
 
-        // add all placements of the branch from the left tree (using positive mass)...
-        for (PqueryPlacement* place : it_l.Edge()->placements) {
-            if (with_pendant_length) {
-                distance += place->like_weight_ratio * place->pendant_length / totalmass_l;
-            }
-            edge_balance.emplace(place->proximal_length, +place->like_weight_ratio / totalmass_l);
-
-            LOG_DBG2 << "placement   " << place->pquery->names[0]->name;
-            LOG_DBG2 << "it_l edge   " << it_l.Edge()->index_;
-            LOG_DBG2 << "added dist  " << place->like_weight_ratio * place->pendant_length / totalmass_l;
-            LOG_DBG2 << "new dist    " << distance;
-            LOG_DBG2 << "emplaced at " << place->proximal_length << ": " << +place->like_weight_ratio / totalmass_l;
-            LOG_DBG2;
-        }
+#ifdef PTHREADS
 
-        // ... and the branch from the right tree (using negative mass)
-        for (PqueryPlacement* place : it_r.Edge()->placements) {
-            if (with_pendant_length) {
-                distance += place->like_weight_ratio * place->pendant_length / totalmass_r;
-            }
-            edge_balance.emplace(place->proximal_length, -place->like_weight_ratio / totalmass_r);
-
-            LOG_DBG2 << "placement   " << place->pquery->names[0]->name;
-            LOG_DBG2 << "it_r edge   " << it_r.Edge()->index_;
-            LOG_DBG2 << "added dist  " << place->like_weight_ratio * place->pendant_length / totalmass_r;
-            LOG_DBG2 << "new dist    " << distance;
-            LOG_DBG2 << "emplaced at " << place->proximal_length << ": " << -place->like_weight_ratio / totalmass_r;
-            LOG_DBG2;
-        }
+    // start all threads. each of them fills an interleaved subset of the pairs of the matrix.
+    int num_threads = static_cast<int>(std::max(Options::number_of_threads, 1u));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back(
+            &PlacementMap::EMDMatrixThread,
+            i, num_threads, &profiles, with_pendant_length, &matrix
+        );
+    }
 
-        LOG_DBG1 << "placed all.";
+    // wait for all threads to finish.
+    for (std::thread& t : threads) {
+        t.join();
+    }
 
-        // distribute placement mass between children of this node, and collect the remaining mass
-        // in mass_s. mass_s then contains the rest mass of the subtree that could not be
-        // distributed among the children and thus has to be moved upwards.
-        double mass_s = 0.0;
-        PlacementTree::LinkType* link = it_l.Link()->Next();
-        while (link != it_l.Link()) {
-            // we do postorder traversal, so we have seen the child nodes of the current node,
-            // which means, they should be in the balance list already.
-            assert(balance.count(link->Outer()->Node()));
+#else
 
-            mass_s += balance[link->Outer()->Node()];
-            link = link->Next();
-        }
-        LOG_DBG1 << "subtrees mass_s " << mass_s;
-        LOG_DBG1 << "entering standard emd part...";
-
-        // start the EMD with the mass that is left over from the subtrees...
-        double cur_pos  = it_l.Edge()->branch_length;
-        double cur_mass = mass_s;
-
-        LOG_DBG1 << "cur_pos  " << cur_pos;
-        LOG_DBG1 << "cur_mass " << cur_mass;
-
-        // ... and move it along the branch, balancing it with the placements found on the branches.
-        // this is basically a standard EMD calculation along the branch.
-        std::multimap<double, double>::reverse_iterator rit;
-        for (rit = edge_balance.rbegin(); rit != edge_balance.rend(); ++rit) {
-            LOG_DBG2 << "at " << rit->first << " with " << rit->second;
-            assert(cur_pos >= rit->first);
-            distance += std::abs(cur_mass) * (cur_pos - rit->first);
-            LOG_DBG2 << "added dist " << std::abs(cur_mass) * (cur_pos - rit->first);
-            LOG_DBG2 << "new dist   " << distance;
-
-            cur_pos   = rit->first;
-            cur_mass += rit->second;
-
-            LOG_DBG2 << "cur_pos  " << cur_pos;
-            LOG_DBG2 << "cur_mass " << cur_mass;
-            LOG_DBG2;
-        }
+    // do a pairwise calculation on all samples.
+    EMDMatrixThread(0, 1, &profiles, with_pendant_length, &matrix);
 
-        // finally, move the rest to the end of the branch and store its mass in balance[],
-        // so that it can be used for the nodes further up in the tree.
-        distance += std::abs(cur_mass) * cur_pos;
-        balance[it_l.Node()] = cur_mass;
+#endif
 
-        LOG_DBG1 << "added dist " << std::abs(cur_mass) * cur_pos;
-        LOG_DBG1 << "new dist   " << distance;
-        LOG_DBG1 << "balance at node " << it_l.Node()->index_ << ": " << it_l.Node()->name << " = " << cur_mass;
-        LOG_DBG1 << "finished standard emd part";
-        LOG_DBG1;
-    }
+    return matrix;
+}
 
-    // check whether we are done with both trees.
-    if (it_l != lhs.tree.EndPostorder() || it_r != rhs.tree.EndPostorder()) {
-        LOG_WARN << "Inconsistent reference trees in EMD calculation.";
-        return -1.0;
+/**
+ * @brief Internal function that fills a subset of the pairs of the EMD matrix.
+ * See EMDMatrix() for more information.
+ *
+ * It takes an offset and an incrementation value and does an interleaved loop over all pairs of
+ * samples in the upper triangle of the matrix.
+ */
+void PlacementMap::EMDMatrixThread (
+    const int                      offset,
+    const int                      incr,
+    const std::vector<EMDProfile>* profiles,
+    const bool                     with_pendant_length,
+    SymmetricMatrix<double>*       matrix
+) {
+    // intermediate storage for the EMD calculation, which is reused for all pairs.
+    std::vector<double> buffer;
+
+    // each thread writes to its own disjoint set of matrix elements, so no locking is needed.
+    size_t pair = 0;
+    for (size_t i = 0; i < profiles->size(); ++i) {
+        for (size_t j = i + 1; j < profiles->size(); ++j, ++pair) {
+            if (pair % incr != static_cast<size_t>(offset)) {
+                continue;
+            }
+            double dist = EMDProfile::EMD(
+                (*profiles)[i], (*profiles)[j], with_pendant_length, buffer
+            );
+            (*matrix)(i, j) = dist;
+        }
     }
-
-    LOG_DBG << "final distance: " << distance;
-    Logging::max_level(ll);
-
-    return distance;
 }
 
 /**
@@ -780,6 +1034,222 @@ void PlacementMap::COG() const
 /**
  * @brief Calculate the Variance of the placements on a tree.
  *
+ * The variance is defined as in VariancePairwise(): It is the sum of the squared, weighted
+ * distances between all pairs of placements, normalized by the squared sum of the
+ * `like_weight_ratio` of all placements. See there for details on the distance between two
+ * placements.
+ *
+ * Instead of comparing all pairs of placements, this function makes use of the fact that the
+ * distance between two placements decomposes along the path between them: It is the sum of their
+ * pendant_lengths plus the distance between their attachment points on the tree. Expanding the
+ * square of this sum yields terms that only need, for every placement, the weighted sum of
+ * distances and of squared distances to all other attachment points.
+ *
+ * Those sums are obtained by a dynamic programming approach: First, the total weight and the
+ * first and second moments of the positions of the placements are aggregated per edge. Then, a
+ * postorder traversal accumulates these VarianceMoments for the subtree below each node, and a
+ * subsequent preorder traversal adds the moments of the rest of the tree. Finally, the distances
+ * between placements on the same edge are added by a sweep over the placements of each edge,
+ * sorted by their position.
+ *
+ * This needs time linear in the number of edges plus `P log P` for `P` placements, instead of the
+ * quadratic time of the pairwise calculation.
+ */
+double PlacementMap::Variance() const
+{
+    // each placement contributes its squared weight to all pairs that it is part of. we call this
+    // its mass here. also, sum up the weights for the normalization.
+    double count = 0.0;
+
+    // collect the data of all placements per edge, sorted by their position on the edge.
+    std::vector<std::vector<VarianceData>> edge_places(tree.EdgeCount());
+    size_t index = 0;
+    for (const Pquery* pqry : this->pqueries) {
+        for (const PqueryPlacement* place : pqry->placements) {
+            VarianceData vdp;
+            vdp.index                = index++;
+            vdp.edge_index           = place->edge->Index();
+            vdp.primary_node_index   = place->edge->PrimaryNode()->Index();
+            vdp.secondary_node_index = place->edge->SecondaryNode()->Index();
+            vdp.pendant_length       = place->pendant_length;
+            vdp.proximal_length      = place->proximal_length;
+            vdp.branch_length        = place->edge->branch_length;
+            vdp.like_weight_ratio    = place->like_weight_ratio;
+            edge_places[vdp.edge_index].push_back(vdp);
+
+            count += place->like_weight_ratio;
+        }
+    }
+    for (std::vector<VarianceData>& places : edge_places) {
+        std::sort(
+            places.begin(), places.end(),
+            [] (const VarianceData& lhs, const VarianceData& rhs) {
+                return lhs.proximal_length < rhs.proximal_length;
+            }
+        );
+    }
+
+    // returns the moments of a set of points, measured from a point that is further away from all
+    // of them by a given length.
+    auto shift = [] (const VarianceMoments& m, const double length) {
+        VarianceMoments r;
+        r.weight           = m.weight;
+        r.distance         = m.distance + length * m.weight;
+        r.squared_distance = m.squared_distance + 2.0 * length * m.distance
+                           + length * length * m.weight;
+        return r;
+    };
+    auto add = [] (VarianceMoments& lhs, const VarianceMoments& rhs) {
+        lhs.weight           += rhs.weight;
+        lhs.distance         += rhs.distance;
+        lhs.squared_distance += rhs.squared_distance;
+    };
+    auto sub = [] (const VarianceMoments& lhs, const VarianceMoments& rhs) {
+        VarianceMoments r;
+        r.weight           = lhs.weight           - rhs.weight;
+        r.distance         = lhs.distance         - rhs.distance;
+        r.squared_distance = lhs.squared_distance - rhs.squared_distance;
+        return r;
+    };
+    const VarianceMoments zero = { 0.0, 0.0, 0.0 };
+
+    // moments of the placements on each edge, measured from the primary node of the edge.
+    std::vector<VarianceMoments> edge_moments(tree.EdgeCount(), zero);
+    for (size_t e = 0; e < edge_places.size(); ++e) {
+        for (const VarianceData& vdp : edge_places[e]) {
+            double mass = vdp.like_weight_ratio * vdp.like_weight_ratio;
+            double x    = vdp.proximal_length;
+            edge_moments[e].weight           += mass;
+            edge_moments[e].distance         += mass * x;
+            edge_moments[e].squared_distance += mass * x * x;
+        }
+    }
+
+    // postorder traversal: moments of all placements below each node, measured from that node.
+    // also, store the contribution of each edge (its placements and the subtree below it) to the
+    // moments of its primary node.
+    std::vector<VarianceMoments> node_lower(tree.NodeCount(), zero);
+    std::vector<VarianceMoments> edge_lower(tree.EdgeCount(), zero);
+    for (
+        PlacementTree::ConstIteratorPostorder it = tree.BeginPostorder();
+        it != tree.EndPostorder();
+        ++it
+    ) {
+        if (it.IsLastIteration()) {
+            continue;
+        }
+        const PlacementTree::EdgeType* edge = it.Edge();
+        size_t e = edge->Index();
+
+        edge_lower[e] = shift(node_lower[edge->SecondaryNode()->Index()], edge->branch_length);
+        add(edge_lower[e], edge_moments[e]);
+        add(node_lower[edge->PrimaryNode()->Index()], edge_lower[e]);
+    }
+
+    // preorder traversal: moments of all placements of the tree, measured from each node, and
+    // moments of all placements above each edge (i.e., not on the edge and not in the subtree
+    // below it), measured from the primary node of the edge.
+    std::vector<VarianceMoments> node_total(tree.NodeCount(), zero);
+    std::vector<VarianceMoments> edge_upper(tree.EdgeCount(), zero);
+    for (
+        PlacementTree::ConstIteratorPreorder it = tree.BeginPreorder();
+        it != tree.EndPreorder();
+        ++it
+    ) {
+        if (it.IsFirstIteration()) {
+            node_total[it.Node()->Index()] = node_lower[it.Node()->Index()];
+            continue;
+        }
+        const PlacementTree::EdgeType* edge = it.Edge();
+        size_t e  = edge->Index();
+        size_t pn = edge->PrimaryNode()->Index();
+        size_t sn = edge->SecondaryNode()->Index();
+        double bl = edge->branch_length;
+
+        edge_upper[e] = sub(node_total[pn], edge_lower[e]);
+
+        // the placements of the edge, measured from its secondary node.
+        VarianceMoments em;
+        em.weight           = edge_moments[e].weight;
+        em.distance         = bl * em.weight - edge_moments[e].distance;
+        em.squared_distance = bl * bl * em.weight - 2.0 * bl * edge_moments[e].distance
+                            + edge_moments[e].squared_distance;
+
+        node_total[sn] = node_lower[sn];
+        add(node_total[sn], shift(edge_upper[e], bl));
+        add(node_total[sn], em);
+    }
+
+    // with a mass m and pendant length p for each placement, and the distance t between the
+    // attachment points of two placements a and b, we need the sum over all ordered pairs of
+    // m_a * m_b * (p_a + p_b + t_ab)^2. we expand the square and collect the sums of its terms.
+    double mass_sum        = 0.0;
+    double mass_pend_sum   = 0.0;
+    double mass_pend2_sum  = 0.0;
+    double diagonal_sum    = 0.0;
+    double cross_sum       = 0.0;
+    double tree_sum        = 0.0;
+    for (size_t e = 0; e < edge_places.size(); ++e) {
+        const std::vector<VarianceData>& places = edge_places[e];
+        if (places.size() == 0) {
+            continue;
+        }
+        const PlacementTree::EdgeType* edge = tree.EdgeAt(e);
+        const VarianceMoments& up  = edge_upper[e];
+        const VarianceMoments& low = node_lower[edge->SecondaryNode()->Index()];
+        const VarianceMoments& em  = edge_moments[e];
+        double bl = edge->branch_length;
+
+        // sweep over the placements of this edge, keeping track of the mass and first moment of
+        // the placements that are closer to the primary node.
+        double prefix_mass = 0.0;
+        double prefix_dist = 0.0;
+        for (size_t i = 0; i < places.size(); ++i) {
+            const VarianceData& vdp = places[i];
+            double mass = vdp.like_weight_ratio * vdp.like_weight_ratio;
+            double pend = vdp.pendant_length;
+            double x    = vdp.proximal_length;
+            double y    = bl - x;
+
+            // include this placement in the prefix. its distance to itself is zero anyway.
+            prefix_mass += mass;
+            prefix_dist += mass * x;
+
+            // weighted sum of distances and of squared distances from this attachment point to
+            // all attachment points: above the edge, below the edge, and on the edge.
+            double dist = up.distance  + x * up.weight
+                        + low.distance + y * low.weight
+                        + x * prefix_mass - prefix_dist
+                        + (em.distance - prefix_dist) - x * (em.weight - prefix_mass);
+            double sqrd = up.squared_distance  + 2.0 * x * up.distance  + x * x * up.weight
+                        + low.squared_distance + 2.0 * y * low.distance + y * y * low.weight
+                        + x * x * em.weight - 2.0 * x * em.distance + em.squared_distance;
+
+            mass_sum       += mass;
+            mass_pend_sum  += mass * pend;
+            mass_pend2_sum += mass * pend * pend;
+            diagonal_sum   += mass * mass * 4.0 * pend * pend;
+            cross_sum      += mass * pend * dist;
+            tree_sum       += mass * sqrd;
+        }
+    }
+
+    // the sum over all ordered pairs includes each pair twice, and also the pairs of each
+    // placement with itself, which the formula wrongly assigns a distance of twice its pendant
+    // length. remove those, then normalize.
+    double variance = 2.0 * mass_sum * mass_pend2_sum + 2.0 * mass_pend_sum * mass_pend_sum
+                    + 4.0 * cross_sum + tree_sum;
+    variance = (variance - diagonal_sum) / 2.0;
+    return ((variance / count) / count);
+}
+
+/**
+ * @brief Calculate the Variance of the placements on a tree, using a pairwise comparison of all
+ * placements.
+ *
+ * This function yields the same result as Variance() (up to floating point rounding), but needs
+ * time quadratic in the number of placements. It is thus mainly useful as a reference for testing.
+ *
  * The variance is a measure of how far a set of items is spread out
  * (http://en.wikipedia.org/wiki/Variance). In many cases, it can be measured using the mean of the
  * items. However, when considering placements on a tree, this does not truly measure how far they
@@ -793,7 +1263,7 @@ void PlacementMap::COG() const
  * might occur:
  *
  *   1. Both placements are on the same branch.
- *      In this case, their distance is caluclated as the sum of their pendant_lengths and their
+ *      In this case, their distance is calculated as the sum of their pendant_lengths and their
  *      difference in proximal_lengths.
  *
  *   2. The path between the placements includes the root.
@@ -820,7 +1290,9 @@ void PlacementMap::COG() const
  * To speed this up, we instead use a distance matrix that is calculated in the beginning of the
  * algorithm and contains the pairwise distances between all nodes of the tree. Using this, we do
  * not need to find paths between placements, but simply go to the nodes at the end of the branches
- * of the placements and do a lookup for those nodes.
+ * of the placements and do a lookup for those nodes. As the matrix needs quadratic memory, trees
+ * with more than kVarianceMatrixMaxNodes nodes use a PlacementTreeDistanceIndex for the lookups
+ * instead, which is slower, but only needs linear memory.
  *
  * With this technique, we can calculate the distances between the placements for all
  * three cases (promixal-promixal, proximal-distal and distal-proximal) cheaply. The wanted distance
@@ -843,165 +1315,371 @@ void PlacementMap::COG() const
  * number of elements). However, as this is not required (placements with small ratio can be
  * dropped, so that their sum per pquery is less than 1.0), we need to calculate this number
  * manually here.
+ *
+ * For speed, the data of the placements is stored as a structure of arrays. The pairs are
+ * processed in blocks of placements, which are distributed dynamically over
+ * Options::number_of_threads threads if compiled with `PTHREADS`, and tiled for cache reuse.
+ * The distances are calculated with AVX-512 or AVX2 instructions if genesis is compiled for them,
+ * e.g., with the CMake option `USE_NATIVE_ARCH`, see VariancePartial().
  */
-double PlacementMap::Variance() const
+double PlacementMap::VariancePairwise() const
 {
     // init
     double variance = 0.0;
     double count    = 0.0;
 
-    // create a VarianceData object for every placement and copy all interesting data into it.
-    // this way, we won't have to do all the pointer dereferencing during the actual calculations,
-    // and furthermore, the data is close in memory. this gives a tremendous speedup!
-    size_t index = 0;
-    std::vector<VarianceData> vd_placements;
-    vd_placements.reserve(PlacementCount());
+    // copy all interesting data of the placements into separate contiguous arrays. this way, we
+    // won't have to do all the pointer dereferencing during the actual calculations, and
+    // furthermore, the data can be processed with vector instructions.
+    VarianceArrays arrays;
     for (const Pquery* pqry : this->pqueries) {
         for (const PqueryPlacement* place : pqry->placements) {
-            VarianceData vdp;
-            vdp.index                = index++;
-            vdp.edge_index           = place->edge->Index();
-            vdp.primary_node_index   = place->edge->PrimaryNode()->Index();
-            vdp.secondary_node_index = place->edge->SecondaryNode()->Index();
-            vdp.pendant_length       = place->pendant_length;
-            vdp.proximal_length      = place->proximal_length;
-            vdp.branch_length        = place->edge->branch_length;
-            vdp.like_weight_ratio    = place->like_weight_ratio;
-            vd_placements.push_back(vdp);
+            double pendant  = place->pendant_length;
+            double proximal = place->proximal_length;
+            double branch   = place->edge->branch_length;
+
+            arrays.edge_index.push_back(place->edge->Index());
+            arrays.primary_node_index.push_back(place->edge->PrimaryNode()->Index());
+            arrays.secondary_node_index.push_back(place->edge->SecondaryNode()->Index());
+            arrays.pendant_length.push_back(pendant);
+            arrays.proximal_length.push_back(proximal);
+            arrays.proximal_distance.push_back(pendant + proximal);
+            arrays.distal_distance.push_back(pendant + branch - proximal);
+            arrays.like_weight_ratio.push_back(place->like_weight_ratio);
+
+            count += place->like_weight_ratio;
         }
     }
 
     // also, calculate a matrix containing the pairwise distance between all nodes. this way, we
-    // do not need to search a path between placements every time.
-    Matrix<double>* node_distances = tree.NodeDistanceMatrix();
+    // do not need to search a path between placements every time. for large trees, we use the
+    // distance index instead.
+    Matrix<double>                              node_distances;
+    std::unique_ptr<PlacementTreeDistanceIndex> index;
+    const double*                               distances  = nullptr;
+    const size_t                                node_count = tree.NodeCount();
+    if (node_count <= kVarianceMatrixMaxNodes) {
+        node_distances = tree.NodeDistanceMatrix();
+        distances      = node_distances.data();
+    } else {
+        index.reset(new PlacementTreeDistanceIndex(tree));
+    }
 
-#ifdef PTHREADS
+    // the placements are processed in blocks of consecutive indices, each of them contributing the
+    // pairs with all placements of higher index. we store the sum of each block separately and add
+    // them up in order afterwards, so that the result does not depend on the number of threads.
+    size_t num_blocks = (arrays.like_weight_ratio.size() + kVarianceBlockSize - 1)
+                      / kVarianceBlockSize;
+    std::vector<double> block_sums(num_blocks, 0.0);
+    std::atomic<size_t> next_block(0);
 
-    // prepare storage for thread data.
-    int num_threads = Options::number_of_threads;
-    std::vector<double>       partials(num_threads, 0.0);
-    std::vector<double>       counts  (num_threads, 0.0);
-    std::vector<std::thread*> threads (num_threads, nullptr);
+#ifdef PTHREADS
 
-    // start all threads.
+    // start all threads. they take the next unprocessed block whenever they are done with one.
+    // as the blocks with low indices contain more pairs, this balances the load between threads.
+    int num_threads = static_cast<int>(std::max(Options::number_of_threads, 1u));
+    std::vector<std::thread> threads;
     for (int i = 0; i < num_threads; ++i) {
-        threads[i] = new std::thread (std::bind (
+        threads.emplace_back(
             &PlacementMap::VarianceThread, this,
-            i, num_threads, &vd_placements, node_distances, &partials[i], &counts[i]
-        ));
+            &next_block, &arrays, distances, node_count, index.get(), &block_sums
+        );
     }
 
-    // wait for all threads to finish, collect their results.
-    for (int i = 0; i < num_threads; ++i) {
-        threads[i]->join();
-        variance += partials[i];
-        count    += counts[i];
+    // wait for all threads to finish.
+    for (std::thread& t : threads) {
+        t.join();
     }
 
 #else
 
     // do a pairwise calculation on all placements.
-    int progress    = 0;
-    for (const VarianceData& place_a : vd_placements) {
-        LOG_PROG(++progress, vd_placements.size()) << "of Variance() finished.";
-        variance += VariancePartial(place_a, vd_placements, *node_distances);
-        count    += place_a.like_weight_ratio;
-    }
+    VarianceThread(&next_block, &arrays, distances, node_count, index.get(), &block_sums);
 
 #endif
 
-    // cleanup, then return the normalized value.
-    delete node_distances;
+    // collect the results.
+    for (double block_sum : block_sums) {
+        variance += block_sum;
+    }
+
+    // return the normalized value.
     return ((variance / count) / count);
 }
 
 /**
- * @brief Internal function that calculates the sum of distances for the variance that is
- * contributed by a subset of the placements. See Variance() for more information.
+ * @brief Internal function that processes blocks of placements for the variance, until all blocks
+ * are done. See VariancePairwise() for more information.
  *
- * This function is intended to be called by Variance() -- it is not a stand-alone function.
- * It takes an offset and an incrementation value and does an interleaved loop over the placements,
- * similar to the sequential version for calculating the variance.
+ * This function is intended to be called by VariancePairwise() -- it is not a stand-alone
+ * function. Multiple instances of it can run in parallel: each takes the next unprocessed block
+ * from the shared counter, and stores the sum of the block in the respective element of
+ * `block_sums`.
  */
 void PlacementMap::VarianceThread (
-    const int                        offset,
-    const int                        incr,
-    const std::vector<VarianceData>* pqrys,
-    const Matrix<double>*            node_distances,
-    double*                          partial,
-    double*                          count
+    std::atomic<size_t>*              next_block,
+    const VarianceArrays*             arrays,
+    const double*                     node_distances,
+    const size_t                      node_count,
+    const PlacementTreeDistanceIndex* index,
+    std::vector<double>*              block_sums
 ) const {
-    // use internal variables to avoid false sharing.
-    assert(*partial == 0.0 && *count == 0.0);
-    double tmp_partial = 0.0;
-    double tmp_count   = 0.0;
-
-    // iterate over the pqueries, starting at offset and interleaved with incr for each thread.
-    for (size_t i = offset; i < pqrys->size(); i += incr) {
-        LOG_PROG(i, pqrys->size()) << "of Variance() finished (Thread " << offset << ").";
-
-        const VarianceData& place_a = (*pqrys)[i];
-        tmp_partial += VariancePartial(place_a, *pqrys, *node_distances);
-        tmp_count   += place_a.like_weight_ratio;
+    size_t num_places = arrays->like_weight_ratio.size();
+
+    size_t block;
+    while ((block = (*next_block)++) < block_sums->size()) {
+        LOG_PROG(block, block_sums->size()) << "of Variance() finished.";
+
+        size_t begin = block * kVarianceBlockSize;
+        size_t end   = std::min(begin + kVarianceBlockSize, num_places);
+        (*block_sums)[block] = VarianceBlock(
+            begin, end, *arrays, node_distances, node_count, index
+        );
     }
+}
 
-    // return the results.
-    *partial = tmp_partial;
-    *count   = tmp_count;
+/**
+ * @brief Internal function that calculates the sum of distances for the variance that is
+ * contributed by a block of placements. See VariancePairwise() for more information.
+ *
+ * For each placement in the range `[begin_a, end_a)`, the pairs with all placements of higher index
+ * are evaluated. In order to make good use of the caches, the latter are processed in tiles, which
+ * are reused for all placements of the block.
+ */
+double PlacementMap::VarianceBlock (
+    const size_t                      begin_a,
+    const size_t                      end_a,
+    const VarianceArrays&             arrays,
+    const double*                     node_distances,
+    const size_t                      node_count,
+    const PlacementTreeDistanceIndex* index
+) const {
+    size_t num_places = arrays.like_weight_ratio.size();
+    double sum = 0.0;
+
+    for (size_t tile = begin_a; tile < num_places; tile += kVarianceTileSize) {
+        size_t tile_end = std::min(tile + kVarianceTileSize, num_places);
+        for (size_t a = begin_a; a < end_a; ++a) {
+            // only use pairs (a, b) with a < b, so that each pair is evaluated once.
+            size_t begin_b = std::max(tile, a + 1);
+            if (begin_b >= tile_end) {
+                continue;
+            }
+            sum += VariancePartial(
+                a, begin_b, tile_end, arrays, node_distances, node_count, index
+            );
+        }
+    }
+
+    return sum;
 }
 
 /**
- * @brief Internal function that calculates the sum of distances contributed by one placement for
- * the variance. See Variance() for more information.
+ * @brief Internal function that calculates the sum of distances contributed by one placement and
+ * a range of other placements for the variance. See VariancePairwise() for more information.
+ *
+ * This function is intended to be called by VarianceBlock() -- it is not a stand-alone function.
+ * If the code is compiled with support for AVX-512 or AVX2, the distances are calculated using the
+ * respective vector instructions. The remaining placements are processed by the scalar code. The
+ * instruction set is chosen at compile time: the default build uses the scalar code only, while
+ * the CMake option `USE_NATIVE_ARCH` compiles for the CPU of the build machine (`-march=native`)
+ * and thus enables the vector code where supported.
  *
- * This function is intended to be called by Variance() or VarianceThread() -- it is not a
- * stand-alone function.
+ * If no `node_distances` matrix is given, the distances between nodes are looked up in the `index`
+ * instead, using scalar code only.
  */
 double PlacementMap::VariancePartial (
-    const VarianceData&              place_a,
-    const std::vector<VarianceData>& pqrys_b,
-    const Matrix<double>&            node_distances
+    const size_t                      index_a,
+    const size_t                      begin_b,
+    const size_t                      end_b,
+    const VarianceArrays&             arrays,
+    const double*                     node_distances,
+    const size_t                      node_count,
+    const PlacementTreeDistanceIndex* index
 ) const {
+    if (!node_distances) {
+        return VariancePartialIndexed(index_a, begin_b, end_b, arrays, *index);
+    }
+
+    // data of placement a, and the rows of the distance matrix for the nodes of its edge.
+    const int    edge_a    = arrays.edge_index[index_a];
+    const double pend_a    = arrays.pendant_length[index_a];
+    const double prox_a    = arrays.proximal_length[index_a];
+    const double prox_d_a  = arrays.proximal_distance[index_a];
+    const double dist_d_a  = arrays.distal_distance[index_a];
+    const double* row_p_a  = node_distances + arrays.primary_node_index[index_a]   * node_count;
+    const double* row_s_a  = node_distances + arrays.secondary_node_index[index_a] * node_count;
+
+    // data of the placements b.
+    const int*    edge_b   = arrays.edge_index.data();
+    const int*    prim_b   = arrays.primary_node_index.data();
+    const int*    sec_b    = arrays.secondary_node_index.data();
+    const double* pend_b   = arrays.pendant_length.data();
+    const double* prox_b   = arrays.proximal_length.data();
+    const double* prox_d_b = arrays.proximal_distance.data();
+    const double* dist_d_b = arrays.distal_distance.data();
+    const double* lwr_b    = arrays.like_weight_ratio.data();
+
     double sum = 0.0;
-    double dd, pd, dp, min;
+    size_t b   = begin_b;
+
+#if defined(__AVX512F__)
+
+    const __m512d v_pend_a   = _mm512_set1_pd(pend_a);
+    const __m512d v_prox_a   = _mm512_set1_pd(prox_a);
+    const __m512d v_prox_d_a = _mm512_set1_pd(prox_d_a);
+    const __m512d v_dist_d_a = _mm512_set1_pd(dist_d_a);
+    const __m512i v_edge_a   = _mm512_set1_epi64(edge_a);
+    const __m512d v_zero     = _mm512_setzero_pd();
+    __m512d       v_sum      = _mm512_setzero_pd();
+
+    // the gathers are masked with all lanes enabled, which avoids spurious warnings about
+    // uninitialized values with some compilers.
+    for (; b + 8 <= end_b; b += 8) {
+        __m256i v_prim_b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prim_b + b));
+        __m256i v_sec_b  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sec_b  + b));
+        __m512d v_pp = _mm512_mask_i32gather_pd(v_zero, 0xFF, v_prim_b, row_p_a, 8);
+        __m512d v_sp = _mm512_mask_i32gather_pd(v_zero, 0xFF, v_prim_b, row_s_a, 8);
+        __m512d v_ps = _mm512_mask_i32gather_pd(v_zero, 0xFF, v_sec_b,  row_p_a, 8);
+
+        // proximal-proximal, proximal-distal and distal-proximal case, and their minimum.
+        __m512d v_prox_d_b = _mm512_loadu_pd(prox_d_b + b);
+        __m512d v_dist_d_b = _mm512_loadu_pd(dist_d_b + b);
+        __m512d v_dd = _mm512_add_pd(_mm512_add_pd(v_prox_d_a, v_pp), v_prox_d_b);
+        __m512d v_pd = _mm512_add_pd(_mm512_add_pd(v_dist_d_a, v_sp), v_prox_d_b);
+        __m512d v_dp = _mm512_add_pd(_mm512_add_pd(v_prox_d_a, v_ps), v_dist_d_b);
+        __m512d v_min = _mm512_min_pd(v_dd, _mm512_min_pd(v_pd, v_dp));
+
+        // same branch case.
+        __m512d v_same = _mm512_add_pd(
+            _mm512_add_pd(v_pend_a, _mm512_loadu_pd(pend_b + b)),
+            _mm512_abs_pd(_mm512_sub_pd(v_prox_a, _mm512_loadu_pd(prox_b + b)))
+        );
+        __m512i v_edge_b = _mm512_cvtepi32_epi64(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(edge_b + b))
+        );
+        __mmask8 same = _mm512_cmpeq_epi64_mask(v_edge_a, v_edge_b);
+        __m512d v_dist = _mm512_mask_blend_pd(same, v_min, v_same);
+
+        v_dist = _mm512_mul_pd(v_dist, _mm512_loadu_pd(lwr_b + b));
+        v_sum  = _mm512_add_pd(v_sum, _mm512_mul_pd(v_dist, v_dist));
+    }
+    sum += _mm512_reduce_add_pd(v_sum);
+
+#elif defined(__AVX2__)
+
+    const __m256d v_pend_a   = _mm256_set1_pd(pend_a);
+    const __m256d v_prox_a   = _mm256_set1_pd(prox_a);
+    const __m256d v_prox_d_a = _mm256_set1_pd(prox_d_a);
+    const __m256d v_dist_d_a = _mm256_set1_pd(dist_d_a);
+    const __m256d v_sign     = _mm256_set1_pd(-0.0);
+    const __m128i v_edge_a   = _mm_set1_epi32(edge_a);
+    const __m256d v_zero     = _mm256_setzero_pd();
+    const __m256d v_all      = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    __m256d       v_sum      = _mm256_setzero_pd();
+
+    // the gathers are masked with all lanes enabled, see above.
+    for (; b + 4 <= end_b; b += 4) {
+        __m128i v_prim_b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prim_b + b));
+        __m128i v_sec_b  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sec_b  + b));
+        __m256d v_pp = _mm256_mask_i32gather_pd(v_zero, row_p_a, v_prim_b, v_all, 8);
+        __m256d v_sp = _mm256_mask_i32gather_pd(v_zero, row_s_a, v_prim_b, v_all, 8);
+        __m256d v_ps = _mm256_mask_i32gather_pd(v_zero, row_p_a, v_sec_b,  v_all, 8);
+
+        // proximal-proximal, proximal-distal and distal-proximal case, and their minimum.
+        __m256d v_prox_d_b = _mm256_loadu_pd(prox_d_b + b);
+        __m256d v_dist_d_b = _mm256_loadu_pd(dist_d_b + b);
+        __m256d v_dd = _mm256_add_pd(_mm256_add_pd(v_prox_d_a, v_pp), v_prox_d_b);
+        __m256d v_pd = _mm256_add_pd(_mm256_add_pd(v_dist_d_a, v_sp), v_prox_d_b);
+        __m256d v_dp = _mm256_add_pd(_mm256_add_pd(v_prox_d_a, v_ps), v_dist_d_b);
+        __m256d v_min = _mm256_min_pd(v_dd, _mm256_min_pd(v_pd, v_dp));
+
+        // same branch case.
+        __m256d v_same = _mm256_add_pd(
+            _mm256_add_pd(v_pend_a, _mm256_loadu_pd(pend_b + b)),
+            _mm256_andnot_pd(v_sign, _mm256_sub_pd(v_prox_a, _mm256_loadu_pd(prox_b + b)))
+        );
+        __m128i v_edge_b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(edge_b + b));
+        __m256d same = _mm256_castsi256_pd(
+            _mm256_cvtepi32_epi64(_mm_cmpeq_epi32(v_edge_a, v_edge_b))
+        );
+        __m256d v_dist = _mm256_blendv_pd(v_min, v_same, same);
+
+        v_dist = _mm256_mul_pd(v_dist, _mm256_loadu_pd(lwr_b + b));
+        v_sum  = _mm256_add_pd(v_sum, _mm256_mul_pd(v_dist, v_dist));
+    }
 
-    for (const VarianceData& place_b : pqrys_b) {
-        // check whether it is same placement (a=b, nothing to do, as their distance is zero),
-        // or a pair of placements that was already calculated (skip it also).
-        if (place_a.index >= place_b.index) {
-            continue;
-        }
+    double partial[4];
+    _mm256_storeu_pd(partial, v_sum);
+    sum += (partial[0] + partial[1]) + (partial[2] + partial[3]);
 
-        // same branch case
-        if (place_a.edge_index == place_b.edge_index) {
-            sum += place_a.pendant_length
-                +  std::abs(place_a.proximal_length - place_b.proximal_length)
-                +  place_b.pendant_length;
-            continue;
+#endif
+
+    // scalar code for the remaining placements (or all of them, if no vector instructions are
+    // available).
+    for (; b < end_b; ++b) {
+        double dist;
+        if (edge_a == edge_b[b]) {
+            // same branch case
+            dist = pend_a + std::abs(prox_a - prox_b[b]) + pend_b[b];
+        } else {
+            // proximal-proximal, proximal-distal and distal-proximal case
+            double dd = prox_d_a + row_p_a[prim_b[b]] + prox_d_b[b];
+            double pd = dist_d_a + row_s_a[prim_b[b]] + prox_d_b[b];
+            double dp = prox_d_a + row_p_a[sec_b[b]]  + dist_d_b[b];
+            dist = std::min(dd, std::min(pd, dp));
         }
+        dist *= lwr_b[b];
+        sum  += dist * dist;
+    }
 
-        // proximal-proximal case
-        dd = place_a.pendant_length + place_a.proximal_length
-           + node_distances(place_a.primary_node_index, place_b.primary_node_index)
-           + place_b.proximal_length + place_b.pendant_length;
-
-        // proximal-distal case
-        pd = place_a.pendant_length + place_a.branch_length - place_a.proximal_length
-           + node_distances(place_a.secondary_node_index, place_b.primary_node_index)
-           + place_b.proximal_length + place_b.pendant_length;
-
-        // distal-proximal case
-        dp = place_a.pendant_length + place_a.proximal_length
-           + node_distances(place_a.primary_node_index, place_b.secondary_node_index)
-           + place_b.branch_length - place_b.proximal_length + place_b.pendant_length;
-
-        // find min of the three cases and normalize it to the weight ratios.
-        min  = std::min(dd, std::min(pd, dp));
-        min *= place_a.like_weight_ratio * place_b.like_weight_ratio;
-        sum += min * min;
+    // normalize to the weight ratio of placement a.
+    double lwr_a = arrays.like_weight_ratio[index_a];
+    return sum * lwr_a * lwr_a;
+}
+
+/**
+ * @brief Internal function that does the same as VariancePartial(), but looks up the distances
+ * between nodes in a PlacementTreeDistanceIndex.
+ */
+double PlacementMap::VariancePartialIndexed (
+    const size_t                      index_a,
+    const size_t                      begin_b,
+    const size_t                      end_b,
+    const VarianceArrays&             arrays,
+    const PlacementTreeDistanceIndex& index
+) const {
+    const int    edge_a   = arrays.edge_index[index_a];
+    const int    prim_a   = arrays.primary_node_index[index_a];
+    const int    sec_a    = arrays.secondary_node_index[index_a];
+    const double pend_a   = arrays.pendant_length[index_a];
+    const double prox_a   = arrays.proximal_length[index_a];
+    const double prox_d_a = arrays.proximal_distance[index_a];
+    const double dist_d_a = arrays.distal_distance[index_a];
+
+    double sum = 0.0;
+    for (size_t b = begin_b; b < end_b; ++b) {
+        double dist;
+        if (edge_a == arrays.edge_index[b]) {
+            // same branch case
+            dist = pend_a + std::abs(prox_a - arrays.proximal_length[b])
+                 + arrays.pendant_length[b];
+        } else {
+            // proximal-proximal, proximal-distal and distal-proximal case
+            const int prim_b = arrays.primary_node_index[b];
+            const int sec_b  = arrays.secondary_node_index[b];
+            double dd = prox_d_a + index.Distance(prim_a, prim_b) + arrays.proximal_distance[b];
+            double pd = dist_d_a + index.Distance(sec_a,  prim_b) + arrays.proximal_distance[b];
+            double dp = prox_d_a + index.Distance(prim_a, sec_b)  + arrays.distal_distance[b];
+            dist = std::min(dd, std::min(pd, dp));
+        }
+        dist *= arrays.like_weight_ratio[b];
+        sum  += dist * dist;
     }
 
-    return sum;
+    // normalize to the weight ratio of placement a.
+    double lwr_a = arrays.like_weight_ratio[index_a];
+    return sum * lwr_a * lwr_a;
 }
 
 // =============================================================================
@@ -1059,7 +1737,7 @@ bool PlacementMap::Validate (bool check_values, bool break_on_values) const
     }
 
     // check edges
-    EdgeNumMapType edge_num_map;
+    std::unordered_map<int, const PlacementTree::EdgeType*> edge_num_map;
     size_t edge_place_count = 0;
     for (
         PlacementTree::ConstIteratorEdges it_e = tree.BeginEdges();
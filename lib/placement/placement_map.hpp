@@ -8,12 +8,16 @@
  * @ingroup placement
  */
 
+#include <atomic>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "placement/emd_profile.hpp"
 #include "placement/placement_tree.hpp"
 #include "placement/pquery.hpp"
+#include "utils/arena.hpp"
+#include "utils/matrix.hpp"
 
 namespace genesis {
 
@@ -28,19 +32,25 @@ public:
     //     Constructor & Destructor
     // -----------------------------------------------------
 
-    PlacementMap () {}
-    PlacementMap (PlacementTree& ptree) : tree(ptree) {}
+    PlacementMap () : edge_num_offset_(0) {}
+    PlacementMap (PlacementTree& ptree) : tree(ptree), edge_num_offset_(0) {}
 
     PlacementMap (const PlacementMap& other);
     PlacementMap& operator = (const PlacementMap& other);
 
     ~PlacementMap();
     void clear();
+    void swap (PlacementMap& other);
 
-    typedef std::unordered_map<int, PlacementTree::EdgeType*> EdgeNumMapType;
-    EdgeNumMapType* EdgeNumMap() const;
+    Pquery*          AddPquery();
+    PqueryPlacement* AddPlacement (Pquery* pqry);
+    PqueryName*      AddName (Pquery* pqry);
+
+    bool                     UpdateEdgeNumIndex();
+    PlacementTree::EdgeType* EdgeByNum (const int edge_num) const;
 
     bool Merge(const PlacementMap& other);
+    bool MergeFiles (const std::vector<std::string>& fns);
     void NormalizeWeightRatios();
     void RestrainToMaxWeightPlacements();
 
@@ -62,16 +72,71 @@ public:
     static double EMD (const PlacementMap& left, const PlacementMap& right, const bool with_pendant_length = true);
     double EMD (const PlacementMap& other, const bool with_pendant_length = true) const;
 
+    static SymmetricMatrix<double> EMDMatrix (
+        const std::vector<const PlacementMap*>& maps, const bool with_pendant_length = true
+    );
+
     void   COG() const;
 
+    std::string TreeFingerprint() const;
+
+    // -----------------------------------------------------
+    //     Merging
+    // -----------------------------------------------------
+
+protected:
+    /**
+     * @brief Number of files per thread that MergeFiles() parses before collecting their
+     * pqueries.
+     */
+    static const size_t kMergeFilesWindow = 16;
+
+    static void MergeFilesThread (
+        const PlacementMap*             reference,
+        const std::string*              fingerprint,
+        const std::vector<std::string>* fns,
+        const size_t                    begin,
+        std::atomic<size_t>*            next_file,
+        std::vector<PlacementMap*>*     maps
+    );
+
+    void ReserveFor (const PlacementMap& other);
+
+    std::vector<PlacementTree::EdgeType*> EdgeMap (const PlacementMap& other);
+
+    // -----------------------------------------------------
+    //     EMD Matrix
+    // -----------------------------------------------------
+
+protected:
+    static void EMDMatrixThread (
+        const int                      offset,
+        const int                      incr,
+        const std::vector<EMDProfile>* profiles,
+        const bool                     with_pendant_length,
+        SymmetricMatrix<double>*       matrix
+    );
+
     // -----------------------------------------------------
     //     Variance
     // -----------------------------------------------------
 
 public:
     double Variance() const;
+    double VariancePairwise() const;
 
 protected:
+    /**
+     * @brief Intermediate POD struct used for the variance calculations. It stores the total
+     * weight of a set of placements, and their weighted sums of distances and squared distances,
+     * measured from some point on the tree.
+     */
+    typedef struct {
+        double weight;
+        double distance;
+        double squared_distance;
+    } VarianceMoments;
+
     /** @brief Intermediate POD struct used for speeding up the variance calculations. */
     typedef struct {
         size_t index;
@@ -85,19 +150,68 @@ protected:
         double like_weight_ratio;
     } VarianceData;
 
+    /**
+     * @brief Intermediate structure of arrays used for speeding up the pairwise variance
+     * calculations. Each array contains one value per placement.
+     */
+    typedef struct {
+        std::vector<int>    edge_index;
+        std::vector<int>    primary_node_index;
+        std::vector<int>    secondary_node_index;
+
+        std::vector<double> pendant_length;
+        std::vector<double> proximal_length;
+        std::vector<double> proximal_distance;
+        std::vector<double> distal_distance;
+        std::vector<double> like_weight_ratio;
+    } VarianceArrays;
+
+    /** @brief Number of placements that are processed as one unit of work by VarianceThread(). */
+    static const size_t kVarianceBlockSize = 64;
+
+    /** @brief Number of placements that are processed as one cache tile by VarianceBlock(). */
+    static const size_t kVarianceTileSize  = 2048;
+
+    /**
+     * @brief Maximal number of nodes of the tree for which VariancePairwise() uses a node distance
+     * matrix. For larger trees, a PlacementTreeDistanceIndex is used instead.
+     */
+    static const size_t kVarianceMatrixMaxNodes = 4096;
+
     void VarianceThread (
-        const int                        offset,
-        const int                        incr,
-        const std::vector<VarianceData>* pqrys,
-        const Matrix<double>*            node_distances,
-        double*                          partial,
-        double*                          count
+        std::atomic<size_t>*              next_block,
+        const VarianceArrays*             arrays,
+        const double*                     node_distances,
+        const size_t                      node_count,
+        const PlacementTreeDistanceIndex* index,
+        std::vector<double>*              block_sums
+    ) const;
+
+    double VarianceBlock (
+        const size_t                      begin_a,
+        const size_t                      end_a,
+        const VarianceArrays&             arrays,
+        const double*                     node_distances,
+        const size_t                      node_count,
+        const PlacementTreeDistanceIndex* index
     ) const;
 
     double VariancePartial (
-        const VarianceData&              place_a,
-        const std::vector<VarianceData>& pqrys_b,
-        const Matrix<double>&            node_distances
+        const size_t                      index_a,
+        const size_t                      begin_b,
+        const size_t                      end_b,
+        const VarianceArrays&             arrays,
+        const double*                     node_distances,
+        const size_t                      node_count,
+        const PlacementTreeDistanceIndex* index
+    ) const;
+
+    double VariancePartialIndexed (
+        const size_t                      index_a,
+        const size_t                      begin_b,
+        const size_t                      end_b,
+        const VarianceArrays&             arrays,
+        const PlacementTreeDistanceIndex& index
     ) const;
 
     // -----------------------------------------------------
@@ -115,6 +229,21 @@ public:
     std::vector<Pquery*>                         pqueries;
     PlacementTree                                tree;
     std::unordered_map<std::string, std::string> metadata;
+
+protected:
+    Arena<Pquery>                                pquery_arena_;
+    Arena<PqueryPlacement>                       placement_arena_;
+    Arena<PqueryName>                            name_arena_;
+
+    /**
+     * @brief Maximal ratio of the range of edge_nums to the number of edges for which
+     * UpdateEdgeNumIndex() creates a dense index.
+     */
+    static const size_t                          kEdgeNumIndexMaxSparsity = 4;
+
+    /** @brief Index of the edge for each edge_num, shifted by #edge_num_offset_. */
+    std::vector<size_t>                          edge_num_index_;
+    int                                          edge_num_offset_;
 };
 
 } // namespace genesis
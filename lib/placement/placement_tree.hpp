@@ -13,6 +13,7 @@
 
 #include "tree/newick_processor.hpp"
 #include "tree/tree.hpp"
+#include "tree/tree_distance_index.hpp"
 #include "utils/logging.hpp"
 
 namespace genesis {
@@ -153,6 +154,11 @@ public:
 // let's avoid tedious names!
 typedef Tree<PlacementNodeData, PlacementEdgeData> PlacementTree;
 
+/**
+ * @brief Alias for a TreeDistanceIndex of a PlacementTree.
+ */
+typedef TreeDistanceIndex<PlacementNodeData, PlacementEdgeData> PlacementTreeDistanceIndex;
+
 } // namespace genesis
 
 #endif // include guard
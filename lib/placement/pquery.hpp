@@ -78,20 +78,16 @@ struct PqueryName
 //     Pquery
 // =============================================================================
 
+/**
+ * @brief A Pquery holds a set of PqueryPlacement%s and a set of PqueryName%s.
+ *
+ * The Pquery and its placements and names do not own each other. Instead, all of them are owned
+ * by the PlacementMap that created them (see PlacementMap::AddPquery(),
+ * PlacementMap::AddPlacement() and PlacementMap::AddName()), which stores them in contiguous
+ * Arena storage and destroys them all at once.
+ */
 struct Pquery
 {
-    ~Pquery()
-    {
-        for (PqueryPlacement* p : placements) {
-            delete p;
-        }
-        for (PqueryName* n : names) {
-            delete n;
-        }
-        placements.clear();
-        names.clear();
-    }
-
     std::vector<PqueryPlacement*> placements;
     std::vector<PqueryName*>      names;
 };
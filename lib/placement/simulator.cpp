@@ -7,23 +7,358 @@
 
 #include "placement/simulator.hpp"
 
-//~ #include <map>
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <functional>
+
+#ifdef PTHREADS
+#    include <thread>
+#endif
 
 #include "placement/placement_map.hpp"
 #include "utils/logging.hpp"
+#include "utils/options.hpp"
 
 namespace genesis {
 
+const size_t PlacementSimulator::kChunkSize;
+
 // =============================================================================
-//     Placement Simulator
+//     Constructor
+// =============================================================================
+
+/**
+ * @brief Constructor that sets default distributions.
+ *
+ * By default, all edges are equally likely, the placements are uniformly distributed along the
+ * branches, the pendant lengths follow an exponential distribution with mean 0.1, and each pquery
+ * gets exactly one placement.
+ */
+PlacementSimulator::PlacementSimulator () :
+    seed(0),
+    name_prefix("pquery_")
+{
+    proximal_position.type = DistributionType::kUniform;
+    proximal_position.a    = 0.0;
+    proximal_position.b    = 1.0;
+
+    pendant_length.type    = DistributionType::kExponential;
+    pendant_length.a       = 10.0;
+    pendant_length.b       = 0.0;
+
+    placement_count.type   = DistributionType::kFixed;
+    placement_count.a      = 1.0;
+    placement_count.b      = 0.0;
+}
+
+// =============================================================================
+//     Generation
 // =============================================================================
 
 /**
  * @brief Generates `n` many Pqueries and places them in the PlacementMap.
+ *
+ * The edges for the pqueries are chosen according to #edge_weights. Each pquery gets one name,
+ * which consists of the #name_prefix and a consecutive number, starting at the number of pqueries
+ * that are already in the map.
+ */
+void PlacementSimulator::Generate (PlacementMap& placements, const size_t n) const
+{
+    if (edge_weights.empty()) {
+        GenerateWithWeights(placements, n, std::vector<double>(placements.tree.EdgeCount(), 1.0));
+    } else {
+        GenerateWithWeights(placements, n, edge_weights);
+    }
+}
+
+/**
+ * @brief Generates `n` many Pqueries in a random subtree and places them in the PlacementMap.
+ *
+ * First, an edge is chosen according to #edge_weights. Then, the pqueries are generated as in
+ * Generate(), but only on this edge and the edges of the subtree below it (away from the root).
+ * This is useful to simulate samples that differ in the clades that they contain.
  */
-void PlacementSimulator::Generate (PlacementMap placements, size_t n)
+void PlacementSimulator::GenerateInSubtree (PlacementMap& placements, const size_t n) const
 {
-    LOG_DBG << placements.pqueries.size() << " " << n;
+    const PlacementTree& tree = placements.tree;
+    std::vector<double> weights = edge_weights;
+    if (weights.empty()) {
+        weights.assign(tree.EdgeCount(), 1.0);
+    }
+    if (weights.size() != tree.EdgeCount()) {
+        LOG_WARN << "Edge weights do not match the number of edges of the tree.";
+        return;
+    }
+
+    // choose the edge at the top of the subtree. we use a separate random stream for this, so
+    // that it does not interfere with the streams of the chunks.
+    const std::vector<uint32_t> words = SeedWords(
+        placements.pqueries.size(), static_cast<unsigned long long>(-1)
+    );
+    std::seed_seq seq (words.begin(), words.end());
+    std::mt19937_64 engine (seq);
+    std::discrete_distribution<size_t> edge_distrib (weights.begin(), weights.end());
+    const PlacementTree::EdgeType* top_edge = tree.EdgeAt(edge_distrib(engine));
+
+    // find all nodes and edges of the subtree. in a preorder traversal, parents are visited
+    // before their children, so we only need to check whether the parent is part of the subtree.
+    std::vector<bool> in_subtree (tree.NodeCount(), false);
+    in_subtree[top_edge->SecondaryNode()->Index()] = true;
+    for (
+        PlacementTree::ConstIteratorPreorder it = tree.BeginPreorder();
+        it != tree.EndPreorder();
+        ++it
+    ) {
+        if (it.IsFirstIteration()) {
+            continue;
+        }
+        const PlacementTree::EdgeType* edge = it.Edge();
+        if (edge != top_edge && !in_subtree[edge->PrimaryNode()->Index()]) {
+            weights[edge->Index()] = 0.0;
+            continue;
+        }
+        in_subtree[it.Node()->Index()] = true;
+    }
+
+    GenerateWithWeights(placements, n, weights);
+}
+
+/**
+ * @brief Generates `n` many Pqueries with the given weights for the edges.
+ *
+ * This function does the main work for Generate() and GenerateInSubtree(). The pqueries are
+ * generated in batches of chunks, so that the intermediate memory stays small even for millions
+ * of pqueries. The chunks of a batch are generated in parallel, and then added to the map in their
+ * order.
+ */
+void PlacementSimulator::GenerateWithWeights (
+    PlacementMap&              placements,
+    const size_t               n,
+    const std::vector<double>& weights
+) const {
+    PlacementTree& tree = placements.tree;
+    if (weights.size() != tree.EdgeCount() || tree.EdgeCount() == 0) {
+        LOG_WARN << "Edge weights do not match the number of edges of the tree.";
+        return;
+    }
+
+    // prepare the cumulative edge weights, for sampling edges via binary search.
+    TreeData data;
+    double sum = 0.0;
+    for (double w : weights) {
+        if (w < 0.0) {
+            LOG_WARN << "Edge weights must not be negative.";
+            return;
+        }
+        sum += w;
+        data.cumulative_weights.push_back(sum);
+    }
+    if (sum <= 0.0) {
+        LOG_WARN << "Edge weights need to contain a positive value.";
+        return;
+    }
+
+    // prepare the adjacent edges of all edges, which are used for additional placements.
+    data.adjacent_edges.resize(tree.EdgeCount());
+    for (size_t i = 0; i < tree.EdgeCount(); ++i) {
+        const PlacementTree::EdgeType* edge = tree.EdgeAt(i);
+        for (const PlacementTree::NodeType* node : { edge->PrimaryNode(), edge->SecondaryNode() }) {
+            for (
+                PlacementTree::NodeType::ConstIteratorLinks it = node->BeginLinks();
+                it != node->EndLinks();
+                ++it
+            ) {
+                if (it.Edge() != edge) {
+                    data.adjacent_edges[i].push_back(it.Edge()->Index());
+                }
+            }
+        }
+    }
+
+    // process the chunks in batches. each thread of a batch gets a few chunks on average.
+#ifdef PTHREADS
+    const size_t num_threads = std::max(Options::number_of_threads, 1u);
+#else
+    const size_t num_threads = 1;
+#endif
+    const size_t chunk_count = (n + kChunkSize - 1) / kChunkSize;
+    const size_t batch_size  = 4 * num_threads;
+    const size_t pqry_offset = placements.pqueries.size();
+    placements.pqueries.reserve(placements.pqueries.size() + n);
+
+    for (size_t begin_chunk = 0; begin_chunk < chunk_count; begin_chunk += batch_size) {
+        std::vector<Chunk> chunks (std::min(batch_size, chunk_count - begin_chunk));
+        std::atomic<size_t> next_chunk (0);
+
+#ifdef PTHREADS
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < std::min(num_threads, chunks.size()); ++i) {
+            threads.emplace_back(
+                &PlacementSimulator::GenerateThread, this,
+                &next_chunk, pqry_offset, begin_chunk, n, &data, &chunks
+            );
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+
+#else
+
+        // do all the work in one "thread".
+        GenerateThread(&next_chunk, pqry_offset, begin_chunk, n, &data, &chunks);
+
+#endif
+
+        // add the generated pqueries of the batch to the map.
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            const Chunk& chunk = chunks[c];
+            size_t pqry_index  = (begin_chunk + c) * kChunkSize;
+            size_t place_index = 0;
+
+            for (size_t count : chunk.placement_counts) {
+                Pquery* pqry = placements.AddPquery();
+                for (size_t i = 0; i < count; ++i, ++place_index) {
+                    const PlacementRecord& record = chunk.placements[place_index];
+                    PlacementTree::EdgeType* edge = tree.EdgeAt(record.edge_index);
+
+                    PqueryPlacement* place   = placements.AddPlacement(pqry);
+                    place->edge              = edge;
+                    place->edge_num          = edge->edge_num;
+                    place->proximal_length   = record.proximal_position * edge->branch_length;
+                    place->pendant_length    = record.pendant_length;
+                    place->like_weight_ratio = record.like_weight_ratio;
+                    edge->placements.push_back(place);
+                }
+
+                PqueryName* name = placements.AddName(pqry);
+                name->name = name_prefix + std::to_string(pqry_offset + pqry_index);
+                ++pqry_index;
+            }
+            assert(place_index == chunk.placements.size());
+        }
+    }
+}
+
+/**
+ * @brief Returns the words for seeding the random engine of one stream of random numbers, which
+ * are derived from #seed, the number of pqueries that were in the map before generating, and the
+ * index of the stream.
+ *
+ * The `offset` makes repeated calls on the same map yield new pqueries instead of repeating the
+ * ones of the previous call. As `std::seed_seq` only uses the lower 32 bits of each value, all
+ * values are split into two words. Otherwise, values that only differ in their upper bits would
+ * yield the same random numbers.
+ */
+std::vector<uint32_t> PlacementSimulator::SeedWords (
+    const unsigned long long offset,
+    const unsigned long long stream
+) const {
+    const unsigned long long s = seed;
+    return std::vector<uint32_t> {
+        static_cast<uint32_t>(s),      static_cast<uint32_t>(s >> 32),
+        static_cast<uint32_t>(offset), static_cast<uint32_t>(offset >> 32),
+        static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32)
+    };
+}
+
+/**
+ * @brief Thread function that generates the chunks of one batch for GenerateWithWeights().
+ *
+ * Each call takes the next chunk of the batch from the shared counter until all chunks are done.
+ * The random engine of a chunk is seeded with #seed, the number of pqueries that were in the map
+ * before generating (`pqry_offset`) and the global index of the chunk, see SeedWords().
+ */
+void PlacementSimulator::GenerateThread (
+    std::atomic<size_t>* next_chunk,
+    const size_t         pqry_offset,
+    const size_t         begin_chunk,
+    const size_t         n,
+    const TreeData*      data,
+    std::vector<Chunk>*  chunks
+) const {
+    const std::vector<double>& cumulative = data->cumulative_weights;
+    std::vector<size_t> candidates;
+    std::vector<double> ratios;
+
+    size_t c;
+    while ((c = next_chunk->fetch_add(1)) < chunks->size()) {
+        const size_t global_chunk = begin_chunk + c;
+        const size_t chunk_size   = std::min(kChunkSize, n - global_chunk * kChunkSize);
+
+        const std::vector<uint32_t> words = SeedWords(pqry_offset, global_chunk);
+        std::seed_seq seq (words.begin(), words.end());
+        std::mt19937_64 engine (seq);
+        std::uniform_real_distribution<double> unit (0.0, 1.0);
+
+        Chunk& chunk = (*chunks)[c];
+        chunk.placement_counts.reserve(chunk_size);
+        chunk.placements.reserve(chunk_size);
+
+        for (size_t p = 0; p < chunk_size; ++p) {
+            // draw the edge of the first placement.
+            double r = unit(engine) * cumulative.back();
+            size_t edge_index = std::upper_bound(cumulative.begin(), cumulative.end(), r)
+                              - cumulative.begin();
+            edge_index = std::min(edge_index, cumulative.size() - 1);
+
+            // get the number of placements and their edges. additional placements are put on
+            // distinct adjacent edges, so there cannot be more of them than there are neighbours.
+            const std::vector<size_t>& adjacent = data->adjacent_edges[edge_index];
+            double count_value = std::round(Sample(placement_count, engine));
+            size_t count = static_cast<size_t>(std::max(count_value, 1.0));
+            count = std::min(count, adjacent.size() + 1);
+
+            candidates = adjacent;
+            std::shuffle(candidates.begin(), candidates.end(), engine);
+            candidates.resize(count - 1);
+            candidates.insert(candidates.begin(), edge_index);
+
+            // draw the weight ratios, sort them so that the first placement is the most likely
+            // one, and normalize them.
+            ratios.clear();
+            double ratio_sum = 0.0;
+            for (size_t i = 0; i < count; ++i) {
+                ratios.push_back(-std::log(1.0 - unit(engine)));
+                ratio_sum += ratios.back();
+            }
+            std::sort(ratios.begin(), ratios.end(), std::greater<double>());
+
+            for (size_t i = 0; i < count; ++i) {
+                PlacementRecord record;
+                record.edge_index        = candidates[i];
+                record.proximal_position = std::min(std::max(
+                    Sample(proximal_position, engine), 0.0
+                ), 1.0);
+                record.pendant_length    = std::max(Sample(pendant_length, engine), 0.0);
+                record.like_weight_ratio = (ratio_sum > 0.0 ? ratios[i] / ratio_sum : 1.0 / count);
+                chunk.placements.push_back(record);
+            }
+            chunk.placement_counts.push_back(count);
+        }
+    }
+}
+
+/**
+ * @brief Draws a value from a Distribution.
+ */
+double PlacementSimulator::Sample (const Distribution& distribution, std::mt19937_64& engine)
+{
+    switch (distribution.type) {
+        case DistributionType::kFixed:
+            return distribution.a;
+
+        case DistributionType::kUniform:
+            return std::uniform_real_distribution<double>(distribution.a, distribution.b)(engine);
+
+        case DistributionType::kNormal:
+            return std::normal_distribution<double>(distribution.a, distribution.b)(engine);
+
+        case DistributionType::kExponential:
+            return std::exponential_distribution<double>(distribution.a)(engine) + distribution.b;
+    }
+    return 0.0;
 }
 
 } // namespace genesis
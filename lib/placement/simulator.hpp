@@ -8,7 +8,12 @@
  * @ingroup placement
  */
 
+#include <atomic>
+#include <random>
 #include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
 
 namespace genesis {
 
@@ -22,17 +27,128 @@ class PlacementMap;
 //     Placement Simulator
 // =============================================================================
 
-
 /**
  * @brief Simulates Placements on a Tree.
+ *
+ * The simulator adds randomly generated pqueries to the reference tree of a PlacementMap. The
+ * distributions used for this are set via the public members of this class:
+ *
+ *   * #edge_weights: Relative probability of each edge (by its index in the tree) to get the first
+ *     placement of a pquery. If empty, all edges are equally likely.
+ *   * #proximal_position: Position of a placement on its edge, relative to the branch length.
+ *     Values are clamped to [0, 1].
+ *   * #pendant_length: Pendant length of the placements. Values are clamped to be non-negative.
+ *   * #placement_count: Number of placements per pquery. Values are rounded and clamped to be at
+ *     least 1. Additional placements are put on edges adjacent to the edge of the first one, as
+ *     far as possible, and the `like_weight_ratio`s of all placements of a pquery sum up to 1.0.
+ *
+ * The pqueries are generated in chunks of kChunkSize, using Options::number_of_threads threads
+ * if compiled with `PTHREADS`. Each chunk has its own random engine, which is seeded from #seed,
+ * the number of pqueries that are already in the map, and the chunk index. Thus, the result only
+ * depends on the settings, the #seed and the map, but not on the number of threads. Repeated calls
+ * on the same map yield new pqueries, while calls on equal maps yield equal pqueries.
  */
 class PlacementSimulator
 {
 public:
+    // -----------------------------------------------------
+    //     Distributions
+    // -----------------------------------------------------
+
+    /** @brief Types of Distribution%s that can be used for the simulation. */
+    enum class DistributionType {
+        /** @brief Always returns the value `a`. */
+        kFixed,
+
+        /** @brief Uniform distribution in the range [`a`, `b`). */
+        kUniform,
+
+        /** @brief Normal distribution with mean `a` and standard deviation `b`. */
+        kNormal,
+
+        /** @brief Exponential distribution with rate `a`, shifted by `b`. */
+        kExponential
+    };
+
+    /** @brief POD struct that describes a distribution of values and its parameters. */
+    typedef struct {
+        DistributionType type;
+        double           a;
+        double           b;
+    } Distribution;
+
+    // -----------------------------------------------------
+    //     Constructor & Generation
+    // -----------------------------------------------------
+
+    PlacementSimulator ();
+
+    void Generate          (PlacementMap& placements, const size_t n) const;
+    void GenerateInSubtree (PlacementMap& placements, const size_t n) const;
+
+    // -----------------------------------------------------
+    //     Settings
+    // -----------------------------------------------------
+
+    std::vector<double> edge_weights;
+
+    Distribution        proximal_position;
+    Distribution        pendant_length;
+    Distribution        placement_count;
+
+    unsigned long       seed;
+    std::string         name_prefix;
+
+    // -----------------------------------------------------
+    //     Internal Members
+    // -----------------------------------------------------
+
+protected:
+
+    /** @brief Number of pqueries that are generated with one random engine. */
+    static const size_t kChunkSize = 4096;
+
+    /** @brief POD struct that stores one generated placement before it is added to the map. */
+    typedef struct {
+        size_t edge_index;
+        double proximal_position;
+        double pendant_length;
+        double like_weight_ratio;
+    } PlacementRecord;
+
+    /** @brief Generated data of one chunk of pqueries. */
+    typedef struct {
+        std::vector<size_t>          placement_counts;
+        std::vector<PlacementRecord> placements;
+    } Chunk;
+
+    /** @brief Precomputed data of the tree that is shared by all threads. */
+    typedef struct {
+        std::vector<double>              cumulative_weights;
+        std::vector<std::vector<size_t>> adjacent_edges;
+    } TreeData;
+
+    void GenerateWithWeights (
+        PlacementMap&              placements,
+        const size_t               n,
+        const std::vector<double>& weights
+    ) const;
+
+    void GenerateThread (
+        std::atomic<size_t>* next_chunk,
+        const size_t         pqry_offset,
+        const size_t         begin_chunk,
+        const size_t         n,
+        const TreeData*      data,
+        std::vector<Chunk>*  chunks
+    ) const;
 
-    static void Generate          (PlacementMap placements, size_t n);
-    static void GenerateInSubtree (PlacementMap placements, size_t n);
+    std::vector<uint32_t> SeedWords (
+        const unsigned long long offset,
+        const unsigned long long stream
+    ) const;
 
+    static double Sample (const Distribution& distribution, std::mt19937_64& engine);
 };
 
 } // namespace genesis
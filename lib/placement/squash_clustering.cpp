@@ -0,0 +1,255 @@
+/**
+ * @brief Implementation of Squash Clustering class.
+ *
+ * @file
+ * @ingroup placement
+ */
+
+#include "placement/squash_clustering.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+
+#ifdef PTHREADS
+#    include <thread>
+#endif
+
+#include "placement/placement_map.hpp"
+#include "tree/newick_broker.hpp"
+#include "tree/newick_processor.hpp"
+#include "utils/logging.hpp"
+#include "utils/options.hpp"
+
+namespace genesis {
+
+// =============================================================================
+//     Constructor & Clustering
+// =============================================================================
+
+/**
+ * @brief Constructor that sets the default settings: exact masses, and no pendant lengths.
+ */
+SquashClustering::SquashClustering () :
+    bins_per_edge(0),
+    with_pendant_length(false),
+    sample_count_(0)
+{}
+
+/**
+ * @brief Clusters the given samples.
+ *
+ * Any previous result is cleared. If the reference trees of the samples are not compatible, a
+ * warning is issued and false is returned.
+ */
+bool SquashClustering::Run (const std::vector<const PlacementMap*>& maps)
+{
+    clear();
+    if (maps.empty()) {
+        return true;
+    }
+
+    // create the initial clusters. as each step creates one new cluster, we know their number
+    // in advance, so that references to them stay valid.
+    const size_t cluster_count = 2 * maps.size() - 1;
+    clusters_.reserve(cluster_count);
+    clusters_.resize(maps.size());
+    for (size_t i = 0; i < maps.size(); ++i) {
+        Cluster& cluster = clusters_[i];
+        cluster.profile.Init(*maps[i]);
+        if (!cluster.profile.Compatible(clusters_[0].profile)) {
+            LOG_WARN << "Clustering samples on different reference trees not possible.";
+            clear();
+            return false;
+        }
+        cluster.profile.Discretize(bins_per_edge);
+        cluster.weight = maps[i]->PlacementMass();
+        cluster.active = true;
+    }
+    sample_count_ = maps.size();
+
+    // calculate the distances between all samples.
+    distances_ = SymmetricMatrix<double>(cluster_count, 0.0);
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t i = 0; i < maps.size(); ++i) {
+        for (size_t j = i + 1; j < maps.size(); ++j) {
+            pairs.emplace_back(i, j);
+        }
+    }
+    Distances(pairs);
+
+    while (clusters_.size() < cluster_count) {
+        // find the closest pair of active clusters.
+        double min_d = std::numeric_limits<double>::max();
+        size_t min_a = 0;
+        size_t min_b = 0;
+        for (size_t i = 0; i < clusters_.size(); ++i) {
+            if (!clusters_[i].active) {
+                continue;
+            }
+            for (size_t j = i + 1; j < clusters_.size(); ++j) {
+                if (clusters_[j].active && distances_(i, j) < min_d) {
+                    min_d = distances_(i, j);
+                    min_a = i;
+                    min_b = j;
+                }
+            }
+        }
+        assert(min_a < min_b);
+
+        // merge them into a new cluster, weighted by their masses.
+        Cluster& cluster_a = clusters_[min_a];
+        Cluster& cluster_b = clusters_[min_b];
+        Cluster  merged;
+        merged.weight = cluster_a.weight + cluster_b.weight;
+        merged.active = true;
+        merged.profile = EMDProfile::Average(
+            cluster_a.profile, cluster_b.profile,
+            merged.weight > 0.0 ? cluster_a.weight / merged.weight : 0.5
+        );
+        clusters_.push_back(std::move(merged));
+        cluster_a.active = false;
+        cluster_b.active = false;
+
+        // calculate the distances of the new cluster to its children and to all active clusters.
+        const size_t index = clusters_.size() - 1;
+        pairs.clear();
+        for (size_t i = 0; i < index; ++i) {
+            if (clusters_[i].active || i == min_a || i == min_b) {
+                pairs.emplace_back(i, index);
+            }
+        }
+        Distances(pairs);
+
+        Merger merger;
+        merger.index_a    = min_a;
+        merger.distance_a = distances_(min_a, index);
+        merger.index_b    = min_b;
+        merger.distance_b = distances_(min_b, index);
+        mergers_.push_back(merger);
+
+        // the profiles of the children are not needed any more.
+        cluster_a.profile = EMDProfile();
+        cluster_b.profile = EMDProfile();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Clears the result of the clustering. The settings are kept.
+ */
+void SquashClustering::clear()
+{
+    std::vector<Cluster>().swap(clusters_);
+    mergers_.clear();
+    distances_    = SymmetricMatrix<double>();
+    sample_count_ = 0;
+}
+
+/**
+ * @brief Builds the cluster tree of the last Run().
+ *
+ * The leaves are named by the given labels, which need to be in the order of the samples. If
+ * there are not enough labels, the leaves are named by the index of their sample instead. The inner
+ * nodes are unnamed, and the branch lengths are the EMDs between each cluster and its parent.
+ */
+void SquashClustering::ToTree (DefaultTree& tree, const std::vector<std::string>& labels) const
+{
+    tree.clear();
+    if (sample_count_ == 0) {
+        return;
+    }
+
+    // get the branch length above each cluster.
+    std::vector<double> branch_lengths (2 * sample_count_ - 1, 0.0);
+    for (const Merger& merger : mergers_) {
+        branch_lengths[merger.index_a] = merger.distance_a;
+        branch_lengths[merger.index_b] = merger.distance_b;
+    }
+
+    // fill the broker in preorder, visiting the children of each cluster in reverse order.
+    // this is the reverse of the postorder sequence that NewickBroker expects from its bottom.
+    NewickBroker broker;
+    std::vector<std::pair<size_t, int>> stack;
+    stack.emplace_back(branch_lengths.size() - 1, 0);
+    while (!stack.empty()) {
+        size_t index = stack.back().first;
+        int    depth = stack.back().second;
+        stack.pop_back();
+
+        NewickBrokerElement* bn = new NewickBrokerElement();
+        bn->branch_length = branch_lengths[index];
+        bn->depth         = depth;
+        if (index < sample_count_) {
+            bn->name    = index < labels.size() ? labels[index] : std::to_string(index);
+            bn->is_leaf = true;
+        } else {
+            const Merger& merger = mergers_[index - sample_count_];
+            stack.emplace_back(merger.index_a, depth + 1);
+            stack.emplace_back(merger.index_b, depth + 1);
+        }
+        broker.PushBottom(bn);
+    }
+
+    NewickProcessor::FromBroker(broker, tree);
+}
+
+// =============================================================================
+//     Distances
+// =============================================================================
+
+/**
+ * @brief Calculates the distances between the given pairs of clusters and stores them in the
+ * distance matrix.
+ */
+void SquashClustering::Distances (const std::vector<std::pair<size_t, size_t>>& pairs)
+{
+#ifdef PTHREADS
+
+    // start all threads. each of them calculates an interleaved subset of the pairs.
+    int num_threads = std::min(
+        static_cast<size_t>(std::max(Options::number_of_threads, 1u)), pairs.size()
+    );
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back(
+            &SquashClustering::DistancesThread, this, i, num_threads, &pairs
+        );
+    }
+
+    // wait for all threads to finish.
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+#else
+
+    // do all the work in one "thread".
+    DistancesThread(0, 1, &pairs);
+
+#endif
+}
+
+/**
+ * @brief Thread function that calculates an interleaved subset of the pairs for Distances().
+ */
+void SquashClustering::DistancesThread (
+    const int                                      offset,
+    const int                                      incr,
+    const std::vector<std::pair<size_t, size_t>>*  pairs
+) {
+    // intermediate storage for the EMD calculation, which is reused for all pairs.
+    std::vector<double> buffer;
+
+    // each thread writes to its own disjoint set of matrix elements, so no locking is needed.
+    for (size_t p = offset; p < pairs->size(); p += incr) {
+        const size_t i = (*pairs)[p].first;
+        const size_t j = (*pairs)[p].second;
+        distances_(i, j) = EMDProfile::EMD(
+            clusters_[i].profile, clusters_[j].profile, with_pendant_length, buffer
+        );
+    }
+}
+
+} // namespace genesis
@@ -0,0 +1,139 @@
+#ifndef GENESIS_PLACEMENT_SQUASH_CLUSTERING_H_
+#define GENESIS_PLACEMENT_SQUASH_CLUSTERING_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup placement
+ */
+
+#include <stddef.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "placement/emd_profile.hpp"
+#include "tree/tree.hpp"
+#include "utils/matrix.hpp"
+
+namespace genesis {
+
+// =============================================================================
+//     Forward Declarations
+// =============================================================================
+
+class PlacementMap;
+
+// =============================================================================
+//     Squash Clustering
+// =============================================================================
+
+/**
+ * @brief Hierarchical clustering of samples of placements on a common reference tree.
+ *
+ * Squash clustering (Matsen and Evans, 2013) starts with one cluster per sample. In each step, the
+ * two clusters with the smallest Earth Movers Distance (EMD) are merged into a new cluster, whose
+ * placement masses are the average of both, weighted by the total placement mass of the samples
+ * that they contain. This is repeated until only one cluster is left. The resulting cluster tree
+ * has the samples as leaves, and the branch lengths are the EMDs between each cluster and its
+ * parent.
+ *
+ * Each cluster is represented by an EMDProfile, so that merging two clusters is a linear merge of
+ * their sorted mass entries, and the EMDs of the new cluster to all others can be calculated
+ * without traversing the tree. The distances are calculated using Options::number_of_threads
+ * threads if compiled with `PTHREADS`. The clustering is controlled via the public members:
+ *
+ *   * #bins_per_edge: If not zero, the masses of each edge are collected into this many bins of
+ *     equal size (see EMDProfile::Discretize()). This bounds the size of the merged clusters,
+ *     which otherwise contain all placements of their samples, at the cost of a small error in
+ *     the distances.
+ *   * #with_pendant_length: Whether to include the pendant lengths of the placements in the EMD.
+ *     By default, this is `false`, so that the distance of identical clusters is zero.
+ *
+ * Use Run() to do the clustering, and ToTree() to get the cluster tree, which can then be written
+ * using NewickProcessor or PhyloXmlProcessor.
+ */
+class SquashClustering
+{
+public:
+    // -----------------------------------------------------
+    //     Types
+    // -----------------------------------------------------
+
+    /**
+     * @brief POD struct that describes one merging step. The new cluster gets the next free
+     * index, i.e., the number of samples plus the index of the step.
+     */
+    typedef struct {
+        size_t index_a;
+        double distance_a;
+        size_t index_b;
+        double distance_b;
+    } Merger;
+
+    // -----------------------------------------------------
+    //     Constructor & Clustering
+    // -----------------------------------------------------
+
+    SquashClustering ();
+
+    bool Run (const std::vector<const PlacementMap*>& maps);
+    void clear();
+
+    void ToTree (DefaultTree& tree, const std::vector<std::string>& labels = {}) const;
+
+    // -----------------------------------------------------
+    //     Accessors
+    // -----------------------------------------------------
+
+    /** @brief Returns the merging steps of the last Run(), in the order in which they happened. */
+    inline const std::vector<Merger>& Mergers() const
+    {
+        return mergers_;
+    }
+
+    /** @brief Returns the number of samples that were clustered in the last Run(). */
+    inline size_t SampleCount() const
+    {
+        return sample_count_;
+    }
+
+    // -----------------------------------------------------
+    //     Settings
+    // -----------------------------------------------------
+
+    size_t bins_per_edge;
+    bool   with_pendant_length;
+
+    // -----------------------------------------------------
+    //     Internal Members
+    // -----------------------------------------------------
+
+protected:
+
+    /** @brief One cluster, which is active as long as it has not been merged yet. */
+    struct Cluster
+    {
+        EMDProfile profile;
+        double     weight;
+        bool       active;
+    };
+
+    void Distances (const std::vector<std::pair<size_t, size_t>>& pairs);
+
+    void DistancesThread (
+        const int                                      offset,
+        const int                                      incr,
+        const std::vector<std::pair<size_t, size_t>>*  pairs
+    );
+
+    std::vector<Cluster>    clusters_;
+    std::vector<Merger>     mergers_;
+    SymmetricMatrix<double> distances_;
+    size_t                  sample_count_;
+};
+
+} // namespace genesis
+
+#endif // include guard
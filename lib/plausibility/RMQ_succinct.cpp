@@ -1,5 +1,8 @@
 #include "RMQ_succinct.hpp"
 
+#include <iostream>
+using namespace std;
+
 const DTidx RMQ_succinct::Catalan[17][17] = {
 	{1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1},
 	{0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16},
@@ -1,13 +1,9 @@
 #ifndef _RMQ_succinct_hpp_
 #define _RMQ_succinct_hpp_
 
-#define MEM_COUNT
-
 #include "RMQ.hpp"
 #include <stdlib.h>
 #include <limits.h>
-#include <iostream>
-using namespace std;
 
 typedef unsigned char DTsucc;
 typedef unsigned short DTsucc2;
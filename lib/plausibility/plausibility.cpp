@@ -80,7 +80,7 @@ void Plausibility::SpiderpigFunction (
 
     // TODO this should be done for each small tree!
 
-    std::vector<pair<int,bool>> preorder_ids;
+    std::vector<std::pair<int,bool>> preorder_ids;
     preorder_ids.reserve(2 * small_tree.NodeCount());
 
     for (
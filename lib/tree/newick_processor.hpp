@@ -11,6 +11,8 @@
 #include <assert.h>
 #include <string>
 
+#include "utils/input_source.hpp"
+#include "utils/input_stream.hpp"
 #include "utils/lexer.hpp"
 
 namespace genesis {
@@ -138,16 +140,22 @@ public:
     // ---------------------------------------------------------------------
 
     template <class NodeDataType, class EdgeDataType>
-    static bool FromFile   (const std::string fn,     Tree<NodeDataType, EdgeDataType>& tree);
+    static bool FromFile   (const std::string fn,      Tree<NodeDataType, EdgeDataType>& tree);
 
     template <class NodeDataType, class EdgeDataType>
-    static bool FromString (const std::string ts,     Tree<NodeDataType, EdgeDataType>& tree);
+    static bool FromString (const std::string ts,      Tree<NodeDataType, EdgeDataType>& tree);
 
     template <class NodeDataType, class EdgeDataType>
-    static bool FromLexer  (const NewickLexer& lexer, Tree<NodeDataType, EdgeDataType>& tree);
+    static bool FromSource (const InputSource& source, Tree<NodeDataType, EdgeDataType>& tree);
 
     template <class NodeDataType, class EdgeDataType>
-    static void FromBroker (NewickBroker& broker,     Tree<NodeDataType, EdgeDataType>& tree);
+    static bool FromStream (InputStream&       stream, Tree<NodeDataType, EdgeDataType>& tree);
+
+    template <class NodeDataType, class EdgeDataType>
+    static bool FromLexer  (const NewickLexer& lexer,  Tree<NodeDataType, EdgeDataType>& tree);
+
+    template <class NodeDataType, class EdgeDataType>
+    static void FromBroker (NewickBroker& broker,      Tree<NodeDataType, EdgeDataType>& tree);
 
     // ---------------------------------------------------------------------
     //     Printing
@@ -161,7 +169,7 @@ public:
     static int  precision;
 
     template <class NodeDataType, class EdgeDataType>
-    static bool ToFile   (const std::string fn, const Tree<NodeDataType, EdgeDataType>& tree);
+    static bool ToFile   (const std::string fn,  const Tree<NodeDataType, EdgeDataType>& tree);
 
     template <class NodeDataType, class EdgeDataType>
     static void ToString (std::string& ts,      const Tree<NodeDataType, EdgeDataType>& tree);
@@ -170,7 +178,7 @@ public:
     static std::string ToString (               const Tree<NodeDataType, EdgeDataType>& tree);
 
     template <class NodeDataType, class EdgeDataType>
-    static void ToBroker (NewickBroker& broker, const Tree<NodeDataType, EdgeDataType>& tree);
+    static void ToBroker (NewickBroker& broker,  const Tree<NodeDataType, EdgeDataType>& tree);
 
 protected:
     static std::string ToStringRec(const NewickBroker& broker, size_t position);
@@ -8,8 +8,10 @@
  * @ingroup tree
  */
 
-#include <deque>
+#include <algorithm>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "tree/newick_broker.hpp"
 #include "tree/tree.hpp"
@@ -24,6 +26,9 @@ namespace genesis {
 
 /**
  * @brief Create a Tree from a file containing a Newick tree.
+ *
+ * The file is mapped into memory if possible, see InputSource. Compressed files and pipes are
+ * read as a stream instead, see InputStream.
  */
 template <class NDT, class EDT>
 bool NewickProcessor::FromFile (const std::string fn, Tree<NDT, EDT>& tree)
@@ -32,7 +37,20 @@ bool NewickProcessor::FromFile (const std::string fn, Tree<NDT, EDT>& tree)
         LOG_WARN << "Newick file '" << fn << "' does not exist.";
         return false;
     }
-    return FromString(FileRead(fn), tree);
+
+    if (InputStream::IsStreamFile(fn)) {
+        InputStream stream;
+        if (!stream.OpenFile(fn)) {
+            return false;
+        }
+        return FromStream(stream, tree);
+    }
+
+    InputSource source;
+    if (!source.OpenFile(fn)) {
+        return false;
+    }
+    return FromSource(source, tree);
 }
 
 /**
@@ -46,12 +64,49 @@ bool NewickProcessor::FromString (const std::string ts, Tree<NDT, EDT>& tree)
     return FromLexer(lexer, tree);
 }
 
-// TODO do a validate brackets first?!
-// TODO what happens if a tree's nested brackets fully close to depth 0, then open again without
-// TODO semicolon like (...)(...); ? do we need to check for this?
+/**
+ * @brief Create a Tree from an InputSource containing a Newick tree.
+ */
+template <class NDT, class EDT>
+bool NewickProcessor::FromSource (const InputSource& source, Tree<NDT, EDT>& tree)
+{
+    NewickLexer lexer;
+    lexer.ProcessSource(source);
+    return FromLexer(lexer, tree);
+}
+
+/**
+ * @brief Create a Tree from an InputStream containing a Newick tree.
+ *
+ * The stream is read in chunks, see Lexer::ProcessStream(). As all tokens of the tree are needed
+ * at once, the text of the tree is held in memory nonetheless.
+ */
+template <class NDT, class EDT>
+bool NewickProcessor::FromStream (InputStream& stream, Tree<NDT, EDT>& tree)
+{
+    NewickLexer lexer;
+    lexer.ProcessStream(stream);
+    return FromLexer(lexer, tree);
+}
+
+/**
+ * @brief Create a Tree from the tokens of a NewickLexer.
+ *
+ * The links, nodes and edges of the tree are created directly while iterating the tokens, without
+ * building a NewickBroker first. The data of the node that is currently being parsed is collected
+ * in a single NewickBrokerElement, which is reused for all nodes and handed to the
+ * `FromNewickBrokerElement()` functions of the node and edge data types once the node is complete.
+ * Comments are attached to the node that is completed next. The resulting tree is the same as the
+ * one that FromBroker() creates, including the order of its elements. Input whose brackets close
+ * to depth 0 before the end of the tree, like `(a,b)(c);` or `(a,b),(c);`, is rejected.
+ */
 template <class NDT, class EDT>
 bool NewickProcessor::FromLexer (const NewickLexer& lexer, Tree<NDT, EDT>& tree)
 {
+    typedef typename Tree<NDT, EDT>::LinkType LinkType;
+    typedef typename Tree<NDT, EDT>::NodeType NodeType;
+    typedef typename Tree<NDT, EDT>::EdgeType EdgeType;
+
     if (lexer.empty()) {
         LOG_INFO << "Tree is empty. Nothing done.";
         return false;
@@ -62,14 +117,90 @@ bool NewickProcessor::FromLexer (const NewickLexer& lexer, Tree<NDT, EDT>& tree)
         return false;
     }
 
-    // we will fill this broker with tree elements
-    NewickBroker broker;
+    // all elements of the tree in the order of their creation. they are handed over to the tree
+    // at the end, or deleted if an error occurs.
+    typename Tree<NDT, EDT>::LinkArray links;
+    typename Tree<NDT, EDT>::NodeArray nodes;
+    typename Tree<NDT, EDT>::EdgeArray edges;
+
+    // the nodes in the order in which they are completed, which is postorder.
+    typename Tree<NDT, EDT>::NodeArray postorder;
+
+    // the inner nodes whose subtrees are currently being parsed, from the root down to the current
+    // position, each together with the last of its links that was created so far.
+    std::vector<std::pair<NodeType*, LinkType*>> open_nodes;
+
+    // the node that is currently being populated with data, and its data.
+    NodeType*           node = nullptr;
+    NewickBrokerElement element;
+
+    // creates a new node as the next child of the innermost open node, or the root if there is
+    // none, together with the links and the edge that connect them.
+    auto create_node = [&] () {
+        NodeType* new_node = new NodeType();
+        nodes.push_back(new_node);
+
+        // the root does not get a link towards its parent. its first link is the one towards its
+        // first child, which is set when creating the child.
+        if (open_nodes.empty()) {
+            return new_node;
+        }
+
+        NodeType* parent    = open_nodes.back().first;
+        LinkType* down_link = new LinkType();
+        down_link->node_    = parent;
+        links.push_back(down_link);
+        if (open_nodes.back().second) {
+            open_nodes.back().second->next_ = down_link;
+        } else {
+            parent->link_ = down_link;
+        }
+        open_nodes.back().second = down_link;
+
+        // leaves keep their up link as the only link of their circle. for inner nodes, the links
+        // to their children are inserted into the circle later.
+        LinkType* up_link = new LinkType();
+        up_link->next_    = up_link;
+        up_link->node_    = new_node;
+        new_node->link_   = up_link;
+        links.push_back(up_link);
 
-    // the node that is currently being populated with data
-    NewickBrokerElement* node = nullptr;
+        EdgeType* edge    = new EdgeType();
+        edge->link_p_     = down_link;
+        edge->link_s_     = up_link;
+        edges.push_back(edge);
+
+        up_link->outer_   = down_link;
+        up_link->edge_    = edge;
+        down_link->outer_ = up_link;
+        down_link->edge_  = edge;
+        return new_node;
+    };
+
+    // hands the collected data to the current node and its edge, and resets it for the next node.
+    auto complete_node = [&] (const bool is_root) {
+        if (element.name.empty() && use_default_names) {
+            if (is_root) {
+                element.name = default_root_name;
+            } else if (element.is_leaf) {
+                element.name = default_leaf_name;
+            } else {
+                element.name = default_internal_name;
+            }
+        }
 
-    // how deep is the current token nested in the tree?
-    int depth = 0;
+        node->FromNewickBrokerElement(&element);
+        if (node != nodes.front()) {
+            node->link_->edge_->FromNewickBrokerElement(&element);
+        }
+        postorder.push_back(node);
+        node = nullptr;
+
+        element.name.clear();
+        element.branch_length = 0.0;
+        element.tags.clear();
+        element.comments.clear();
+    };
 
     // acts as pointer to previous token
     Lexer::const_iterator pt = lexer.cend();
@@ -92,15 +223,30 @@ bool NewickProcessor::FromLexer (const NewickLexer& lexer, Tree<NDT, EDT>& tree)
         // ------------------------------------------------------
         //     is bracket '('  ==>  begin of subtree
         // ------------------------------------------------------
-        if (ct->IsBracket("(")) {
-            if (pt != lexer.cend() && !(
-                pt->IsBracket("(")  || pt->IsOperator(",") || pt->IsComment()
-            )) {
+        if (ct->IsBracket('(')) {
+            if (node || (pt != lexer.cend() && !(
+                pt->IsBracket('(')  || pt->IsOperator(',') || pt->IsComment()
+            ))) {
                 error = "Invalid characters at " + ct->at() + ": '" + ct->value() + "'.";
                 break;
             }
 
-            ++depth;
+            // the new inner node is complete once its closing bracket and data are read.
+            NodeType* inner = create_node();
+            open_nodes.emplace_back(inner, open_nodes.empty() ? nullptr : inner->link_);
+            continue;
+        }
+
+        // ------------------------------------------------------
+        //     is comment []  ==>  comment
+        // ------------------------------------------------------
+        if (ct->IsComment()) {
+            // in some newick extensions, a comment has a semantic meaning that belongs to the
+            // current node/edge, thus we need to store it. comments before the first bracket are
+            // ignored.
+            if (node || !open_nodes.empty()) {
+                element.comments.emplace_back(ct->data(), ct->size());
+            }
             continue;
         }
 
@@ -108,41 +254,26 @@ bool NewickProcessor::FromLexer (const NewickLexer& lexer, Tree<NDT, EDT>& tree)
         //     Prepare for all other tokens.
         // ------------------------------------------------------
 
-        // if we reach this, the previous condition is not fullfilled (otherwise, continue would
-        // have been called). so we have a token other than '(', which means we should already
-        // be somewhere in the tree (or a comment). check, if that is true.
-        if (ct == lexer.cbegin()) {
-            if (ct->IsComment()) {
-                continue;
-            }
+        // if we reach this, we have a token other than '(' or a comment, which means we should
+        // already be somewhere in the tree. check, if that is true.
+        if (!node && open_nodes.empty()) {
             error = "Tree does not start with '(' at " + ct->at() + ".";
             break;
         }
 
-        // if we reached this point in code, this means that ct != begin, so it is not the first
-        // iteration in this loop. this means that pt was already set in the loop header (at least
-        // once), which means it now points to a valid token.
+        // if we reached this point in code, there was a bracket before, so pt points to a valid
+        // token.
         assert(pt != lexer.cend());
 
         // set up the node that will be filled with data now.
         // if it already exists, this means we are adding more information to it, e.g.
         // a branch length or a tag. so we do not need to create it.
-        // however, if this node does not exist, this means we saw a token before that finished an
-        // node and pushed it to the stack (either closing bracket or comma), so we need to create a
-        // new one here.
+        // however, if this node does not exist, this means we saw a token before that finished a
+        // node (comma) or started a subtree (opening bracket), so the new node is a leaf.
         if (!node) {
-            node = new NewickBrokerElement();
-            node->depth = depth;
-
-            // checks if the new node is a leaf.
-            // for this, we need to check whether the previous token was an opening brackt or a
-            // comma. however, as comments can appear everywhere, we need to check for the first
-            // non-comment-token.
-            Lexer::const_iterator t = pt;
-            while (t != lexer.cbegin() && t->IsComment()) {
-                --t;
-            }
-            node->is_leaf = t->IsBracket("(") || t->IsOperator(",");
+            node = create_node();
+            element.depth   = open_nodes.size();
+            element.is_leaf = true;
         }
 
         // ------------------------------------------------------
@@ -150,19 +281,19 @@ bool NewickProcessor::FromLexer (const NewickLexer& lexer, Tree<NDT, EDT>& tree)
         // ------------------------------------------------------
         if (ct->IsSymbol() || ct->IsString()) {
             if (!(
-                pt->IsBracket("(")  || pt->IsBracket(")") ||
-                pt->IsOperator(",") || pt->IsComment()
+                pt->IsBracket('(')  || pt->IsBracket(')') ||
+                pt->IsOperator(',') || pt->IsComment()
             )) {
                 error = "Invalid characters at " + ct->at() + ": '" + ct->value() + "'.";
                 break;
             }
 
             // populate the node
+            // assign the chars of the token, which reuses the memory of the previous name.
+            element.name.assign(ct->data(), ct->size());
             if (ct->IsSymbol()) {
                 // unquoted labels need to turn underscores into space
-                node->name = StringReplaceAll(ct->value(), "_", " ");
-            } else {
-                node->name = ct->value();
+                std::replace(element.name.begin(), element.name.end(), '_', ' ');
             }
             continue;
         }
@@ -172,15 +303,15 @@ bool NewickProcessor::FromLexer (const NewickLexer& lexer, Tree<NDT, EDT>& tree)
         // ------------------------------------------------------
         if (ct->IsNumber()) {
             if (!(
-                pt->IsBracket("(") || pt->IsBracket(")")  || pt->IsSymbol() || pt->IsString() ||
-                pt->IsComment()    || pt->IsOperator(",")
+                pt->IsBracket('(') || pt->IsBracket(')')  || pt->IsSymbol() || pt->IsString() ||
+                pt->IsComment()    || pt->IsOperator(',')
             )) {
                 error = "Invalid characters at " + ct->at() + ": '" + ct->value() + "'.";
                 break;
             }
 
             // populate the node
-            node->branch_length = std::stod(ct->value());
+            element.branch_length = ct->ToDouble();
             continue;
         }
 
@@ -192,96 +323,69 @@ bool NewickProcessor::FromLexer (const NewickLexer& lexer, Tree<NDT, EDT>& tree)
             // current node/edge, thus we need to store it
 
             // populate the node
-            node->tags.push_back(ct->value());
-            continue;
-        }
-
-        // ------------------------------------------------------
-        //     is comment []  ==>  comment
-        // ------------------------------------------------------
-        if (ct->IsComment()) {
-            // in some newick extensions, a comment has a semantic meaning that belongs to the
-            // current node/edge, thus we need to store it
-
-            // populate the node
-            node->comments.push_back(ct->value());
+            element.tags.emplace_back(ct->data(), ct->size());
             continue;
         }
 
         // ------------------------------------------------------
         //     is comma ','  ==>  next subtree
         // ------------------------------------------------------
-        if (ct->IsOperator(",")) {
-            if (!(
-                pt->IsBracket("(") || pt->IsBracket(")") || pt->IsComment() || pt->IsSymbol() ||
-                pt->IsString()     || pt->IsNumber()     || pt->IsTag()     || pt->IsOperator(",")
+        if (ct->IsOperator(',')) {
+            if (open_nodes.empty() || !(
+                pt->IsBracket('(') || pt->IsBracket(')') || pt->IsComment() || pt->IsSymbol() ||
+                pt->IsString()     || pt->IsNumber()     || pt->IsTag()     || pt->IsOperator(',')
             )) {
                 error = "Invalid ',' at " + ct->at() + ": '" + ct->value() + "'.";
                 break;
             }
 
-            // populate the node
-            if (node->name.empty() && use_default_names) {
-                if (node->is_leaf) {
-                    node->name = default_leaf_name;
-                } else {
-                    node->name = default_internal_name;
-                }
-            }
-            broker.PushTop(node);
-            node = nullptr;
+            complete_node(false);
             continue;
         }
 
         // ------------------------------------------------------
         //     is bracket ')'  ==>  end of subtree
         // ------------------------------------------------------
-        if (ct->IsBracket(")")) {
-            if (depth == 0) {
+        if (ct->IsBracket(')')) {
+            if (open_nodes.empty()) {
                 error = "Too many ')' at " + ct->at() + ".";
                 break;
             }
             if (!(
-                pt->IsBracket(")") || pt->IsTag()    || pt->IsComment()     || pt->IsSymbol() ||
-                pt->IsString()     || pt->IsNumber() || pt->IsOperator(",")
+                pt->IsBracket(')') || pt->IsTag()    || pt->IsComment()     || pt->IsSymbol() ||
+                pt->IsString()     || pt->IsNumber() || pt->IsOperator(',')
             )) {
                 error = "Invalid ')' at " + ct->at() + ": '" + ct->value() + "'.";
                 break;
             }
 
-            // populate the node
-            if (node->name.empty() && use_default_names) {
-                if (node->is_leaf) {
-                    node->name = default_leaf_name;
-                } else {
-                    node->name = default_internal_name;
-                }
-            }
-            broker.PushTop(node);
-            node = nullptr;
+            complete_node(false);
 
-            --depth;
+            // close the circle of links of the inner node, which is now populated with its data.
+            node = open_nodes.back().first;
+            open_nodes.back().second->next_ = node->link_;
+            open_nodes.pop_back();
+            element.depth   = open_nodes.size();
+            element.is_leaf = false;
             continue;
         }
 
         // ------------------------------------------------------
         //     is semicolon ';'  ==>  end of tree
         // ------------------------------------------------------
-        if (ct->IsOperator(";")) {
+        if (ct->IsOperator(';')) {
             if (!(
-                pt->IsBracket(")") || pt->IsSymbol() || pt->IsString() || pt->IsComment() ||
+                pt->IsBracket(')') || pt->IsSymbol() || pt->IsString() || pt->IsComment() ||
                 pt->IsNumber()     || pt->IsTag()
             )) {
                 error = "Invalid ';' at " + ct->at() + ": '" + ct->value() + "'.";
                 break;
             }
-
-            // populate the node
-            if (node->name.empty() && use_default_names) {
-                node->name = default_root_name;
+            if (!open_nodes.empty()) {
+                break;
             }
-            broker.PushTop(node);
-            node = nullptr;
+
+            complete_node(true);
             break;
         }
 
@@ -291,35 +395,67 @@ bool NewickProcessor::FromLexer (const NewickLexer& lexer, Tree<NDT, EDT>& tree)
         assert(false);
     }
 
-    if (!error.empty()) {
-        LOG_WARN << error;
-        return false;
+    if (error.empty() && !open_nodes.empty()) {
+        error = "Not enough closing parenthesis.";
     }
-
-    if (depth != 0) {
-        LOG_WARN << "Not enough closing parenthesis.";
-        return false;
-    }
-
-    if (ct == lexer.cend() || !ct->IsOperator(";")) {
-        LOG_WARN << "Tree does not finish with a semicolon.";
-        return false;
+    if (error.empty() && (ct == lexer.cend() || !ct->IsOperator(';'))) {
+        error = "Tree does not finish with a semicolon.";
     }
 
     // TODO we now stop at the first semicolon. is that good?
     // TODO do we even need to parse the rest as a new tree?
 
     // skip the semicolon, then see if there is anything other than a comment left
-    ++ct;
-    while (ct != lexer.cend() && ct->IsComment()) {
+    if (error.empty()) {
         ++ct;
+        while (ct != lexer.cend() && ct->IsComment()) {
+            ++ct;
+        }
+        if (ct != lexer.cend()) {
+            error = "Tree contains more data after the semicolon.";
+        }
     }
-    if (ct != lexer.cend()) {
-        LOG_WARN << "Tree contains more data after the semicolon.";
+
+    if (!error.empty()) {
+        LOG_WARN << error;
+        for (LinkType* link : links) {
+            delete link;
+        }
+        for (NodeType* n : nodes) {
+            delete n;
+        }
+        for (EdgeType* edge : edges) {
+            delete edge;
+        }
         return false;
     }
 
-    FromBroker(broker, tree);
+    // bring the elements into the order that FromBroker() creates: the nodes in reverse postorder,
+    // so that the root comes first, the edges in the order of the nodes below them, and the links
+    // of each node in the order of the nodes, starting at the link towards the root.
+    assert(postorder.size() == nodes.size() && postorder.back() == nodes.front());
+    nodes.assign(postorder.rbegin(), postorder.rend());
+    links.clear();
+    edges.clear();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        NodeType* cur_node = nodes[i];
+        cur_node->index_ = i;
+        if (i > 0) {
+            EdgeType* up_edge = cur_node->link_->edge_;
+            up_edge->index_ = edges.size();
+            edges.push_back(up_edge);
+        }
+
+        LinkType* link = cur_node->link_;
+        do {
+            link->index_ = links.size();
+            links.push_back(link);
+            link = link->next_;
+        } while (link != cur_node->link_);
+    }
+
+    // hand over the elements to the tree
+    tree.Import(links, nodes, edges);
     return true;
 }
 
@@ -0,0 +1,126 @@
+#ifndef GENESIS_TREE_NEWICKTREESETREADER_H_
+#define GENESIS_TREE_NEWICKTREESETREADER_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup tree
+ */
+
+#include <istream>
+#include <memory>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "tree/tree.hpp"
+
+namespace genesis {
+
+// =============================================================================
+//     Newick Tree Set Reader
+// =============================================================================
+
+/**
+ * @brief Reads a file or string containing many Newick trees one after another, for example the
+ * replicates of a bootstrap analysis or the samples of an MCMC run.
+ *
+ * The trees are read lazily: Each call of Next() yields the next tree of the input, in the order
+ * of the input. Internally, the input is read in chunks and split into the texts of single trees
+ * at each semicolon that is not part of a label, comment or tag. Only a window of #window_size
+ * trees is held in memory at a time. The trees of a window are parsed using
+ * Options::number_of_threads threads if compiled with `PTHREADS`.
+ *
+ * Example:
+ *
+ *     NewickTreeSetReader<DefaultNodeData, DefaultEdgeData> reader;
+ *     reader.OpenFile("bootstrap.newick");
+ *
+ *     DefaultTree tree;
+ *     while (reader.Next(tree)) {
+ *         // do something with the tree
+ *     }
+ *     if (reader.HasError()) {
+ *         // the input contained an invalid tree
+ *     }
+ */
+template <class NodeDataType, class EdgeDataType>
+class NewickTreeSetReader
+{
+public:
+
+    typedef Tree<NodeDataType, EdgeDataType> TreeType;
+
+    // -----------------------------------------------------
+    //     Constructor and Input
+    // -----------------------------------------------------
+
+    NewickTreeSetReader ();
+
+    bool OpenFile   (const std::string& fn);
+    void OpenString (const std::string& ts);
+    void Close ();
+
+    // -----------------------------------------------------
+    //     Reading
+    // -----------------------------------------------------
+
+    bool Next (TreeType& tree);
+
+    /** @brief Returns the number of trees that were yielded by Next() so far. */
+    inline size_t TreeCount() const
+    {
+        return tree_count_;
+    }
+
+    /** @brief Returns whether reading stopped because of an invalid tree. */
+    inline bool HasError() const
+    {
+        return has_error_;
+    }
+
+    // -----------------------------------------------------
+    //     Settings
+    // -----------------------------------------------------
+
+    size_t window_size;
+
+    // -----------------------------------------------------
+    //     Internal Members
+    // -----------------------------------------------------
+
+protected:
+
+    bool ReadTreeText (std::string& text);
+    bool FillWindow ();
+
+    void ParseThread (const int offset, const int incr);
+
+    /** @brief Number of chars that are read from the input at once. */
+    static const size_t kChunkSize = 1 << 16;
+
+    std::unique_ptr<std::istream> stream_;
+    std::vector<char>             chunk_;
+    size_t                        chunk_pos_;
+    size_t                        chunk_end_;
+
+    std::vector<std::string>      texts_;
+    std::vector<TreeType>         trees_;
+    std::vector<char>             parsed_;
+    size_t                        window_pos_;
+
+    size_t                        tree_count_;
+    bool                          has_error_;
+};
+
+} // namespace genesis
+
+// =============================================================================
+//     Inclusion of the implementation
+// =============================================================================
+
+// This class contains function templates, so do the inclusion here.
+#include "tree/newick_tree_set_reader.tpp"
+
+#endif // include guard
@@ -0,0 +1,256 @@
+/**
+ * @brief Implementation of the Newick Tree Set Reader class.
+ *
+ * For reasons of readability, in this implementation file, the template data types
+ * NodeDataType and EdgeDataType are abbreviated using NDT and EDT, respectively.
+ *
+ * @file
+ * @ingroup tree
+ */
+
+#include <algorithm>
+#include <assert.h>
+#include <fstream>
+#include <sstream>
+
+#ifdef PTHREADS
+#    include <thread>
+#endif
+
+#include "tree/newick_processor.hpp"
+#include "utils/logging.hpp"
+#include "utils/options.hpp"
+#include "utils/utils.hpp"
+
+namespace genesis {
+
+template <class NDT, class EDT>
+const size_t NewickTreeSetReader<NDT, EDT>::kChunkSize;
+
+// =============================================================================
+//     Constructor and Input
+// =============================================================================
+
+/**
+ * @brief Constructor that sets the default window size of 64 trees.
+ */
+template <class NDT, class EDT>
+NewickTreeSetReader<NDT, EDT>::NewickTreeSetReader () :
+    window_size(64),
+    chunk_pos_(0),
+    chunk_end_(0),
+    window_pos_(0),
+    tree_count_(0),
+    has_error_(false)
+{}
+
+/**
+ * @brief Opens a file for reading its trees. Returns true iff successful.
+ */
+template <class NDT, class EDT>
+bool NewickTreeSetReader<NDT, EDT>::OpenFile (const std::string& fn)
+{
+    Close();
+    if (!FileExists(fn)) {
+        LOG_WARN << "Newick file '" << fn << "' does not exist.";
+        return false;
+    }
+    stream_.reset(new std::ifstream(fn, std::ios::binary));
+    chunk_.resize(kChunkSize);
+    return true;
+}
+
+/**
+ * @brief Uses a string for reading its trees.
+ */
+template <class NDT, class EDT>
+void NewickTreeSetReader<NDT, EDT>::OpenString (const std::string& ts)
+{
+    Close();
+    stream_.reset(new std::istringstream(ts));
+    chunk_.resize(kChunkSize);
+}
+
+/**
+ * @brief Closes the input and clears all buffered trees. The settings are kept.
+ */
+template <class NDT, class EDT>
+void NewickTreeSetReader<NDT, EDT>::Close ()
+{
+    stream_.reset();
+    std::vector<char>().swap(chunk_);
+    chunk_pos_ = 0;
+    chunk_end_ = 0;
+
+    texts_.clear();
+    trees_.clear();
+    parsed_.clear();
+    window_pos_ = 0;
+
+    tree_count_ = 0;
+    has_error_  = false;
+}
+
+// =============================================================================
+//     Reading
+// =============================================================================
+
+/**
+ * @brief Yields the next tree of the input by swapping it into the given tree.
+ *
+ * Returns false if there are no more trees in the input, or if the next tree is invalid. In the
+ * latter case, a warning is issued, HasError() returns true, and no further trees are read.
+ */
+template <class NDT, class EDT>
+bool NewickTreeSetReader<NDT, EDT>::Next (TreeType& tree)
+{
+    if (window_pos_ == trees_.size() && !FillWindow()) {
+        return false;
+    }
+    assert(window_pos_ < trees_.size());
+
+    if (!parsed_[window_pos_]) {
+        LOG_WARN << "Invalid tree number " << tree_count_ + 1 << " in Newick tree set.";
+        has_error_ = true;
+        stream_.reset();
+        trees_.clear();
+        window_pos_ = 0;
+        return false;
+    }
+
+    tree.swap(trees_[window_pos_]);
+    trees_[window_pos_].clear();
+    ++window_pos_;
+    ++tree_count_;
+    return true;
+}
+
+/**
+ * @brief Reads the text of the next tree from the input, including its semicolon.
+ *
+ * Returns false if there is nothing but whitespace left in the input. If the input ends without a
+ * semicolon, the remaining text is returned nonetheless, so that the parser can report it.
+ */
+template <class NDT, class EDT>
+bool NewickTreeSetReader<NDT, EDT>::ReadTreeText (std::string& text)
+{
+    text.clear();
+
+    // a semicolon only ends the tree if it is not part of a quoted label, comment or tag.
+    bool in_quote   = false;
+    bool in_comment = false;
+    bool in_tag     = false;
+
+    while (true) {
+        if (chunk_pos_ == chunk_end_) {
+            if (!stream_ || !*stream_) {
+                break;
+            }
+            stream_->read(chunk_.data(), kChunkSize);
+            chunk_pos_ = 0;
+            chunk_end_ = stream_->gcount();
+            if (chunk_end_ == 0) {
+                break;
+            }
+        }
+
+        const size_t start = chunk_pos_;
+        bool         done  = false;
+        for (; chunk_pos_ < chunk_end_; ++chunk_pos_) {
+            const char c = chunk_[chunk_pos_];
+            if (in_quote) {
+                // doubled quotation marks inside a label just leave and re-enter the quote.
+                in_quote = c != '\'';
+            } else if (in_comment) {
+                in_comment = c != ']';
+            } else if (in_tag) {
+                in_tag = c != '}';
+            } else if (c == '\'') {
+                in_quote = true;
+            } else if (c == '[') {
+                in_comment = true;
+            } else if (c == '{') {
+                in_tag = true;
+            } else if (c == ';') {
+                ++chunk_pos_;
+                done = true;
+                break;
+            }
+        }
+        text.append(chunk_.data() + start, chunk_pos_ - start);
+        if (done) {
+            return true;
+        }
+    }
+
+    return text.find_first_not_of(" \f\n\r\t\v") != std::string::npos;
+}
+
+/**
+ * @brief Reads the texts of the next window of trees and parses them.
+ *
+ * Returns false if there are no more trees in the input.
+ */
+template <class NDT, class EDT>
+bool NewickTreeSetReader<NDT, EDT>::FillWindow ()
+{
+    texts_.clear();
+    trees_.clear();
+    parsed_.clear();
+    window_pos_ = 0;
+    if (has_error_ || !stream_) {
+        return false;
+    }
+
+    std::string text;
+    while (texts_.size() < std::max(window_size, static_cast<size_t>(1)) && ReadTreeText(text)) {
+        texts_.push_back(std::move(text));
+    }
+    if (texts_.empty()) {
+        return false;
+    }
+
+    // each tree is parsed into its own slot, so that the order of the input is kept.
+    trees_  = std::vector<TreeType>(texts_.size());
+    parsed_ = std::vector<char>(texts_.size(), false);
+
+#ifdef PTHREADS
+
+    // start all threads. each of them parses an interleaved subset of the trees.
+    int num_threads = std::min(
+        static_cast<size_t>(std::max(Options::number_of_threads, 1u)), texts_.size()
+    );
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back(&NewickTreeSetReader<NDT, EDT>::ParseThread, this, i, num_threads);
+    }
+
+    // wait for all threads to finish.
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+#else
+
+    // do all the work in one "thread".
+    ParseThread(0, 1);
+
+#endif
+
+    texts_.clear();
+    return true;
+}
+
+/**
+ * @brief Thread function that parses an interleaved subset of the trees of the window.
+ */
+template <class NDT, class EDT>
+void NewickTreeSetReader<NDT, EDT>::ParseThread (const int offset, const int incr)
+{
+    // each thread writes to its own disjoint set of slots, so no locking is needed.
+    for (size_t i = offset; i < texts_.size(); i += incr) {
+        parsed_[i] = NewickProcessor::FromString(texts_[i], trees_[i]);
+    }
+}
+
+} // namespace genesis
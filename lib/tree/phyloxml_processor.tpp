@@ -11,8 +11,10 @@
 #include <assert.h>
 #include <vector>
 
+#include "tree/newick_processor.hpp"
 #include "tree/tree.hpp"
 #include "utils/logging.hpp"
+#include "utils/utils.hpp"
 #include "utils/xml_document.hpp"
 #include "utils/xml_processor.hpp"
 
@@ -135,6 +137,16 @@ void PhyloXmlProcessor::ToDocument (XmlDocument& xml, const Tree<NDT, EDT>& tree
         name_e->content.push_back(name_m);
         name_m->content = it.Node()->name;
 
+        // create branch length for clade. the root does not have an edge towards its parent.
+        if (!it.IsFirstIteration()) {
+            XmlElement* bl_e = new XmlElement();
+            clade->content.push_back(bl_e);
+            bl_e->tag = "branch_length";
+            XmlMarkup* bl_m = new XmlMarkup();
+            bl_e->content.push_back(bl_m);
+            bl_m->content = ToStringPrecise(it.Edge()->branch_length, NewickProcessor::precision);
+        }
+
         //~ it.Node()->ToNewickBrokerElement(bn);
         // only write edge data to the broker element if it is not the last iteration.
         // the last iteration is the root, which usually does not have edge information in newick.
@@ -534,9 +534,9 @@ public:
 
     double Length() const;
 
-    Matrix<int>*        NodeDepthMatrix    ()                               const;
+    Matrix<int>         NodeDepthMatrix    ()                               const;
     std::vector<int>    NodeDepthVector    (const NodeType* node = nullptr) const;
-    Matrix<double>*     NodeDistanceMatrix ()                               const;
+    Matrix<double>      NodeDistanceMatrix ()                               const;
     std::vector<double> NodeDistanceVector (const NodeType* node = nullptr) const;
 
     typedef std::vector< std::pair<const NodeType*, int> >    NodeIntVectorType;
@@ -575,11 +575,23 @@ public:
     std::string DumpLists() const;
 
     // -----------------------------------------------------
-    //     Data Members
+    //     Internal Helpers
     // -----------------------------------------------------
 
 protected:
 
+    template <class T>
+    static void ClosestLeafUpdate(
+        std::vector< std::pair<const NodeType*, T> >& vec,
+        const NodeType*                               to,
+        const NodeType*                               from,
+        const T                                       distance
+    );
+
+    // -----------------------------------------------------
+    //     Data Members
+    // -----------------------------------------------------
+
     std::vector<LinkType*> links_;
     std::vector<NodeType*> nodes_;
     std::vector<EdgeType*> edges_;
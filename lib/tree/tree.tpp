@@ -283,9 +283,9 @@ double Tree<NDT, EDT>::Length() const
  * The vector is indexed using the Node()->Index() for every node.
  */
 template <class NDT, class EDT>
-Matrix<int>* Tree<NDT, EDT>::NodeDepthMatrix() const
+Matrix<int> Tree<NDT, EDT>::NodeDepthMatrix() const
 {
-    Matrix<int>* mat = new Matrix<int>(NodeCount(), NodeCount());
+    Matrix<int> mat (NodeCount(), NodeCount());
     // TODO implement!
     LOG_WARN << "Not yet implemented.";
     return mat;
@@ -342,14 +342,14 @@ std::vector<int> Tree<NDT, EDT>::NodeDepthVector(const NodeType* node) const
  * The elements of the matrix are indexed using Node()->Index().
  */
 template <class NDT, class EDT>
-Matrix<double>* Tree<NDT, EDT>::NodeDistanceMatrix() const
+Matrix<double> Tree<NDT, EDT>::NodeDistanceMatrix() const
 {
-    Matrix<double>* mat = new Matrix<double>(NodeCount(), NodeCount(), -1.0);
+    Matrix<double> mat (NodeCount(), NodeCount(), -1.0);
 
     // fill every row of the matrix
     for (NodeType* row_node : nodes_) {
         // set the diagonal element of the matrix.
-        (*mat)(row_node->Index(), row_node->Index()) = 0.0;
+        mat(row_node->Index(), row_node->Index()) = 0.0;
 
         // the columns are filled using a levelorder traversal. this makes sure that for every node
         // we know how to calculate the distance to the current row node.
@@ -368,14 +368,14 @@ Matrix<double>* Tree<NDT, EDT>::NodeDistanceMatrix() const
 
             // make sure we don't have touched the current position, but have calculated
             // the needed dependency already.
-            assert((*mat)(row_node->Index(), it.Node()->Index()) == -1.0);
-            assert((*mat)(row_node->Index(), it.Link()->Outer()->Node()->Index()) > -1.0);
+            assert(mat(row_node->Index(), it.Node()->Index()) == -1.0);
+            assert(mat(row_node->Index(), it.Link()->Outer()->Node()->Index()) > -1.0);
 
             // the distance to the current row node is: the length of the current branch plus
             // the distance from the other end of that branch to the row node.
-            (*mat)(row_node->Index(), it.Node()->Index())
+            mat(row_node->Index(), it.Node()->Index())
                 = it.Edge()->branch_length
-                + (*mat)(row_node->Index(), it.Link()->Outer()->Node()->Index());
+                + mat(row_node->Index(), it.Link()->Outer()->Node()->Index());
         }
     }
 
@@ -416,6 +416,8 @@ std::vector<double> Tree<NDT, EDT>::NodeDistanceVector(const NodeType* node) con
  *
  * There might be more than one leaf with the same depth to a given node. In this case, an
  * arbitrary one is used.
+ *
+ * The vector is computed in linear time, using one postorder and one preorder traversal.
  */
 template <class NDT, class EDT>
 typename Tree<NDT, EDT>::NodeIntVectorType Tree<NDT, EDT>::ClosestLeafDepthVector() const
@@ -424,26 +426,29 @@ typename Tree<NDT, EDT>::NodeIntVectorType Tree<NDT, EDT>::ClosestLeafDepthVecto
     NodeIntVectorType vec;
     vec.resize(NodeCount(), {nullptr, 0});
 
-    // fill the vector for every node.
-    // this could be speed up by doing a postorder traversal followed by some sort of inside-out
-    // traversal (preorder might do the job). but for now, this simple O(n^2) version works, too.
+    // the closest leaf of a node is either in its subtree or reached via its parent node. thus, we
+    // first find the closest leaf of each subtree in a postorder traversal, and then take the
+    // paths via the parents into account in a preorder traversal. leaves are their own closest.
     for (NodeType* node : nodes_) {
-        // we have not visited this node. assertion holds as long as the indices are correct.
-        assert(vec[node->Index()].first == nullptr);
+        if (node->IsLeaf()) {
+            vec[node->Index()].first = node;
+        }
+    }
+    for (ConstIteratorPostorder it = BeginPostorder(); it != EndPostorder(); ++it) {
+        if (it.IsLastIteration()) {
+            continue;
+        }
 
-        // look for closest leaf node by doing a levelorder traversal.
-        for (
-            ConstIteratorLevelorder it = BeginLevelorder(node);
-            it != EndLevelorder();
-            ++it
-        ) {
-            // if we find a leaf, leave the loop.
-            if (it.Node()->IsLeaf()) {
-                vec[node->Index()].first  = it.Node();
-                vec[node->Index()].second = it.Depth();
-                break;
-            }
+        // all children of the node were visited before, so its own value is final here.
+        // assertion holds as long as there are no inner nodes of degree one.
+        assert(vec[it.Node()->Index()].first != nullptr);
+        ClosestLeafUpdate(vec, it.Edge()->PrimaryNode(), it.Node(), 1);
+    }
+    for (ConstIteratorPreorder it = BeginPreorder(); it != EndPreorder(); ++it) {
+        if (it.IsFirstIteration()) {
+            continue;
         }
+        ClosestLeafUpdate(vec, it.Node(), it.Edge()->PrimaryNode(), 1);
     }
 
     return vec;
@@ -457,6 +462,8 @@ typename Tree<NDT, EDT>::NodeIntVectorType Tree<NDT, EDT>::ClosestLeafDepthVecto
  * where the first element is a NodeType* to the closest leaf node of the node at the index,
  * measured using the branch_length; the second element of the pair is the distance value itself.
  * Thus, leaf nodes will have a pointer to themselves and a distance value of 0.
+ *
+ * The vector is computed in linear time, see ClosestLeafDepthVector() for details.
  */
 template <class NDT, class EDT>
 typename Tree<NDT, EDT>::NodeDoubleVectorType Tree<NDT, EDT>::ClosestLeafDistanceVector() const
@@ -465,39 +472,54 @@ typename Tree<NDT, EDT>::NodeDoubleVectorType Tree<NDT, EDT>::ClosestLeafDistanc
     NodeDoubleVectorType vec;
     vec.resize(NodeCount(), {nullptr, 0.0});
 
-    // we need the pairwise distances between all nodes, so we can do quick loopups.
-    Matrix<double>* node_distances = NodeDistanceMatrix();
-
-    // fill the vector for every node.
-    // there is probably a faster way of doing this: preorder traversal with pruning. but for now,
-    // this simple O(n^2) version works.
+    // same two passes as in ClosestLeafDepthVector(), but using the branch lengths.
     for (NodeType* node : nodes_) {
-        // we have not visited this node. assertion holds as long as the indices are correct.
-        assert(vec[node->Index()].first == nullptr);
-
-        NodeType* min_node = nullptr;
-        double    min_dist = 0.0;
-
-        // try out all other nodes, and find the closest leaf.
-        for (NodeType* other : nodes_) {
-            if (!other->IsLeaf()) {
-                continue;
-            }
-
-            double dist = (*node_distances)(node->Index(), other->Index());
-            if (min_node == nullptr || dist < min_dist) {
-                min_node = other;
-                min_dist = dist;
-            }
+        if (node->IsLeaf()) {
+            vec[node->Index()].first = node;
         }
-
-        vec[node->Index()].first  = min_node;
-        vec[node->Index()].second = min_dist;
+    }
+    for (ConstIteratorPostorder it = BeginPostorder(); it != EndPostorder(); ++it) {
+        if (it.IsLastIteration()) {
+            continue;
+        }
+        assert(vec[it.Node()->Index()].first != nullptr);
+        ClosestLeafUpdate(vec, it.Edge()->PrimaryNode(), it.Node(), it.Edge()->branch_length);
+    }
+    for (ConstIteratorPreorder it = BeginPreorder(); it != EndPreorder(); ++it) {
+        if (it.IsFirstIteration()) {
+            continue;
+        }
+        ClosestLeafUpdate(vec, it.Node(), it.Edge()->PrimaryNode(), it.Edge()->branch_length);
     }
 
     return vec;
 }
 
+/**
+ * @brief Local helper for ClosestLeafDepthVector() and ClosestLeafDistanceVector() that updates
+ * the closest leaf of node `to` if the one of its neighbour `from` plus the `distance` between
+ * them is closer.
+ */
+template <class NDT, class EDT>
+template <class T>
+void Tree<NDT, EDT>::ClosestLeafUpdate(
+    std::vector< std::pair<const NodeType*, T> >& vec,
+    const NodeType*                               to,
+    const NodeType*                               from,
+    const T                                       distance
+) {
+    const std::pair<const NodeType*, T>& src = vec[from->Index()];
+    std::pair<const NodeType*, T>&       dst = vec[to->Index()];
+
+    if (src.first == nullptr) {
+        return;
+    }
+    if (dst.first == nullptr || src.second + distance < dst.second) {
+        dst.first  = src.first;
+        dst.second = src.second + distance;
+    }
+}
+
 /**
  * @brief Returns the longest distance from any point in the tree (on the edges) to any leaf.
  */
@@ -0,0 +1,111 @@
+#ifndef GENESIS_TREE_TREE_DISTANCE_INDEX_H_
+#define GENESIS_TREE_TREE_DISTANCE_INDEX_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup tree
+ */
+
+#include <memory>
+#include <stddef.h>
+#include <vector>
+
+#include "plausibility/RMQ_succinct.hpp"
+#include "tree/tree.hpp"
+
+namespace genesis {
+
+// =============================================================================
+//     Tree Distance Index
+// =============================================================================
+
+/**
+ * @brief Index for constant time distance queries between the Nodes of a Tree.
+ *
+ * The index stores the distance (sum of branch_length%s) and depth (number of edges) of each node
+ * from the root, as well as an Euler tour of the tree, on which a range minimum query structure
+ * (RMQ_succinct) is built. This allows to find the lowest common ancestor (LCA) of two nodes in
+ * constant time, and thus their distance as
+ * \f$ d(u, v) = d(root, u) + d(root, v) - 2 d(root, LCA(u, v)) \f$.
+ *
+ * In contrast to Tree::NodeDistanceMatrix(), which needs quadratic time and memory, the index is
+ * built in linear time and memory, and can thus also be used for large trees.
+ *
+ * All functions take the Node()->Index() of the nodes. The index is only valid as long as the
+ * topology and branch lengths of the tree are not changed.
+ */
+template <class NodeDataType, class EdgeDataType>
+class TreeDistanceIndex
+{
+public:
+
+    // -------------------------------------------------------------
+    //     Declarations and Constructor
+    // -------------------------------------------------------------
+
+    typedef Tree     <NodeDataType, EdgeDataType> TreeType;
+    typedef TreeNode <NodeDataType, EdgeDataType> NodeType;
+
+    TreeDistanceIndex (const TreeType& tree);
+
+    // -------------------------------------------------------------
+    //     Queries
+    // -------------------------------------------------------------
+
+    size_t LowestCommonAncestor (const size_t node_a, const size_t node_b) const;
+
+    double Distance (const size_t node_a, const size_t node_b) const;
+    int    Depth    (const size_t node_a, const size_t node_b) const;
+
+    /**
+     * @brief Returns the distance of a node from the root, using the branch_length.
+     */
+    inline double RootDistance (const size_t node) const
+    {
+        return root_distances_[node];
+    }
+
+    /**
+     * @brief Returns the depth (number of edges) of a node from the root.
+     */
+    inline int RootDepth (const size_t node) const
+    {
+        return root_depths_[node];
+    }
+
+    // -------------------------------------------------------------
+    //     Member Variables
+    // -------------------------------------------------------------
+
+protected:
+
+    /** @brief Minimal size of the Euler tour, as RMQ_succinct does not work for small arrays. */
+    static const size_t kMinEulerSize = 128;
+
+    std::vector<double> root_distances_;
+    std::vector<int>    root_depths_;
+
+    /** @brief Node index of each preorder rank. */
+    std::vector<size_t> preorder_nodes_;
+
+    /** @brief Position of the first occurrence of each node (by its index) in the Euler tour. */
+    std::vector<size_t> euler_first_;
+
+    /** @brief Preorder rank of the nodes in the order of the Euler tour. */
+    std::vector<int>    euler_ranks_;
+
+    std::unique_ptr<RMQ_succinct> rmq_;
+};
+
+} // namespace genesis
+
+// =============================================================================
+//     Inclusion of the implementation
+// =============================================================================
+
+// This is a class template, so do the inclusion here.
+#include "tree/tree_distance_index.tpp"
+
+#endif // include guard
@@ -0,0 +1,126 @@
+/**
+ * @brief Implementation of TreeDistanceIndex class.
+ *
+ * For reasons of readability, in this implementation file, the template data types
+ * NodeDataType and EdgeDataType are abbreviated using NDT and EDT, respectively.
+ *
+ * @file
+ * @ingroup tree
+ */
+
+#include <assert.h>
+#include <climits>
+#include <utility>
+
+namespace genesis {
+
+template <class NDT, class EDT>
+const size_t TreeDistanceIndex<NDT, EDT>::kMinEulerSize;
+
+// =============================================================================
+//     Constructor
+// =============================================================================
+
+/**
+ * @brief Builds the index for a tree, in time and memory linear in its number of nodes.
+ */
+template <class NDT, class EDT>
+TreeDistanceIndex<NDT, EDT>::TreeDistanceIndex (const TreeType& tree)
+{
+    if (tree.NodeCount() == 0) {
+        return;
+    }
+
+    // get the distances and depths of all nodes from the root, and their preorder ranks. in a
+    // preorder traversal, the node at the other end of the current edge was already visited.
+    std::vector<int> ranks (tree.NodeCount(), 0);
+    root_distances_.resize(tree.NodeCount(), 0.0);
+    root_depths_.resize(tree.NodeCount(), 0);
+    preorder_nodes_.reserve(tree.NodeCount());
+    for (
+        typename TreeType::ConstIteratorPreorder it = tree.BeginPreorder();
+        it != tree.EndPreorder();
+        ++it
+    ) {
+        size_t node = it.Node()->Index();
+        ranks[node] = preorder_nodes_.size();
+        preorder_nodes_.push_back(node);
+
+        if (it.IsFirstIteration()) {
+            continue;
+        }
+        size_t parent = it.Link()->Outer()->Node()->Index();
+        root_distances_[node] = root_distances_[parent] + it.Edge()->branch_length;
+        root_depths_[node]    = root_depths_[parent] + 1;
+    }
+
+    // store the preorder ranks of the nodes in the order of an Euler tour. all nodes between the
+    // first occurrences of two nodes belong to the subtree of their LCA, which itself is the node
+    // with the smallest preorder rank in between.
+    euler_first_.resize(tree.NodeCount(), 0);
+    std::vector<bool> visited (tree.NodeCount(), false);
+    for (
+        typename TreeType::ConstIteratorEulertour it = tree.BeginEulertour();
+        it != tree.EndEulertour();
+        ++it
+    ) {
+        size_t node = it.Node()->Index();
+        if (!visited[node]) {
+            visited[node]      = true;
+            euler_first_[node] = euler_ranks_.size();
+        }
+        euler_ranks_.push_back(ranks[node]);
+    }
+
+    // the RMQ does not work for small arrays, so fill them up with values that are never the
+    // minimum of a query.
+    if (euler_ranks_.size() < kMinEulerSize) {
+        euler_ranks_.resize(kMinEulerSize, INT_MAX);
+    }
+    rmq_.reset(new RMQ_succinct(euler_ranks_.data(), euler_ranks_.size()));
+}
+
+// =============================================================================
+//     Queries
+// =============================================================================
+
+/**
+ * @brief Returns the index of the lowest common ancestor of two nodes, with respect to the root
+ * of the tree.
+ */
+template <class NDT, class EDT>
+size_t TreeDistanceIndex<NDT, EDT>::LowestCommonAncestor (
+    const size_t node_a, const size_t node_b
+) const {
+    assert(rmq_);
+
+    size_t first_a = euler_first_[node_a];
+    size_t first_b = euler_first_[node_b];
+    if (first_a > first_b) {
+        std::swap(first_a, first_b);
+    }
+    return preorder_nodes_[euler_ranks_[rmq_->query(first_a, first_b)]];
+}
+
+/**
+ * @brief Returns the distance between two nodes, using the branch_length.
+ */
+template <class NDT, class EDT>
+double TreeDistanceIndex<NDT, EDT>::Distance (const size_t node_a, const size_t node_b) const
+{
+    size_t lca = LowestCommonAncestor(node_a, node_b);
+    return root_distances_[node_a] + root_distances_[node_b] - 2.0 * root_distances_[lca];
+}
+
+/**
+ * @brief Returns the depth between two nodes, that is, the number of edges on the path between
+ * them.
+ */
+template <class NDT, class EDT>
+int TreeDistanceIndex<NDT, EDT>::Depth (const size_t node_a, const size_t node_b) const
+{
+    size_t lca = LowestCommonAncestor(node_a, node_b);
+    return root_depths_[node_a] + root_depths_[node_b] - 2 * root_depths_[lca];
+}
+
+} // namespace genesis
@@ -0,0 +1,185 @@
+#ifndef GENESIS_UTILS_ARENA_H_
+#define GENESIS_UTILS_ARENA_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup utils
+ */
+
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace genesis {
+
+// =============================================================================
+//     Arena
+// =============================================================================
+
+/**
+ * @brief Simple pool storage that creates objects in large contiguous blocks of memory.
+ *
+ * Objects are created via Create(), which returns a pointer to the new object. This pointer stays
+ * valid until the arena is cleared or destroyed, because the blocks are never moved or resized.
+ * Single objects cannot be freed. Instead, all objects are destroyed at once by clear().
+ *
+ * The blocks grow geometrically, starting with a small capacity, so that small arenas do not waste
+ * memory, while large arenas only need a few allocations. Using Reserve(), a block for a known
+ * number of objects can be allocated in advance.
+ */
+template <typename value_type>
+class Arena
+{
+public:
+    // -----------------------------------------------------
+    //     Constructor & Destructor
+    // -----------------------------------------------------
+
+    Arena () : size_(0), next_capacity_(kMinBlockSize) {}
+
+    ~Arena ()
+    {
+        clear();
+    }
+
+    Arena (const Arena&) = delete;
+    Arena& operator = (const Arena&) = delete;
+
+    /**
+     * @brief Swaps the content of two arenas. Pointers to the objects stay valid.
+     */
+    void swap (Arena& other)
+    {
+        std::swap(blocks_,        other.blocks_);
+        std::swap(size_,          other.size_);
+        std::swap(next_capacity_, other.next_capacity_);
+    }
+
+    /**
+     * @brief Destroys all objects in the arena and frees its memory.
+     */
+    void clear ()
+    {
+        for (Block& block : blocks_) {
+            for (size_t i = 0; i < block.used; ++i) {
+                block.data[i].~value_type();
+            }
+            ::operator delete(block.data);
+        }
+        std::vector<Block>().swap(blocks_);
+        size_          = 0;
+        next_capacity_ = kMinBlockSize;
+    }
+
+    // -----------------------------------------------------
+    //     Accessors
+    // -----------------------------------------------------
+
+    /**
+     * @brief Returns the number of objects that were created in this arena.
+     */
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+    // -----------------------------------------------------
+    //     Modifiers
+    // -----------------------------------------------------
+
+    /**
+     * @brief Creates a new object in the arena, passing the arguments to its constructor, and
+     * returns a pointer to it.
+     */
+    template <typename... Args>
+    value_type* Create (Args&&... args)
+    {
+        if (blocks_.empty() || blocks_.back().used == blocks_.back().capacity) {
+            AddBlock(next_capacity_);
+        }
+        Block& block = blocks_.back();
+        value_type* obj = new (block.data + block.used) value_type(std::forward<Args>(args)...);
+        ++block.used;
+        ++size_;
+        return obj;
+    }
+
+    /**
+     * @brief Makes sure that the next `n` objects can be created without further allocations, and
+     * that they are stored contiguously.
+     */
+    void Reserve (size_t n)
+    {
+        if (!blocks_.empty() && blocks_.back().capacity - blocks_.back().used >= n) {
+            return;
+        }
+        AddBlock(std::max(n, next_capacity_));
+    }
+
+    /**
+     * @brief Moves all objects of another arena into this arena, without copying or moving the
+     * objects themselves. Pointers to the objects stay valid. The other arena is empty afterwards.
+     */
+    void Splice (Arena& other)
+    {
+        if (other.blocks_.empty()) {
+            return;
+        }
+
+        // insert the blocks before the current block of this arena, so that the free space in
+        // the latter can still be used for new objects.
+        auto pos = blocks_.empty() ? blocks_.end() : blocks_.end() - 1;
+        blocks_.insert(pos, other.blocks_.begin(), other.blocks_.end());
+        size_ += other.size_;
+
+        other.blocks_.clear();
+        other.size_          = 0;
+        other.next_capacity_ = kMinBlockSize;
+    }
+
+    // -----------------------------------------------------
+    //     Internal Members
+    // -----------------------------------------------------
+
+protected:
+    /** @brief Capacity of the first block of an arena. */
+    static const size_t kMinBlockSize = 64;
+
+    /** @brief Maximal capacity of blocks that are added automatically. */
+    static const size_t kMaxBlockSize = 65536;
+
+    /** @brief POD struct that stores one block of memory. */
+    typedef struct {
+        value_type* data;
+        size_t      capacity;
+        size_t      used;
+    } Block;
+
+    void AddBlock (size_t capacity)
+    {
+        Block block;
+        block.data     = static_cast<value_type*>(::operator new(capacity * sizeof(value_type)));
+        block.capacity = capacity;
+        block.used     = 0;
+        blocks_.push_back(block);
+
+        next_capacity_ = std::min(std::max(next_capacity_, capacity) * 2, kMaxBlockSize);
+    }
+
+    std::vector<Block> blocks_;
+    size_t             size_;
+    size_t             next_capacity_;
+};
+
+template <typename value_type>
+const size_t Arena<value_type>::kMinBlockSize;
+
+template <typename value_type>
+const size_t Arena<value_type>::kMaxBlockSize;
+
+} // namespace genesis
+
+#endif // include guard
@@ -0,0 +1,194 @@
+/**
+ * @brief Implementation of the Char Set class.
+ *
+ * @file
+ * @ingroup utils
+ */
+
+#include "utils/char_set.hpp"
+
+#include <string.h>
+
+// the vectorized versions are compiled for their instruction sets using function attributes, so
+// that no special compiler flags are needed. which one is used is then decided at runtime.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define GENESIS_CHAR_SET_X86
+#    include <immintrin.h>
+#endif
+
+namespace genesis {
+
+// =============================================================================
+//     Constructor and Modification
+// =============================================================================
+
+/**
+ * @brief Constructor for an empty set.
+ */
+CharSet::CharSet ()
+{
+    Clear();
+}
+
+/**
+ * @brief Constructor that adds all chars of the given string to the set.
+ */
+CharSet::CharSet (const std::string& chars)
+{
+    Clear();
+    Add(chars);
+}
+
+/**
+ * @brief Adds all chars of a string to the set. Non-ASCII chars are ignored.
+ */
+void CharSet::Add (const std::string& chars)
+{
+    for (char c : chars) {
+        Add(c);
+    }
+}
+
+/**
+ * @brief Removes a char from the set.
+ */
+void CharSet::Remove (const char c)
+{
+    const unsigned char u = static_cast<unsigned char>(c);
+    if (u < 128) {
+        rows_[u & 0x0F] &= static_cast<unsigned char>(~(1 << (u >> 4)));
+    }
+}
+
+/**
+ * @brief Removes all chars from the set.
+ */
+void CharSet::Clear ()
+{
+    memset(rows_, 0, sizeof(rows_));
+}
+
+// =============================================================================
+//     Skipping Runs
+// =============================================================================
+
+namespace {
+
+typedef size_t (*SkipRunFunction) (
+    const unsigned char* rows, const char* text, size_t pos, const size_t len
+);
+
+/**
+ * @brief Portable version of CharSet::SkipRun().
+ */
+size_t SkipRunScalar (const unsigned char* rows, const char* text, size_t pos, const size_t len)
+{
+    while (pos < len) {
+        const unsigned char u = static_cast<unsigned char>(text[pos]);
+        if (u >= 128 || !(rows[u & 0x0F] & (1 << (u >> 4)))) {
+            break;
+        }
+        ++pos;
+    }
+    return pos;
+}
+
+#ifdef GENESIS_CHAR_SET_X86
+
+/**
+ * @brief Version of CharSet::SkipRun() that classifies 16 chars at a time using SSSE3.
+ *
+ * For each char, the row of the set table is looked up by the low nibble, and the bit within the
+ * row by the high nibble of the char. Chars with the highest bit set yield an empty bit, and thus
+ * are not part of the set.
+ */
+__attribute__((target("ssse3")))
+size_t SkipRunSsse3 (const unsigned char* rows, const char* text, size_t pos, const size_t len)
+{
+    const __m128i table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows));
+    const __m128i bits  = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i low   = _mm_set1_epi8(0x0F);
+    const __m128i zero  = _mm_setzero_si128();
+
+    while (pos + 16 <= len) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+        const __m128i row   = _mm_shuffle_epi8(table, _mm_and_si128(chars, low));
+        const __m128i bit   = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(chars, 4), low));
+        const __m128i miss  = _mm_cmpeq_epi8(_mm_and_si128(row, bit), zero);
+
+        const unsigned int mask = _mm_movemask_epi8(miss);
+        if (mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+        pos += 16;
+    }
+    return SkipRunScalar(rows, text, pos, len);
+}
+
+/**
+ * @brief Version of CharSet::SkipRun() that classifies 32 chars at a time using AVX2.
+ *
+ * Works like SkipRunSsse3(), with the tables duplicated to both 128 bit lanes.
+ */
+__attribute__((target("avx2")))
+size_t SkipRunAvx2 (const unsigned char* rows, const char* text, size_t pos, const size_t len)
+{
+    const __m128i table_half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows));
+    const __m256i table      = _mm256_broadcastsi128_si256(table_half);
+    const __m256i bits       = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0
+    );
+    const __m256i low        = _mm256_set1_epi8(0x0F);
+    const __m256i zero       = _mm256_setzero_si256();
+
+    while (pos + 32 <= len) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos));
+        const __m256i row   = _mm256_shuffle_epi8(table, _mm256_and_si256(chars, low));
+        const __m256i bit   = _mm256_shuffle_epi8(
+            bits, _mm256_and_si256(_mm256_srli_epi16(chars, 4), low)
+        );
+        const __m256i miss  = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), zero);
+
+        const unsigned int mask = _mm256_movemask_epi8(miss);
+        if (mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+        pos += 32;
+    }
+    return SkipRunSsse3(rows, text, pos, len);
+}
+
+#endif // GENESIS_CHAR_SET_X86
+
+/**
+ * @brief Returns the fastest version of SkipRun() that is supported by the processor.
+ */
+SkipRunFunction SelectSkipRun ()
+{
+#ifdef GENESIS_CHAR_SET_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &SkipRunAvx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return &SkipRunSsse3;
+    }
+#endif
+    return &SkipRunScalar;
+}
+
+} // namespace
+
+/**
+ * @brief Returns the first position in the text, starting at `pos`, whose char is not part of the
+ * set, or `len` if there is no such position.
+ */
+size_t CharSet::SkipRun (const char* text, size_t pos, const size_t len) const
+{
+    // selected on first use, so that this also works during static initialization.
+    static const SkipRunFunction skip_run = SelectSkipRun();
+    return skip_run(rows_, text, pos, len);
+}
+
+} // namespace genesis
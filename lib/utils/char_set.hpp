@@ -0,0 +1,84 @@
+#ifndef GENESIS_UTILS_CHAR_SET_H_
+#define GENESIS_UTILS_CHAR_SET_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup utils
+ */
+
+#include <stddef.h>
+#include <string>
+
+namespace genesis {
+
+// =============================================================================
+//     Char Set
+// =============================================================================
+
+/**
+ * @brief Set of ASCII chars, which allows to quickly skip runs of chars that belong to the set.
+ *
+ * This is used by the Lexer to scan long tokens (e.g., the sites of a sequence or the digits of a
+ * number) many chars at a time, see SkipRun(). On x86 processors with AVX2 or SSSE3, 32 or 16 chars
+ * are classified at once; which of them is used is determined once at runtime. On other processors,
+ * a portable version is used.
+ *
+ * Chars outside of the ASCII range (that is, negative chars) are never part of the set.
+ */
+class CharSet
+{
+public:
+
+    // -----------------------------------------------------
+    //     Constructor and Modification
+    // -----------------------------------------------------
+
+    CharSet ();
+    explicit CharSet (const std::string& chars);
+
+    /** @brief Adds a char to the set. Non-ASCII chars are ignored. */
+    inline void Add (const char c)
+    {
+        const unsigned char u = static_cast<unsigned char>(c);
+        if (u < 128) {
+            rows_[u & 0x0F] |= static_cast<unsigned char>(1 << (u >> 4));
+        }
+    }
+
+    void Add    (const std::string& chars);
+    void Remove (const char c);
+    void Clear  ();
+
+    // -----------------------------------------------------
+    //     Queries
+    // -----------------------------------------------------
+
+    /** @brief Returns whether a char is part of the set. */
+    inline bool Contains (const char c) const
+    {
+        const unsigned char u = static_cast<unsigned char>(c);
+        return u < 128 && (rows_[u & 0x0F] & (1 << (u >> 4)));
+    }
+
+    size_t SkipRun (const char* text, size_t pos, const size_t len) const;
+
+    // -----------------------------------------------------
+    //     Internal Members
+    // -----------------------------------------------------
+
+private:
+
+    /**
+     * @brief The set, stored as a 16x8 bit table: Bit `c >> 4` of row `c & 0x0F` is set iff the
+     * char `c` is part of the set.
+     *
+     * This layout allows to look up the rows for 16 or 32 chars at once using a byte shuffle.
+     */
+    unsigned char rows_[16];
+};
+
+} // namespace genesis
+
+#endif // include guard
@@ -0,0 +1,144 @@
+/**
+ * @brief Implementation of the Input Source class.
+ *
+ * @file
+ * @ingroup utils
+ */
+
+#include "utils/input_source.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#else
+#    include <fstream>
+#    include <iterator>
+#endif
+
+#include "utils/logging.hpp"
+
+namespace genesis {
+
+// =============================================================================
+//     Constructor and Input
+// =============================================================================
+
+InputSource::InputSource () :
+    data_(""),
+    size_(0),
+    map_(nullptr)
+{}
+
+/**
+ * @brief Destructor, which unmaps or frees the contents of the source.
+ */
+InputSource::~InputSource ()
+{
+    Close();
+}
+
+/**
+ * @brief Opens a file as the source. Returns true iff successful.
+ *
+ * Regular files are mapped into memory if possible. Otherwise, the file is read into a buffer
+ * using `read()`. If the file cannot be read, a warning is issued and false is returned.
+ */
+bool InputSource::OpenFile (const std::string& fn)
+{
+    Close();
+
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = open(fn.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_WARN << "Cannot read from file '" << fn << "'.";
+        return false;
+    }
+
+    // empty files cannot be mapped, and other types of files (e.g., pipes) have no known size.
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        const size_t size = static_cast<size_t>(st.st_size);
+        void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, size, MADV_SEQUENTIAL);
+            close(fd);
+
+            map_  = map;
+            data_ = static_cast<const char*>(map);
+            size_ = size;
+            return true;
+        }
+    }
+
+    // if mapping did not work, read the file in blocks until its end.
+    const size_t block_size = 1 << 16;
+    size_t       pos        = 0;
+    while (true) {
+        buffer_.resize(pos + block_size);
+        const ssize_t len = read(fd, &buffer_[pos], block_size);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len < 0) {
+            LOG_WARN << "Cannot read from file '" << fn << "'.";
+            close(fd);
+            Close();
+            return false;
+        }
+        if (len == 0) {
+            break;
+        }
+        pos += static_cast<size_t>(len);
+    }
+    close(fd);
+    buffer_.resize(pos);
+
+#else
+    std::ifstream infile(fn, std::ios::binary);
+    if (!infile.good()) {
+        LOG_WARN << "Cannot read from file '" << fn << "'.";
+        return false;
+    }
+    buffer_.assign(
+        (std::istreambuf_iterator<char>(infile)),
+        std::istreambuf_iterator<char>()
+    );
+#endif
+
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+}
+
+/**
+ * @brief Uses a string as the source, without copying it.
+ *
+ * The string has to stay alive and unchanged for as long as the source is used.
+ */
+void InputSource::OpenString (const std::string& str)
+{
+    Close();
+    data_ = str.data();
+    size_ = str.size();
+}
+
+/**
+ * @brief Unmaps or frees the contents of the source, so that it is empty.
+ */
+void InputSource::Close ()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (map_ != nullptr) {
+        munmap(map_, size_);
+    }
+#endif
+    map_  = nullptr;
+    data_ = "";
+    size_ = 0;
+    std::string().swap(buffer_);
+}
+
+} // namespace genesis
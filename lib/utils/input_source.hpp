@@ -0,0 +1,102 @@
+#ifndef GENESIS_UTILS_INPUT_SOURCE_H_
+#define GENESIS_UTILS_INPUT_SOURCE_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup utils
+ */
+
+#include <stddef.h>
+#include <string>
+
+namespace genesis {
+
+// =============================================================================
+//     Input Source
+// =============================================================================
+
+/**
+ * @brief Provides the contents of a file or a string as one contiguous buffer of chars, without
+ * copying them if possible.
+ *
+ * On systems that support it, a regular file is mapped into memory, with a hint to the operating
+ * system that it is going to be read sequentially. Thus, opening a file does not copy its
+ * contents, and the pages of the file are only read when accessed. If mapping is not possible
+ * (e.g., for pipes, or on other systems), the file is read into a buffer instead.
+ *
+ * A string is used as it is, so it has to outlive the InputSource.
+ *
+ * The buffer is read-only and not null-terminated. It is valid until the source is closed or
+ * destroyed. This class is used by the Lexer, so that the parsers of the file formats can work
+ * directly on the mapped file, see Lexer::ProcessSource().
+ */
+class InputSource
+{
+public:
+
+    // -----------------------------------------------------
+    //     Constructor and Input
+    // -----------------------------------------------------
+
+    InputSource ();
+    ~InputSource ();
+
+    InputSource (const InputSource&) = delete;
+    InputSource& operator = (const InputSource&) = delete;
+
+    bool OpenFile   (const std::string& fn);
+    void OpenString (const std::string& str);
+    void Close ();
+
+    /**
+     * @brief A temporary string would be destroyed before the buffer is used, so this is not
+     * allowed. See OpenString().
+     */
+    void OpenString (std::string&& str) = delete;
+
+    // -----------------------------------------------------
+    //     Accessors
+    // -----------------------------------------------------
+
+    /** @brief Returns a pointer to the chars of the source. The chars are not null-terminated. */
+    inline const char* data() const
+    {
+        return data_;
+    }
+
+    /** @brief Returns the number of chars of the source. */
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+    /** @brief Returns whether the source contains no chars. */
+    inline bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    /** @brief Returns whether the source is a file that is mapped into memory. */
+    inline bool IsMapped() const
+    {
+        return map_ != nullptr;
+    }
+
+    // -----------------------------------------------------
+    //     Internal Members
+    // -----------------------------------------------------
+
+protected:
+
+    const char* data_;
+    size_t      size_;
+
+    void*       map_;
+    std::string buffer_;
+};
+
+} // namespace genesis
+
+#endif // include guard
@@ -0,0 +1,258 @@
+/**
+ * @brief Implementation of the Input Stream class.
+ *
+ * @file
+ * @ingroup utils
+ */
+
+#include "utils/input_stream.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#ifdef ZLIB
+#    include <zlib.h>
+#endif
+
+#include "utils/logging.hpp"
+
+namespace genesis {
+
+const size_t InputStream::kBufferSize;
+
+// =============================================================================
+//     Helper Functions
+// =============================================================================
+
+namespace {
+
+/**
+ * @brief Returns whether a file is a regular file, that is, not a pipe or device.
+ *
+ * On systems where this cannot be checked, all files are assumed to be regular.
+ */
+bool IsRegularFile (const std::string& fn)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat st;
+    return stat(fn.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+#else
+    (void) fn;
+    return true;
+#endif
+}
+
+/**
+ * @brief Returns whether a regular file starts with the magic bytes of gzip.
+ *
+ * Other files are not checked, as reading from a pipe would remove its content.
+ */
+bool IsGzipFile (const std::string& fn)
+{
+    if (!IsRegularFile(fn)) {
+        return false;
+    }
+    FILE* file = fopen(fn.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    unsigned char magic[2];
+    const bool gzip = fread(magic, 1, 2, file) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+    fclose(file);
+    return gzip;
+}
+
+} // namespace
+
+// =============================================================================
+//     Constructor and Source
+// =============================================================================
+
+InputStream::InputStream () :
+    failed_(false),
+    file_(nullptr),
+    owns_file_(false),
+    string_(nullptr),
+    string_pos_(0),
+    string_len_(0),
+    gzfile_(nullptr)
+{}
+
+/**
+ * @brief Destructor, which closes the source.
+ */
+InputStream::~InputStream ()
+{
+    Close();
+}
+
+/**
+ * @brief Opens a file as the source of the stream. Returns true iff successful.
+ *
+ * If genesis is compiled with `ZLIB`, gzip compressed files are decompressed while reading.
+ * Otherwise, a warning is issued for them and false is returned.
+ */
+bool InputStream::OpenFile (const std::string& fn)
+{
+    Close();
+    failed_ = false;
+
+#ifdef ZLIB
+    gzfile_ = gzopen(fn.c_str(), "rb");
+    if (gzfile_ == nullptr) {
+        LOG_WARN << "Cannot read from file '" << fn << "'.";
+        return false;
+    }
+    gzbuffer(gzfile_, kBufferSize);
+    return true;
+#else
+    if (IsGzipFile(fn)) {
+        LOG_WARN << "Cannot read compressed file '" << fn << "', "
+                 << "as genesis was compiled without zlib support.";
+        return false;
+    }
+    file_ = fopen(fn.c_str(), "rb");
+    if (file_ == nullptr) {
+        LOG_WARN << "Cannot read from file '" << fn << "'.";
+        return false;
+    }
+    owns_file_ = true;
+    return true;
+#endif
+}
+
+/**
+ * @brief Uses the standard input as the source of the stream. Returns true iff successful.
+ *
+ * If genesis is compiled with `ZLIB`, gzip compressed input is decompressed while reading. The
+ * standard input itself is not closed by Close().
+ */
+bool InputStream::OpenStdin ()
+{
+    Close();
+    failed_ = false;
+
+#if defined(ZLIB) && (defined(__unix__) || defined(__APPLE__))
+    // zlib closes the file descriptor it reads from, so it gets its own copy of it.
+    const int fd = dup(fileno(stdin));
+    gzfile_ = fd < 0 ? nullptr : gzdopen(fd, "rb");
+    if (gzfile_ == nullptr) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        LOG_WARN << "Cannot read from standard input.";
+        return false;
+    }
+    gzbuffer(gzfile_, kBufferSize);
+#else
+    file_      = stdin;
+    owns_file_ = false;
+#endif
+    return true;
+}
+
+/**
+ * @brief Uses a string as the source of the stream, without copying it.
+ *
+ * The string has to stay alive and unchanged for as long as the stream is read.
+ */
+void InputStream::OpenString (const std::string& str)
+{
+    Close();
+    failed_     = false;
+    string_     = str.data();
+    string_pos_ = 0;
+    string_len_ = str.size();
+}
+
+/**
+ * @brief Closes the source of the stream.
+ */
+void InputStream::Close ()
+{
+    if (file_ != nullptr && owns_file_) {
+        fclose(file_);
+    }
+    file_      = nullptr;
+    owns_file_ = false;
+
+#ifdef ZLIB
+    if (gzfile_ != nullptr) {
+        gzclose(gzfile_);
+        gzfile_ = nullptr;
+    }
+#endif
+
+    string_     = nullptr;
+    string_pos_ = 0;
+    string_len_ = 0;
+}
+
+/**
+ * @brief Returns whether a file is better read using an InputStream than by mapping it into
+ * memory using an InputSource.
+ *
+ * This is the case for gzip compressed files, and for files that are not regular files, e.g.,
+ * named pipes or `/dev/stdin`, whose size is not known in advance.
+ */
+bool InputStream::IsStreamFile (const std::string& fn)
+{
+    return !IsRegularFile(fn) || IsGzipFile(fn);
+}
+
+// =============================================================================
+//     Reading
+// =============================================================================
+
+/**
+ * @brief Reads up to `len` chars from the source into a buffer and returns how many were read.
+ *
+ * Fewer chars than requested are only returned at the end of the input. Thus, a return value of 0
+ * means that the whole input has been read, or that an error occured, see good().
+ */
+size_t InputStream::Read (char* buffer, size_t len)
+{
+    if (failed_) {
+        return 0;
+    }
+
+    size_t got = 0;
+    if (string_ != nullptr) {
+        got = std::min(len, string_len_ - string_pos_);
+        memcpy(buffer, string_ + string_pos_, got);
+        string_pos_ += got;
+    } else if (file_ != nullptr) {
+        got     = fread(buffer, 1, len, file_);
+        failed_ = got < len && ferror(file_);
+#ifdef ZLIB
+    } else if (gzfile_ != nullptr) {
+        // zlib reads at most an unsigned int at a time, so larger requests are read in parts.
+        while (got < len) {
+            const unsigned part = static_cast<unsigned>(std::min(len - got, size_t(1) << 30));
+            const int      res  = gzread(gzfile_, buffer + got, part);
+            if (res <= 0) {
+                failed_ = res < 0;
+                break;
+            }
+            got += static_cast<size_t>(res);
+        }
+#endif
+    } else {
+        LOG_WARN << "Input stream has no source.";
+        failed_ = true;
+        return 0;
+    }
+
+    if (failed_) {
+        LOG_WARN << "Error while reading from input file.";
+        return 0;
+    }
+    return got;
+}
+
+} // namespace genesis
@@ -0,0 +1,107 @@
+#ifndef GENESIS_UTILS_INPUT_STREAM_H_
+#define GENESIS_UTILS_INPUT_STREAM_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup utils
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+
+// Forward declaration of the zlib file handle, so that zlib.h is not needed here.
+struct gzFile_s;
+
+namespace genesis {
+
+// =============================================================================
+//     Input Stream
+// =============================================================================
+
+/**
+ * @brief Source for reading large inputs from a file, the standard input or a string piece by
+ * piece.
+ *
+ * This is the counterpart of OutputStream. The content is read in chunks using Read(), so that
+ * inputs whose size is not known in advance (pipes, the standard input, compressed files) can be
+ * processed without holding them in memory at once. See Lexer::ProcessStream() for the main use.
+ *
+ * If compiled with `ZLIB`, gzip compressed files and standard input are decompressed while
+ * reading. Uncompressed input is read as it is in that case, too.
+ *
+ * Errors while reading are reported via LOG_WARN once. After that, Read() returns no more content,
+ * and good() returns false.
+ */
+class InputStream
+{
+public:
+
+    // -----------------------------------------------------
+    //     Constructor and Source
+    // -----------------------------------------------------
+
+    InputStream ();
+    ~InputStream ();
+
+    InputStream (const InputStream&) = delete;
+    InputStream& operator = (const InputStream&) = delete;
+
+    bool OpenFile   (const std::string& fn);
+    bool OpenStdin  ();
+    void OpenString (const std::string& str);
+    void Close ();
+
+    /**
+     * @brief A temporary string would be destroyed before it is read, so this is not allowed.
+     * See OpenString().
+     */
+    void OpenString (std::string&& str) = delete;
+
+    /** @brief Returns whether the stream has a source and no error occured so far. */
+    inline bool good() const
+    {
+        return (file_ != nullptr || string_ != nullptr || IsCompressed()) && !failed_;
+    }
+
+    static bool IsStreamFile (const std::string& fn);
+
+    // -----------------------------------------------------
+    //     Reading
+    // -----------------------------------------------------
+
+    size_t Read (char* buffer, size_t len);
+
+    // -----------------------------------------------------
+    //     Internal Members
+    // -----------------------------------------------------
+
+protected:
+
+    inline bool IsCompressed() const
+    {
+        return gzfile_ != nullptr;
+    }
+
+    /** @brief Size of the internal buffer of zlib for reading compressed input. */
+    static const size_t kBufferSize = 1 << 17;
+
+    bool              failed_;
+
+    FILE*             file_;
+    bool              owns_file_;
+
+    const char*       string_;
+    size_t            string_pos_;
+    size_t            string_len_;
+
+    // only used if compiled with ZLIB, but always declared, so that the layout of this class
+    // does not depend on how the code using it is compiled.
+    gzFile_s*         gzfile_;
+};
+
+} // namespace genesis
+
+#endif // include guard
@@ -22,6 +22,9 @@ namespace genesis {
 /**
  * @brief Takes a JSON document file path and parses its contents into a JsonDocument.
  *
+ * The file is mapped into memory if possible, see InputSource. Compressed files and pipes are
+ * read as a stream instead, see InputStream.
+ *
  * Returns true iff successfull.
  */
 bool JsonProcessor::FromFile (const std::string& fn, JsonDocument& document)
@@ -30,7 +33,20 @@ bool JsonProcessor::FromFile (const std::string& fn, JsonDocument& document)
         LOG_WARN << "JSON file '" << fn << "' does not exist.";
         return false;
     }
-    return FromString(FileRead(fn), document);
+
+    if (InputStream::IsStreamFile(fn)) {
+        InputStream stream;
+        if (!stream.OpenFile(fn)) {
+            return false;
+        }
+        return FromStream(stream, document);
+    }
+
+    InputSource source;
+    if (!source.OpenFile(fn)) {
+        return false;
+    }
+    return FromSource(source, document);
 }
 
 /**
@@ -39,11 +55,49 @@ bool JsonProcessor::FromFile (const std::string& fn, JsonDocument& document)
  * Returns true iff successfull.
  */
 bool JsonProcessor::FromString (const std::string& json, JsonDocument& document)
+{
+    InputSource source;
+    source.OpenString(json);
+    return FromSource(source, document);
+}
+
+/**
+ * @brief Takes an InputSource containing a JSON document and parses its contents into a
+ * JsonDocument.
+ *
+ * Returns true iff successfull.
+ */
+bool JsonProcessor::FromSource (const InputSource& source, JsonDocument& document)
+{
+    // do stepwise lexing
+    JsonLexer lexer;
+    lexer.ProcessSource(source, true);
+    return FromLexer(lexer, document);
+}
+
+/**
+ * @brief Takes an InputStream containing a JSON document and parses its contents into a
+ * JsonDocument.
+ *
+ * The stream is read in chunks while parsing, see Lexer::ProcessStream().
+ *
+ * Returns true iff successfull.
+ */
+bool JsonProcessor::FromStream (InputStream& stream, JsonDocument& document)
 {
     // do stepwise lexing
     JsonLexer lexer;
-    lexer.ProcessString(json, true);
+    lexer.ProcessStream(stream, true);
+    return FromLexer(lexer, document);
+}
 
+/**
+ * @brief Parses the tokens of a JsonLexer that was started in stepwise mode into a JsonDocument.
+ *
+ * Returns true iff successfull.
+ */
+bool JsonProcessor::FromLexer (JsonLexer& lexer, JsonDocument& document)
+{
     if (lexer.empty()) {
         LOG_INFO << "JSON document is empty.";
         return false;
@@ -53,7 +107,7 @@ bool JsonProcessor::FromString (const std::string& json, JsonDocument& document)
                  << " with message: " << lexer.back().value();
         return false;
     }
-    if (!lexer.cbegin()->IsBracket("{")) {
+    if (!lexer.cbegin()->IsBracket('{')) {
         LOG_WARN << "JSON document does not start with JSON object opener '{'.";
         return false;
     }
@@ -93,6 +147,10 @@ bool JsonProcessor::FromString (const std::string& json, JsonDocument& document)
  * ParseObject(), because it takes its value parameter by reference. This is because when
  * entering the function it is not clear yet which type of value the current lexer token is, so a
  * new instance has to be created and stored in the pointer.
+ *
+ * This function is public, so that it can also be used for partial parsing by other processors
+ * that read the lexer tokens themselves, see for example JplaceProcessor. In that case, the caller
+ * owns the created value and has to delete it, also if the parsing fails.
  */
 bool JsonProcessor::ParseValue (
     Lexer::iterator& ct,
@@ -107,16 +165,16 @@ bool JsonProcessor::ParseValue (
     // check all possible valid lexer token types and turn them into json values
     if (ct->IsSymbol()) {
         // the lexer only returns null, true or false as symbols, so this is safe
-        if (ct->value().compare("null") == 0) {
+        if (ct->ValueEquals("null")) {
             value = new JsonValueNull();
         } else {
-            value = new JsonValueBool(ct->value());
+            value = new JsonValueBool(ct->ValueEquals("true"));
         }
         ++ct;
         return true;
     }
     if (ct->IsNumber()) {
-        value = new JsonValueNumber(ct->value());
+        value = new JsonValueNumber(ct->ToDouble());
         ++ct;
         return true;
     }
@@ -125,11 +183,11 @@ bool JsonProcessor::ParseValue (
         ++ct;
         return true;
     }
-    if (ct->IsBracket("[")) {
+    if (ct->IsBracket('[')) {
         value = new JsonValueArray();
         return ParseArray (ct, end, JsonValueToArray(value));
     }
-    if (ct->IsBracket("{")) {
+    if (ct->IsBracket('{')) {
         value = new JsonValueObject();
         return ParseObject (ct, end, JsonValueToObject(value));
     }
@@ -155,7 +213,7 @@ bool JsonProcessor::ParseArray (
     // for this here.
     assert(value);
 
-    if (ct == end || !ct->IsBracket("[")) {
+    if (ct == end || !ct->IsBracket('[')) {
         LOG_WARN << "JSON array does not start with '[' at " << ct->at() << ".";
         return false;
     }
@@ -170,12 +228,12 @@ bool JsonProcessor::ParseArray (
         value->Add(element);
 
         // check for end of array, leave if found
-        if (ct == end || ct->IsBracket("]")) {
+        if (ct == end || ct->IsBracket(']')) {
             break;
         }
 
         // check for delimiter comma (indicates that there are more elements following)
-        if (!ct->IsOperator(",")) {
+        if (!ct->IsOperator(',')) {
             LOG_WARN << "JSON array does not contain comma between elements at " << ct->at() << ".";
             return false;
         }
@@ -209,7 +267,7 @@ bool JsonProcessor::ParseObject (
     // for this here.
     assert(value);
 
-    if (ct == end || !ct->IsBracket("{")) {
+    if (ct == end || !ct->IsBracket('{')) {
         LOG_WARN << "JSON object does not start with '{' at " << ct->at() << ".";
         return false;
     }
@@ -228,7 +286,7 @@ bool JsonProcessor::ParseObject (
         if (ct == end) {
             break;
         }
-        if (!ct->IsOperator(":")) {
+        if (!ct->IsOperator(':')) {
             LOG_WARN << "JSON object member does not contain colon between name and value at "
                      << ct->at() << ".";
             return false;
@@ -246,12 +304,12 @@ bool JsonProcessor::ParseObject (
         value->Set(name, member);
 
         // check for end of object, leave if found (either way)
-        if (ct == end || ct->IsBracket("}")) {
+        if (ct == end || ct->IsBracket('}')) {
             break;
         }
 
         // check for delimiter comma (indicates that there are more members following)
-        if (!ct->IsOperator(",")) {
+        if (!ct->IsOperator(',')) {
             LOG_WARN << "JSON object does not contain comma between members at " << ct->at() << ".";
             return false;
         }
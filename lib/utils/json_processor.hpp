@@ -65,16 +65,15 @@ protected:
     inline bool ScanSymbol()
     {
         size_t start = GetPosition();
-        while (!IsEnd() && GetCharType() == LexerTokenType::kSymbol) {
-            NextChar();
-        }
+        SkipCharType(LexerTokenType::kSymbol);
 
+        // the valid symbols are short enough to not need an allocation for this comparison.
         std::string res = GetSubstr(start, GetPosition());
         if (res.compare("null") && res.compare("true") && res.compare("false")) {
             PushToken(LexerTokenType::kError, start, "Invalid symbols: \"" + res + "\"");
             return false;
         }
-        PushToken(LexerTokenType::kSymbol, start, res);
+        PushToken(LexerTokenType::kSymbol, start, GetPosition());
         return true;
     }
 };
@@ -108,12 +107,10 @@ class JsonProcessor
     // ---------------------------------------------------------------------
 
 public:
-    static bool FromFile   (const std::string& fn,    JsonDocument& document);
-    static bool FromString (const std::string& json,  JsonDocument& document);
-
-    // TODO add something like ProcessPartialString that takes any json value and not just a whole doc
-
-protected:
+    static bool FromFile   (const std::string& fn,     JsonDocument& document);
+    static bool FromString (const std::string& json,   JsonDocument& document);
+    static bool FromSource (const InputSource& source, JsonDocument& document);
+    static bool FromStream (InputStream&       stream, JsonDocument& document);
 
     static bool ParseValue (
         Lexer::iterator& ct,
@@ -121,6 +118,10 @@ protected:
         JsonValue*&            value
     );
 
+protected:
+
+    static bool FromLexer  (JsonLexer& lexer, JsonDocument& document);
+
     static bool ParseArray (
         Lexer::iterator& ct,
         Lexer::iterator& end,
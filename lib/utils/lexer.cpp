@@ -7,6 +7,7 @@
 
 #include "utils/lexer.hpp"
 
+#include <algorithm>
 #include <assert.h>
 #include <cstring>
 #include <stack>
@@ -17,31 +18,102 @@
 
 namespace genesis {
 
+const size_t Lexer::kStreamChunkSize;
+const size_t Lexer::kStreamLookahead;
+
+// =============================================================================
+//     Constructor
+// =============================================================================
+
+/**
+ * @brief Constructor that initializes the char sets used for scanning.
+ */
+Lexer::Lexer() : digit_chars_("0123456789")
+{
+    UpdateCharTypeSets();
+}
+
+/**
+ * @brief Builds the sets of chars of each LexerTokenType from the start_char_table_.
+ *
+ * This is called by SetCharType(), so that the sets are always consistent with the table.
+ */
+void Lexer::UpdateCharTypeSets()
+{
+    for (CharSet& set : char_type_sets_) {
+        set.Clear();
+    }
+    for (size_t c = 0; c < 128; ++c) {
+        char_type_sets_[static_cast<size_t>(start_char_table_[c])].Add(static_cast<char>(c));
+    }
+}
+
 // =============================================================================
 //     Process
 // =============================================================================
 
 /**
- * @brief Shortcut function that reads the contents of a file and then calls ProcessString().
+ * @brief Shortcut function that opens a file and then calls ProcessSource() or ProcessStream().
  *
- * If the file does not exist, a warning is triggered and false returned. Otherwise, the result
- * of ProcessString() is returned.
+ * The file is mapped into memory if possible, see InputSource. Compressed files and pipes are
+ * read as a stream instead, see InputStream::IsStreamFile(). The file is kept open by the Lexer,
+ * so that its tokens stay valid. If the file does not exist or cannot be read, a warning is
+ * triggered and false returned. Otherwise, the result of the processing is returned.
  */
-bool Lexer::ProcessFile(const std::string& fn)
+bool Lexer::ProcessFile(const std::string& fn, bool stepwise)
 {
     if (!FileExists(fn)) {
         LOG_WARN << "File '" << fn << "' does not exist.";
         return false;
     }
-    return ProcessString(FileRead(fn));
+
+    file_source_.Close();
+    file_stream_.Close();
+    if (InputStream::IsStreamFile(fn)) {
+        if (!file_stream_.OpenFile(fn)) {
+            return false;
+        }
+        return ProcessStream(file_stream_, stepwise);
+    }
+
+    if (!file_source_.OpenFile(fn)) {
+        return false;
+    }
+    return ProcessSource(file_source_, stepwise);
 }
 
 /**
  * @brief Process a string and store the resulting tokens in this Lexer object.
  *
+ * This is a shortcut for calling ProcessText() with the chars of the string. See there for
+ * details.
+ *
+ * The string is not copied. Most tokens are views into it (see LexerToken), so it needs to stay
+ * alive and unchanged for as long as the tokens are used.
+ */
+bool Lexer::ProcessString(const std::string& text, bool stepwise)
+{
+    return ProcessText(text.data(), text.size(), stepwise);
+}
+
+/**
+ * @brief Process the contents of an InputSource and store the resulting tokens in this Lexer
+ * object.
+ *
+ * This is a shortcut for calling ProcessText() with the chars of the source. See there for
+ * details. The source needs to stay open for as long as the tokens are used.
+ */
+bool Lexer::ProcessSource(const InputSource& source, bool stepwise)
+{
+    return ProcessText(source.data(), source.size(), stepwise);
+}
+
+/**
+ * @brief Process a text of `len` chars and store the resulting tokens in this Lexer object.
+ *
  * This function clears the token list stored for this object and fills it
- * with the results of processing the given string. This process analyzes and
- * splits the string into different tokens. For the types of tokens being
+ * with the results of processing the given text. This process analyzes and
+ * splits the text into different tokens. For the types of tokens being
  * extracted, see LexerToken; for accessing the results, see Lexer.
  *
  * Returns true iff successful. In case an error is encountered while analyzing
@@ -51,8 +123,9 @@ bool Lexer::ProcessFile(const std::string& fn)
  *
  * Common usage:
  *
+ *     std::string text = "tree(some:0.5,items:0.3);";
  *     Lexer l;
- *     l.ProcessString("tree(some:0.5,items:0.3);")
+ *     l.ProcessString(text);
  *     if (l.empty()) {
  *         LOG_WARN << "Lexer is empty.";
  *     }
@@ -64,16 +137,60 @@ bool Lexer::ProcessFile(const std::string& fn)
  *     }
  *     ... process the tokens ...
  *
- * The additional option `stepwise` will not scan the entire string, but only the
+ * The additional option `stepwise` will not scan the entire text, but only the
  * first element of it. In order to get more tokens manually, ProcessStep() has to be called until
  * it returns false. However, this option is usually used in combination with a producing
  * LexerIterator, that will automatically call ProcessStep() whenever tokens are needed.
- * See JsonProcessor::FromString() for an example.
+ * See JsonProcessor::FromSource() for an example.
+ *
+ * The text is not copied and does not need to be null-terminated. Most tokens are views into it
+ * (see LexerToken), so it needs to stay alive and unchanged for as long as the tokens are used.
  */
-bool Lexer::ProcessString(const std::string& text, bool stepwise)
+bool Lexer::ProcessText(const char* text, size_t len, bool stepwise)
+{
+    Init(text, len);
+    return StartProcessing(stepwise);
+}
+
+/**
+ * @brief Process the contents of an InputStream and store the resulting tokens in this Lexer
+ * object.
+ *
+ * This works like ProcessText(), but the text is read from the stream in chunks while lexing.
+ * Tokens that span the border between two chunks are handled by repeating the step that produced
+ * them once more of the stream has been read, see ProcessStep().
+ *
+ * The tokens are views into a buffer of the Lexer. When reading more of the stream, the text of
+ * tokens that were removed from the Lexer is discarded from the buffer. Thus, in stepwise mode
+ * with a LexerIterator that consumes the tokens (see LexerIterator::ConsumeWithTail()), the memory
+ * needed is bounded by the chunk size and the longest token, independently of the size of the
+ * input. Otherwise, the buffer grows to hold the text of all tokens. In both cases, the tokens
+ * that are stored in the Lexer stay valid, but copies of them (e.g., obtained from operator[]())
+ * are only valid until the next step.
+ *
+ * The stream needs to stay open while lexing.
+ */
+bool Lexer::ProcessStream(InputStream& stream, bool stepwise)
 {
-    Init(text);
+    stream_buffer_.clear();
+    Init(stream_buffer_.data(), 0);
+    stream_      = &stream;
+    stream_done_ = false;
+
+    ReadStream();
+    if (stream_done_ && !stream_->good()) {
+        PushToken(LexerTokenType::kError, 0, "Cannot read from input.");
+        return false;
+    }
+    return StartProcessing(stepwise);
+}
 
+/**
+ * @brief Starts the lexing of the text after it was set by Init(), either by processing all of
+ * it, or only its first step. See ProcessText() for details.
+ */
+bool Lexer::StartProcessing(bool stepwise)
+{
     // if we want stepwise lexing, just do the first step.
     if (stepwise) {
         return ProcessStep();
@@ -92,7 +209,97 @@ bool Lexer::ProcessString(const std::string& text, bool stepwise)
 /**
  * @brief Processes one step of the lexing.
  *
- * This might produce more than one token, as comments and whitespaces are treaded specially.
+ * This might produce more than one token, as comments and whitespaces are treaded specially. See
+ * ScanStep() for how the steps work.
+ *
+ * When processing a stream (see ProcessStream()), the buffered text might end in the middle of a
+ * token. Thus, a step that ends close to the end of the buffer is undone, and repeated after
+ * reading more of the stream. This is the case in particular for a step that reached the end of
+ * the buffer, as well as for one that stopped because of a char that it looked ahead to.
+ */
+bool Lexer::ProcessStep()
+{
+    if (stream_ == nullptr) {
+        return ScanStep();
+    }
+
+    while (true) {
+        const size_t itr  = itr_;
+        const int    line = line_;
+        const int    col  = col_;
+        const size_t size = tokens_.size();
+
+        const bool result = ScanStep();
+        if (stream_done_ || itr_ + kStreamLookahead < len_) {
+            return result;
+        }
+
+        // undo the step, and try again with more text.
+        itr_  = itr;
+        line_ = line;
+        col_  = col;
+        while (tokens_.size() > size) {
+            tokens_.pop_back();
+        }
+
+        ReadStream();
+        if (stream_done_ && !stream_->good()) {
+            PushToken(LexerTokenType::kError, GetPosition(), "Cannot read from input.");
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Reads the next chunk of the stream into the buffer.
+ *
+ * First, the text that is not needed any more is discarded: It is the text before the current
+ * position and before the first token that is still a view into the buffer, except for one char
+ * that the scanners might look back to. Then, the next chunk is appended, and the tokens are moved
+ * along with the text.
+ *
+ * If a large part of the buffer is still needed (this happens if the tokens are not consumed),
+ * more than one chunk is read, so that the buffer grows geometrically.
+ */
+void Lexer::ReadStream()
+{
+    assert(stream_ != nullptr && !stream_done_);
+
+    size_t keep = itr_;
+    for (const LexerToken& t : tokens_) {
+        if (t.data_ != nullptr) {
+            keep = std::min(keep, static_cast<size_t>(t.data_ - text_));
+            break;
+        }
+    }
+    keep = keep > 0 ? keep - 1 : 0;
+
+    // copy the needed text into a new buffer, and fill the rest of it from the stream.
+    const size_t rest  = len_ - keep;
+    const size_t chunk = std::max(kStreamChunkSize, rest);
+    std::string  buffer;
+    buffer.reserve(rest + chunk);
+    buffer.append(text_ + keep, rest);
+    buffer.resize(rest + chunk);
+    const size_t got = stream_->Read(&buffer[rest], chunk);
+    buffer.resize(rest + got);
+    stream_done_ = got == 0;
+
+    // use the new buffer, and move the tokens to it.
+    const char* old_text = text_;
+    stream_buffer_.swap(buffer);
+    text_  = stream_buffer_.data();
+    len_   = stream_buffer_.size();
+    itr_  -= keep;
+    for (LexerToken& t : tokens_) {
+        if (t.data_ != nullptr) {
+            t.data_ = text_ + (t.data_ - old_text - keep);
+        }
+    }
+}
+
+/**
+ * @brief Scans the text for the next step of the lexing.
  *
  * As stated in the description of this Lexer class, the class is meant to be
  * derived for concrete types of lexers. Thus, here are some comments about the
@@ -128,7 +335,7 @@ bool Lexer::ProcessString(const std::string& text, bool stepwise)
  * correct scanner. In the new ProcessString function, first call Init to reset all
  * internal variables. Also see ScanUnknown for some important information.
  */
-bool Lexer::ProcessStep()
+bool Lexer::ScanStep()
 {
     if (IsEnd()) {
         return false;
@@ -236,8 +443,12 @@ bool Lexer::ProcessStep()
  */
 bool Lexer::ScanFromTo (const char* from, const char* to)
 {
+    // the text is not necessarily null-terminated, so make sure not to compare beyond its end.
+    const size_t from_len = strlen(from);
+    const size_t to_len   = strlen(to);
+
     // first check if the current position actually contains the "from" string
-    if (IsEnd() || strncmp(from, text_+itr_, strlen(from)) != 0) {
+    if (IsEnd() || itr_ + from_len > len_ || strncmp(from, text_+itr_, from_len) != 0) {
         return false;
     }
 
@@ -245,12 +456,12 @@ bool Lexer::ScanFromTo (const char* from, const char* to)
     // checking, because we do not want to change itr_ in case it is not a
     // match. also, calling NextChar here ensures integrity of the line
     // counting.
-    for (size_t i = 0; i < strlen(from); ++i) {
+    for (size_t i = 0; i < from_len; ++i) {
         NextChar();
     }
 
     // now try to find the "to" string
-    while (!IsEnd() && strncmp(to, text_+itr_, strlen(to)) != 0) {
+    while (!IsEnd() && (itr_ + to_len > len_ || strncmp(to, text_+itr_, to_len) != 0)) {
         NextChar();
     }
 
@@ -260,7 +471,7 @@ bool Lexer::ScanFromTo (const char* from, const char* to)
     }
 
     // "to" string was found. move as many chars forward.
-    for (size_t i = 0; i < strlen(to); ++i) {
+    for (size_t i = 0; i < to_len; ++i) {
         NextChar();
     }
     return true;
@@ -283,9 +494,7 @@ bool Lexer::ScanFromTo (const char* from, const char* to)
 inline bool Lexer::ScanUnknown()
 {
     size_t start = GetPosition();
-    while (!IsEnd() && GetCharType() == LexerTokenType::kUnknown) {
-        NextChar();
-    }
+    SkipCharType(LexerTokenType::kUnknown);
     PushToken(LexerTokenType::kUnknown, start, GetPosition());
     return true;
 }
@@ -308,13 +517,10 @@ inline bool Lexer::ScanUnknown()
  */
 inline bool Lexer::ScanWhitespace()
 {
-    bool   found = false;
     size_t start = GetPosition();
+    SkipCharType(LexerTokenType::kWhite);
 
-    while (!IsEnd() && GetCharType() == LexerTokenType::kWhite) {
-        NextChar();
-        found = true;
-    }
+    bool found = GetPosition() > start;
     if (include_whitespace && found) {
         PushToken(LexerTokenType::kWhite, start, GetPosition());
     }
@@ -347,9 +553,7 @@ inline bool Lexer::ScanComment()
 inline bool Lexer::ScanSymbol()
 {
     size_t start = GetPosition();
-    while (!IsEnd() && GetCharType() == LexerTokenType::kSymbol) {
-        NextChar();
-    }
+    SkipCharType(LexerTokenType::kSymbol);
     PushToken(LexerTokenType::kSymbol, start, GetPosition());
     return true;
 }
@@ -376,7 +580,9 @@ inline bool Lexer::ScanNumber()
     // scan
     while(!IsEnd()) {
         if(CharIsDigit(GetChar())) {
-            // nothing to do
+            // digits are always fine, so skip all of them at once
+            SkipChars(digit_chars_);
+            continue;
         } else if (GetChar() == '.') {
             // do not allow more than one dot, require a number after the dot
             // (if not, treat it as the end of the number, stop scanning)
@@ -465,8 +671,29 @@ inline bool Lexer::ScanString()
     bool found_e = false; // found an escape sequence
     bool found_q = false; // found a doubled qutation mark ""
 
+    // all chars except for the quotation mark, backslash and new lines need no special treatment
+    // within the string, so that they can be skipped at once.
+    if (string_chars_qmark_ != qmark) {
+        string_chars_.Clear();
+        for (size_t c = 0; c < 128; ++c) {
+            string_chars_.Add(static_cast<char>(c));
+        }
+        string_chars_.Remove(qmark);
+        string_chars_.Remove('\\');
+        string_chars_.Remove('\n');
+        string_chars_.Remove('\r');
+        string_chars_qmark_ = qmark;
+    }
+
     // scan
     while (!IsEnd()) {
+        size_t pos = GetPosition();
+        SkipChars(string_chars_);
+        if (GetPosition() > pos) {
+            jump = false;
+            continue;
+        }
+
         // if we find a backslash and use escape characters, we skip the
         // backslash and the following char. they will then be de-escaped after
         // the end of the string is reached.
@@ -507,6 +734,16 @@ inline bool Lexer::ScanString()
         return false;
     }
 
+    // if the string does not need to be changed, the token can simply be a view into the text.
+    if (!(found_e && use_string_escape) && !(found_q && use_string_doubled_quotes)) {
+        if (trim_quotation_marks) {
+            PushToken(LexerTokenType::kString, start-1, start, GetPosition()-1);
+        } else {
+            PushToken(LexerTokenType::kString, start-1, GetPosition());
+        }
+        return true;
+    }
+
     // de-escape the string (transform backslash-escaped chars)
     std::string res = GetSubstr(start, GetPosition()-1);
     if (found_e && use_string_escape) {
@@ -647,12 +884,12 @@ inline Lexer::iterator Lexer::end()
 bool Lexer::ValidateBrackets() const
 {
     std::stack<char> stk;
-    for (LexerToken t : tokens_) {
+    for (const LexerToken& t : tokens_) {
         if (!t.IsBracket()) {
             continue;
         }
 
-        char c = t.value()[0];
+        char c = *t.data();
         if (c == '(') stk.push(')');
         if (c == '[') stk.push(']');
         if (c == '{') stk.push('}');
@@ -676,7 +913,7 @@ std::string Lexer::Dump() const
 {
     std::string res;
     for (size_t i = 0; i < tokens_.size(); i++) {
-        LexerToken t = tokens_[i];
+        const LexerToken& t = tokens_[i];
         char out[30];
         sprintf(out, "[%03d] @%03d:%03d %10s : ",
             static_cast<unsigned int>(i),
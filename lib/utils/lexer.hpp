@@ -10,8 +10,13 @@
 
 #include <assert.h>
 #include <deque>
+#include <stdlib.h>
 #include <string>
+#include <string.h>
 
+#include "utils/char_set.hpp"
+#include "utils/input_source.hpp"
+#include "utils/input_stream.hpp"
 #include "utils/utils.hpp"
 
 namespace genesis {
@@ -114,6 +119,14 @@ inline std::string LexerTokenTypeToString (const LexerTokenType t)
  * stored as strings -- upstream analysis like parsers then have to convert it
  * to a proper type for further use (e.g. in case of numbers).
  *
+ * In order to avoid copying the text, most tokens do not store their value themselves, but are
+ * views into the text that is processed by the Lexer, given by a pointer and a length, see data()
+ * and size(). Only tokens whose value differs from the text (error messages, or strings that
+ * had escape sequences or doubled quotation marks) own a copy. Thus, the text needs to outlive the
+ * tokens, see Lexer::ProcessText(). The value is only turned into a `std::string` when calling
+ * value(). When lexing a stream, the Lexer moves the views of its tokens along with its buffer,
+ * see Lexer::ProcessStream().
+ *
  * If there is need for more types in the future, the enum, the default
  * implementation of Lexer::ProcessString() and some other places have to be adapted
  * accordingly.
@@ -129,14 +142,26 @@ public:
     // -------------------------------------------------------------------------
 
     /**
-     * @brief Constructor that sets the values for this token.
+     * @brief Constructor that sets the values for this token, as a view into the processed text.
+     */
+    inline LexerToken
+    (
+        const LexerTokenType t, const int    l,
+        const int            c, const char*  data, const size_t size
+    ) :
+        type_(t), line_(l), column_(c), data_(data), size_(size)
+    {};
+
+    /**
+     * @brief Constructor that sets the values for this token, with a value that is owned by the
+     * token itself.
      */
     inline LexerToken
     (
         const LexerTokenType t, const int         l,
         const int            c, const std::string& v
     ) :
-        type_(t), line_(l), column_(c), value_(v)
+        type_(t), line_(l), column_(c), data_(nullptr), size_(v.size()), owned_(v)
     {};
 
     /**
@@ -159,10 +184,49 @@ public:
         return column_;
     }
 
-    /** @brief Getter for the string value of this token. */
+    /**
+     * @brief Returns a pointer to the chars of the value of this token.
+     *
+     * The chars are not null-terminated, use size() to get their number.
+     */
+    inline const char* data() const
+    {
+        return data_ ? data_ : owned_.data();
+    }
+
+    /** @brief Returns the number of chars of the value of this token. */
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+    /**
+     * @brief Getter for the string value of this token.
+     *
+     * This creates a copy of the value. In the hot paths of parsers, prefer data() and size() or
+     * the shortcut functions below.
+     */
     inline std::string value() const
     {
-        return value_;
+        return std::string(data(), size_);
+    }
+
+    /**
+     * @brief Converts the value of this token to a floating point number.
+     *
+     * This is meant for tokens of type kNumber and does not allocate memory for typical numbers.
+     * If the value is not a valid number, 0.0 is returned.
+     */
+    inline double ToDouble() const
+    {
+        // the value is not null-terminated, so copy it to a local buffer for strtod.
+        char buf[64];
+        if (size_ < sizeof(buf)) {
+            memcpy(buf, data(), size_);
+            buf[size_] = '\0';
+            return strtod(buf, nullptr);
+        }
+        return strtod(value().c_str(), nullptr);
     }
 
     /** @brief Shortcut that returns "line:column" (e.g., for logging). */
@@ -202,10 +266,11 @@ public:
         }
 
         // count occurences of CR or LF, while not counting a CR+LF twice.
+        const char* val = data();
         size_t cnt = 0;
-        for (size_t i = 0; i < value_.size(); ++i) {
-            char c = value_[i];
-            if ((c == '\r') || (c == '\n' && i == 0) || (c == '\n' && value_[i-1] != '\r')) {
+        for (size_t i = 0; i < size_; ++i) {
+            char c = val[i];
+            if ((c == '\r') || (c == '\n' && i == 0) || (c == '\n' && val[i-1] != '\r')) {
                 ++cnt;
             }
         }
@@ -256,7 +321,17 @@ public:
      */
     inline bool IsBracket(const std::string& br) const
     {
-        return (type_ == LexerTokenType::kBracket) && (value_.compare(br) == 0);
+        return (type_ == LexerTokenType::kBracket) && ValueEquals(br);
+    }
+
+    /**
+     * @brief Returns whether this token is a given bracket char.
+     *
+     * Same as IsBracket(const std::string&), but without the need to compare strings.
+     */
+    inline bool IsBracket(const char br) const
+    {
+        return (type_ == LexerTokenType::kBracket) && size_ == 1 && *data() == br;
     }
 
     /**
@@ -279,7 +354,17 @@ public:
      */
     inline bool IsOperator(const std::string& op) const
     {
-        return (type_ == LexerTokenType::kOperator) && (value_.compare(op) == 0);
+        return (type_ == LexerTokenType::kOperator) && ValueEquals(op);
+    }
+
+    /**
+     * @brief Returns whether this token is a given operator char.
+     *
+     * Same as IsOperator(const std::string&), but without the need to compare strings.
+     */
+    inline bool IsOperator(const char op) const
+    {
+        return (type_ == LexerTokenType::kOperator) && size_ == 1 && *data() == op;
     }
 
     /** @brief Shortcut to check if this is a tag token. */
@@ -301,11 +386,24 @@ public:
         return LexerTokenTypeToString(type_);
     }
 
+    /** @brief Returns whether the value of this token equals the given string, without copying. */
+    inline bool ValueEquals(const std::string& str) const
+    {
+        return size_ == str.size() && memcmp(data(), str.data(), size_) == 0;
+    }
+
 private:
+    // the lexer moves the views when it reads more of a stream, see Lexer::ReadStream().
+    friend class Lexer;
+
     const LexerTokenType type_;
     const int line_;
     const int column_;
-    const std::string value_;
+
+    // either points into the processed text, or is null if the value is owned by the token.
+    const char*  data_;
+    const size_t size_;
+    const std::string owned_;
 };
 
 // =============================================================================
@@ -337,12 +435,23 @@ private:
 class Lexer
 {
 public:
-    virtual bool ProcessFile   (const std::string& fn);
-    virtual bool ProcessString (const std::string& text, bool stepwise =  false);
+    Lexer();
+
+    virtual bool ProcessFile   (const std::string& fn,       bool stepwise = false);
+    virtual bool ProcessString (const std::string& text,     bool stepwise = false);
+    virtual bool ProcessSource (const InputSource& source,   bool stepwise = false);
+    virtual bool ProcessText   (const char* text, size_t len, bool stepwise = false);
+    virtual bool ProcessStream (InputStream& stream,        bool stepwise = false);
     virtual bool ProcessStep   ();
     bool ValidateBrackets() const;
     std::string Dump() const;
 
+    /**
+     * @brief The tokens are views into the processed text, so a temporary text is not allowed,
+     * as it would be destroyed before the tokens are used. See ProcessString().
+     */
+    bool ProcessString (std::string&& text, bool stepwise = false) = delete;
+
     // -------------------------------------------------------------------------
     //     Accessors and Iterators
     // -------------------------------------------------------------------------
@@ -563,6 +672,10 @@ protected:
     //     Internal functions
     // -------------------------------------------------------------------------
 
+    bool StartProcessing (bool stepwise);
+    bool ScanStep ();
+    void ReadStream ();
+
     bool ScanFromTo (const char* from, const char* to);
     virtual bool ScanUnknown();
     virtual bool ScanWhitespace();
@@ -575,14 +688,15 @@ protected:
     virtual bool ScanTag();
 
     /** @brief Init the lexer by resetting state and assigning the text. */
-    inline void Init (const std::string& text)
+    inline void Init (const char* text, const size_t len)
     {
-        text_ = text.c_str();
+        text_ = text;
         itr_  = 0;
-        len_  = text.size();
+        len_  = len;
         line_ = 1;
         col_  = 0;
         tokens_.clear();
+        stream_ = nullptr;
     }
 
     /** @brief Returns the current iterator position while lexing. */
@@ -612,12 +726,13 @@ protected:
     /**
      * @brief Returns the char at the current iterator position.
      *
-     * Caveat: The function does no boundary check for speed reasons. Thus,
-     * it should be used in combination with IsEnd only.
+     * At the end of the text, a null char is returned. The text is not
+     * null-terminated (it might be a mapped file, see InputSource), so this
+     * is checked here instead of reading past the end.
      */
     inline char GetChar() const
     {
-        return text_[itr_];
+        return itr_ < len_ ? text_[itr_] : '\0';
     }
 
     /**
@@ -678,8 +793,11 @@ protected:
         for (char c : chars) {
             start_char_table_[static_cast<unsigned char>(c)] = type;
         }
+        UpdateCharTypeSets();
     }
 
+    void UpdateCharTypeSets();
+
     /**
      * @brief Moves the internal iterator to the next char.
      *
@@ -699,15 +817,59 @@ protected:
         ++itr_;
         ++col_;
 
-        // we use the save version of GetChar here, which is equivalant to
-        // check for IsEnd. first, CR, then LF. the second condition ensures
-        // not to count a CR+LF as two line increases.
-        if ((GetChar(0) == '\n' && GetChar(-1) != '\r') || (GetChar(0) == '\r')) {
+        // check for IsEnd first. then, CR or LF. the second condition ensures
+        // not to count a CR+LF as two line increases. as we just moved forward,
+        // there is always a previous char.
+        if (itr_ >= len_) {
+            return;
+        }
+        const char c = text_[itr_];
+        if ((c == '\n' && text_[itr_ - 1] != '\r') || (c == '\r')) {
             ++line_;
             col_ = 0;
         }
     }
 
+    /**
+     * @brief Moves the internal iterator forward as long as the current char is part of the given
+     * set.
+     *
+     * This is a faster version of calling NextChar() in a loop, as the set is scanned many chars
+     * at a time, see CharSet::SkipRun(). As the line counting is done for the last char only, the
+     * set must not contain new line chars.
+     */
+    inline void SkipChars(const CharSet& set)
+    {
+        assert(!set.Contains('\n') && !set.Contains('\r'));
+
+        const size_t end = set.SkipRun(text_, itr_, len_);
+        if (end > itr_) {
+            // there are no new lines within the run, so only the last move can start a new line.
+            col_ += static_cast<int>(end - 1 - itr_);
+            itr_  = end - 1;
+            NextChar();
+        }
+    }
+
+    /**
+     * @brief Moves the internal iterator forward as long as the current char is of the given
+     * LexerTokenType (see GetCharType()).
+     *
+     * If the type contains new line chars (usually, this is the case for kWhite), the chars are
+     * scanned one at a time. Otherwise, SkipChars() is used.
+     */
+    inline void SkipCharType(const LexerTokenType type)
+    {
+        const CharSet& set = char_type_sets_[static_cast<size_t>(type)];
+        if (set.Contains('\n') || set.Contains('\r')) {
+            while (!IsEnd() && GetCharType() == type) {
+                NextChar();
+            }
+        } else {
+            SkipChars(set);
+        }
+    }
+
     /**
      * @brief True if the internal iterator is at the end of the text.
      */
@@ -739,7 +901,10 @@ protected:
     }
 
     /**
-     * @brief Create a token and push it to the list.
+     * @brief Create a token that owns the given value and push it to the list.
+     *
+     * This is meant for values that are not part of the text, e.g., error messages. Otherwise, use
+     * the other overload, which does not copy the value.
      */
     inline void PushToken (const LexerTokenType t, const size_t start, const std::string& value)
     {
@@ -750,10 +915,29 @@ protected:
         tokens_.emplace_back(t, line_, col_ - (itr_ - start), value);
     }
 
-    /** @brief Create a token and push it to the list. */
+    /**
+     * @brief Create a token that is a view into the text between two positions, end excluded,
+     * and push it to the list.
+     */
     inline void PushToken (const LexerTokenType t, const size_t start, const size_t end)
     {
-        PushToken(t, start, GetSubstr(start, end));
+        PushToken(t, start, start, end);
+    }
+
+    /**
+     * @brief Create a token that starts at position `pos` in the text, but whose value is a view
+     * into the text between `start` and `end`, end excluded, and push it to the list.
+     *
+     * This is useful for tokens that do not include their delimiters, e.g. strings without their
+     * quotation marks, while still reporting the column of the first delimiter.
+     */
+    inline void PushToken (
+        const LexerTokenType t, const size_t pos, const size_t start, const size_t end
+    ) {
+        // see the other overload for the column calculation.
+        tokens_.emplace_back(
+            t, line_, col_ - (itr_ - pos), text_ + start, start < end ? end - start : 0
+        );
     }
 
 private:
@@ -808,6 +992,22 @@ private:
         /* |}~  */  LexerTokenType::kUnknown,   LexerTokenType::kUnknown,   LexerTokenType::kUnknown,   LexerTokenType::kError
     };
 
+    /**
+     * @brief The sets of ASCII chars of each LexerTokenType according to start_char_table_,
+     * indexed by the type. Used by SkipCharType().
+     */
+    CharSet char_type_sets_[static_cast<size_t>(LexerTokenType::kEOF) + 1];
+
+    /** @brief The set of digits, used for skipping them in ScanNumber(). */
+    CharSet digit_chars_;
+
+    /**
+     * @brief The set of chars within a string that need no special treatment, used in
+     * ScanString(). It depends on the quotation mark, which is stored along with it.
+     */
+    CharSet string_chars_;
+    char    string_chars_qmark_ = '\0';
+
     // Caveat: the following variables are heavily interweaved during a run
     // of ProcessString()! They have to stay consistent, otherwise the resulting
     // tokens will contain wrong information.
@@ -829,6 +1029,33 @@ private:
 
     /** @brief The list of tokens resulting from the analysis process. */
     std::deque<LexerToken> tokens_;
+
+    /** @brief Keeps the file opened by ProcessFile(), as the tokens are views into it. */
+    InputSource file_source_;
+
+    /** @brief Keeps the file opened by ProcessFile() if it is read as a stream. */
+    InputStream file_stream_;
+
+    /** @brief The stream being processed by ProcessStream(), or null if processing a text. */
+    InputStream* stream_ = nullptr;
+
+    /** @brief Whether the whole stream has been read into the buffer. */
+    bool stream_done_ = true;
+
+    /**
+     * @brief The part of the stream that is currently being processed. The text of the Lexer
+     * points to it while processing a stream.
+     */
+    std::string stream_buffer_;
+
+    /** @brief Number of chars that are read from a stream at a time. */
+    static const size_t kStreamChunkSize = 1 << 16;
+
+    /**
+     * @brief Number of chars before the end of the buffer at which a step is repeated after
+     * reading more of the stream. This needs to be more than the scanners look ahead.
+     */
+    static const size_t kStreamLookahead = 16;
 };
 
 /**
@@ -9,6 +9,9 @@
  */
 
 #include <sstream>
+#include <stddef.h>
+#include <utility>
+#include <vector>
 
 namespace genesis {
 
@@ -16,28 +19,74 @@ namespace genesis {
 //     Matrix
 // =============================================================================
 
+/**
+ * @brief Dense matrix, stored in row-major order.
+ *
+ * The matrix can be copied and moved, and thus be returned by value. In order to save memory,
+ * a matrix can be converted to a different `value_type`, e.g., from `Matrix<double>` to
+ * `Matrix<float>`.
+ */
 template <typename value_type>
 class Matrix
 {
 public:
-    Matrix (size_t rows, size_t cols) : rows_(rows), cols_(cols)
+
+    // -----------------------------------------------------
+    //     Constructor and Rule of Five
+    // -----------------------------------------------------
+
+    Matrix () : rows_(0), cols_(0) {}
+
+    Matrix (size_t rows, size_t cols) :
+        data_(rows * cols), rows_(rows), cols_(cols)
+    {}
+
+    Matrix (size_t rows, size_t cols, value_type init) :
+        data_(rows * cols, init), rows_(rows), cols_(cols)
+    {}
+
+    /**
+     * @brief Converting constructor that copies a matrix with a different `value_type`.
+     */
+    template <typename other_type>
+    explicit Matrix (const Matrix<other_type>& other) :
+        data_(other.size()), rows_(other.Rows()), cols_(other.Cols())
+    {
+        for (size_t i = 0; i < rows_; ++i) {
+            for (size_t j = 0; j < cols_; ++j) {
+                data_[i * cols_ + j] = static_cast<value_type>(other(i, j));
+            }
+        }
+    }
+
+    ~Matrix () = default;
+
+    Matrix (const Matrix&) = default;
+    Matrix (Matrix&& other) :
+        data_(std::move(other.data_)), rows_(other.rows_), cols_(other.cols_)
     {
-        data_ = new value_type [rows_ * cols_];
+        other.rows_ = 0;
+        other.cols_ = 0;
     }
 
-    Matrix (size_t rows, size_t cols, value_type init) : rows_(rows), cols_(cols)
+    Matrix& operator= (const Matrix&) = default;
+    Matrix& operator= (Matrix&& other)
     {
-        data_ = new value_type [rows_ * cols_];
-        for (size_t i = 0; i < rows_ * cols_; ++i) {
-            data_[i] = init;
-        }
+        swap(other);
+        return *this;
     }
 
-    ~Matrix ()
+    void swap (Matrix& other)
     {
-        delete [] data_;
+        std::swap(data_, other.data_);
+        std::swap(rows_, other.rows_);
+        std::swap(cols_, other.cols_);
     }
 
+    // -----------------------------------------------------
+    //     Accessors
+    // -----------------------------------------------------
+
     inline size_t Rows() const
     {
         return rows_;
@@ -53,6 +102,22 @@ public:
         return rows_ * cols_;
     }
 
+    /**
+     * @brief Returns a pointer to the underlying contiguous storage of the matrix.
+     */
+    inline value_type* data()
+    {
+        return data_.data();
+    }
+
+    /**
+     * @brief Returns a pointer to the underlying contiguous storage of the matrix.
+     */
+    inline const value_type* data() const
+    {
+        return data_.data();
+    }
+
     inline value_type& operator () (const size_t row, const size_t col)
     {
         return data_[row * cols_ + col];
@@ -63,7 +128,7 @@ public:
         return data_[row * cols_ + col];
     }
 
-    inline std::string Dump()
+    inline std::string Dump() const
     {
         std::ostringstream out;
         for (size_t i = 0; i < rows_; ++i) {
@@ -75,11 +140,156 @@ public:
         return out.str();
     }
 
+    // -----------------------------------------------------
+    //     Data Members
+    // -----------------------------------------------------
+
 protected:
 
-    value_type* data_;
-    size_t      rows_;
-    size_t      cols_;
+    std::vector<value_type> data_;
+    size_t                  rows_;
+    size_t                  cols_;
+};
+
+// =============================================================================
+//     Symmetric Matrix
+// =============================================================================
+
+/**
+ * @brief Symmetric square matrix that only stores its upper triangle, including the diagonal.
+ *
+ * Element access via operator() works as for Matrix, but the elements `(i, j)` and `(j, i)` refer
+ * to the same stored value. Thus, a matrix of size `n * n` only needs `n * (n + 1) / 2` values,
+ * which is about half the memory of a dense Matrix. Using `float` as `value_type` halves this
+ * again. A matrix can be converted to a different `value_type` using the converting constructor.
+ */
+template <typename value_type>
+class SymmetricMatrix
+{
+public:
+
+    // -----------------------------------------------------
+    //     Constructor and Rule of Five
+    // -----------------------------------------------------
+
+    SymmetricMatrix () : size_(0) {}
+
+    explicit SymmetricMatrix (size_t size) :
+        data_(size * (size + 1) / 2), size_(size)
+    {}
+
+    SymmetricMatrix (size_t size, value_type init) :
+        data_(size * (size + 1) / 2, init), size_(size)
+    {}
+
+    /**
+     * @brief Converting constructor that copies a matrix with a different `value_type`.
+     */
+    template <typename other_type>
+    explicit SymmetricMatrix (const SymmetricMatrix<other_type>& other) :
+        data_(other.PackedSize()), size_(other.Rows())
+    {
+        for (size_t i = 0; i < size_; ++i) {
+            for (size_t j = i; j < size_; ++j) {
+                data_[Index(i, j)] = static_cast<value_type>(other(i, j));
+            }
+        }
+    }
+
+    ~SymmetricMatrix () = default;
+
+    SymmetricMatrix (const SymmetricMatrix&) = default;
+    SymmetricMatrix (SymmetricMatrix&& other) :
+        data_(std::move(other.data_)), size_(other.size_)
+    {
+        other.size_ = 0;
+    }
+
+    SymmetricMatrix& operator= (const SymmetricMatrix&) = default;
+    SymmetricMatrix& operator= (SymmetricMatrix&& other)
+    {
+        swap(other);
+        return *this;
+    }
+
+    void swap (SymmetricMatrix& other)
+    {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+    }
+
+    // -----------------------------------------------------
+    //     Accessors
+    // -----------------------------------------------------
+
+    inline size_t Rows() const
+    {
+        return size_;
+    }
+
+    inline size_t Cols() const
+    {
+        return size_;
+    }
+
+    /**
+     * @brief Returns the number of elements of the matrix, as if it was stored densely.
+     */
+    inline size_t size() const
+    {
+        return size_ * size_;
+    }
+
+    /**
+     * @brief Returns the number of values that are actually stored.
+     */
+    inline size_t PackedSize() const
+    {
+        return data_.size();
+    }
+
+    inline value_type& operator () (const size_t row, const size_t col)
+    {
+        return data_[Index(row, col)];
+    }
+
+    inline const value_type operator () (const size_t row, const size_t col) const
+    {
+        return data_[Index(row, col)];
+    }
+
+    inline std::string Dump() const
+    {
+        std::ostringstream out;
+        for (size_t i = 0; i < size_; ++i) {
+            for (size_t j = 0; j < size_; ++j) {
+                out << data_[Index(i, j)] << " ";
+            }
+            out << "\n";
+        }
+        return out.str();
+    }
+
+    // -----------------------------------------------------
+    //     Data Members
+    // -----------------------------------------------------
+
+protected:
+
+    /**
+     * @brief Returns the position of an element in the packed storage. The rows of the upper
+     * triangle are stored consecutively, row `i` containing the columns `i` to `size - 1`.
+     */
+    inline size_t Index (size_t row, size_t col) const
+    {
+        if (row > col) {
+            std::swap(row, col);
+        }
+        return row * size_ - row * (row - 1) / 2 + col - row;
+    }
+
+    std::vector<value_type> data_;
+    size_t                  size_;
 };
 
 } // namespace genesis
@@ -0,0 +1,203 @@
+/**
+ * @brief Implementation of the Output Stream class.
+ *
+ * @file
+ * @ingroup utils
+ */
+
+#include "utils/output_stream.hpp"
+
+#include <assert.h>
+#include <cmath>
+#include <stdlib.h>
+
+#ifdef ZLIB
+#    include <zlib.h>
+#endif
+
+#include "utils/logging.hpp"
+
+namespace genesis {
+
+const size_t OutputStream::kBufferSize;
+const size_t OutputStream::kNumberSize;
+
+// =============================================================================
+//     Constructor and Target
+// =============================================================================
+
+OutputStream::OutputStream () :
+    buffer_(kBufferSize),
+    pos_(0),
+    failed_(false),
+    file_(nullptr),
+    string_(nullptr),
+    gzfile_(nullptr)
+{}
+
+/**
+ * @brief Destructor, which writes the remaining buffer to the target.
+ */
+OutputStream::~OutputStream ()
+{
+    Close();
+}
+
+/**
+ * @brief Opens a file as the target of the stream. Returns true iff successful.
+ *
+ * An existing file is overwritten. If `compress` is set, the file is written with gzip
+ * compression. This needs genesis to be compiled with `ZLIB`; otherwise, a warning is issued and
+ * false is returned.
+ */
+bool OutputStream::OpenFile (const std::string& fn, const bool compress)
+{
+    Close();
+    failed_ = false;
+
+    if (compress) {
+#ifdef ZLIB
+        gzfile_ = gzopen(fn.c_str(), "wb");
+        if (gzfile_ == nullptr) {
+            LOG_WARN << "Cannot write to file '" << fn << "'.";
+            return false;
+        }
+        return true;
+#else
+        LOG_WARN << "Cannot write compressed file '" << fn << "', "
+                 << "as genesis was compiled without zlib support.";
+        return false;
+#endif
+    }
+
+    file_ = fopen(fn.c_str(), "wb");
+    if (file_ == nullptr) {
+        LOG_WARN << "Cannot write to file '" << fn << "'.";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Uses a string as the target of the stream. The content is appended to the string.
+ */
+void OutputStream::OpenString (std::string& target)
+{
+    Close();
+    failed_ = false;
+    string_ = &target;
+}
+
+/**
+ * @brief Writes the remaining buffer to the target and closes it.
+ *
+ * Returns true iff all content was successfully written.
+ */
+bool OutputStream::Close ()
+{
+    Flush();
+    bool success = !failed_;
+
+    if (file_ != nullptr) {
+        success &= fclose(file_) == 0;
+        file_ = nullptr;
+    }
+#ifdef ZLIB
+    if (gzfile_ != nullptr) {
+        success &= gzclose(gzfile_) == Z_OK;
+        gzfile_ = nullptr;
+    }
+#endif
+    string_ = nullptr;
+
+    if (!success && !failed_) {
+        LOG_WARN << "Error while closing output file.";
+    }
+    failed_ = !success;
+    return success;
+}
+
+// =============================================================================
+//     Writing
+// =============================================================================
+
+/**
+ * @brief Writes an integer number.
+ */
+OutputStream& OutputStream::WriteInteger (const long value)
+{
+    char out[kNumberSize];
+    int  len = snprintf(out, kNumberSize, "%ld", value);
+    return Write(out, len);
+}
+
+/**
+ * @brief Writes a floating point number, using the shortest representation that is parsed back
+ * to the same value. See FormatDouble() for details.
+ */
+OutputStream& OutputStream::WriteDouble (const double value)
+{
+    char out[kNumberSize];
+    size_t len = FormatDouble(value, out);
+    return Write(out, len);
+}
+
+/**
+ * @brief Prints a floating point number into a buffer of at least 32 chars, using the shortest
+ * representation that is parsed back to the same value.
+ *
+ * The number is printed with `%.15g`, which drops trailing zeros, so that most values get their
+ * shortest form. Only if this does not round-trip, 16 and then 17 significant digits are tried,
+ * the latter of which is always exact. (Subnormal numbers might thus be printed with more digits
+ * than needed.) Returns the length of the representation, which is not null-terminated.
+ */
+size_t OutputStream::FormatDouble (const double value, char* out)
+{
+    int len = 0;
+    if (!std::isfinite(value)) {
+        len = snprintf(out, kNumberSize, "%g", value);
+    } else {
+        for (int precision = 15; precision <= 17; ++precision) {
+            len = snprintf(out, kNumberSize, "%.*g", precision, value);
+            if (strtod(out, nullptr) == value) {
+                break;
+            }
+        }
+    }
+    assert(len > 0 && static_cast<size_t>(len) < kNumberSize);
+    return len;
+}
+
+/**
+ * @brief Writes the buffer to the target and empties it.
+ */
+void OutputStream::Flush ()
+{
+    if (pos_ == 0) {
+        return;
+    }
+    const size_t len = pos_;
+    pos_ = 0;
+    if (failed_) {
+        return;
+    }
+
+    if (string_ != nullptr) {
+        string_->append(buffer_.data(), len);
+    } else if (file_ != nullptr) {
+        failed_ = fwrite(buffer_.data(), 1, len, file_) != len;
+#ifdef ZLIB
+    } else if (gzfile_ != nullptr) {
+        failed_ = gzwrite(gzfile_, buffer_.data(), len) != static_cast<int>(len);
+#endif
+    } else {
+        LOG_WARN << "Output stream has no target.";
+        failed_ = true;
+    }
+
+    if (failed_ && (file_ != nullptr || string_ != nullptr || IsCompressed())) {
+        LOG_WARN << "Error while writing to output file.";
+    }
+}
+
+} // namespace genesis
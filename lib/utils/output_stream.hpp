@@ -0,0 +1,132 @@
+#ifndef GENESIS_UTILS_OUTPUT_STREAM_H_
+#define GENESIS_UTILS_OUTPUT_STREAM_H_
+
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup utils
+ */
+
+#include <stdio.h>
+#include <string>
+#include <string.h>
+#include <vector>
+
+// Forward declaration of the zlib file handle, so that zlib.h is not needed here.
+struct gzFile_s;
+
+namespace genesis {
+
+// =============================================================================
+//     Output Stream
+// =============================================================================
+
+/**
+ * @brief Buffered sink for writing large outputs to a file or a string piece by piece.
+ *
+ * The content is collected in a fixed size buffer, which is written to the target whenever it is
+ * full. Thus, printers can write their output while traversing their data, without needing memory
+ * for the whole output at once.
+ *
+ * If compiled with `ZLIB`, files can also be written with gzip compression.
+ *
+ * Errors while writing are reported via LOG_WARN once. After that, all further output is discarded,
+ * and Close() returns false.
+ */
+class OutputStream
+{
+public:
+
+    // -----------------------------------------------------
+    //     Constructor and Target
+    // -----------------------------------------------------
+
+    OutputStream ();
+    ~OutputStream ();
+
+    OutputStream (const OutputStream&) = delete;
+    OutputStream& operator = (const OutputStream&) = delete;
+
+    bool OpenFile   (const std::string& fn, const bool compress = false);
+    void OpenString (std::string& target);
+    bool Close ();
+
+    /** @brief Returns whether the stream has a target and no error occured so far. */
+    inline bool good() const
+    {
+        return (file_ != nullptr || string_ != nullptr || IsCompressed()) && !failed_;
+    }
+
+    // -----------------------------------------------------
+    //     Writing
+    // -----------------------------------------------------
+
+    inline OutputStream& Write (const char c)
+    {
+        if (pos_ == buffer_.size()) {
+            Flush();
+        }
+        buffer_[pos_++] = c;
+        return *this;
+    }
+
+    inline OutputStream& Write (const char* data, size_t len)
+    {
+        while (pos_ + len > buffer_.size()) {
+            const size_t part = buffer_.size() - pos_;
+            memcpy(buffer_.data() + pos_, data, part);
+            pos_ += part;
+            data += part;
+            len  -= part;
+            Flush();
+        }
+        memcpy(buffer_.data() + pos_, data, len);
+        pos_ += len;
+        return *this;
+    }
+
+    inline OutputStream& Write (const std::string& str)
+    {
+        return Write(str.data(), str.size());
+    }
+
+    OutputStream& WriteInteger (const long   value);
+    OutputStream& WriteDouble  (const double value);
+
+    static size_t FormatDouble (const double value, char* out);
+
+    // -----------------------------------------------------
+    //     Internal Members
+    // -----------------------------------------------------
+
+protected:
+
+    void Flush ();
+
+    inline bool IsCompressed() const
+    {
+        return gzfile_ != nullptr;
+    }
+
+    /** @brief Size of the buffer that is collected before writing to the target. */
+    static const size_t kBufferSize = 1 << 16;
+
+    /** @brief Maximal number of chars needed by WriteInteger() and FormatDouble(). */
+    static const size_t kNumberSize = 32;
+
+    std::vector<char> buffer_;
+    size_t            pos_;
+    bool              failed_;
+
+    FILE*             file_;
+    std::string*      string_;
+
+    // only used if compiled with ZLIB, but always declared, so that the layout of this class
+    // does not depend on how the code using it is compiled.
+    gzFile_s*         gzfile_;
+};
+
+} // namespace genesis
+
+#endif // include guard
@@ -0,0 +1,409 @@
+/**
+ * @brief Benchmark program for the placement functions of genesis.
+ *
+ * The program generates random reference trees and placement samples of different sizes, and
+ * measures the time needed by the main placement functions on them, for different numbers of
+ * threads. The results are written as a JSON document, so that they can be compared between
+ * releases.
+ *
+ * Usage:
+ *
+ *     genesis_benchmark [options]
+ *
+ *     --taxa     <list>   Comma separated numbers of taxa of the trees.       Default: 100,1000
+ *     --pqueries <list>   Comma separated numbers of pqueries per sample.     Default: 1000,10000
+ *     --threads  <list>   Comma separated numbers of threads.                 Default: 1
+ *     --repeats  <n>      Number of repetitions of each measurement.          Default: 3
+ *     --seed     <n>      Seed for the random trees and samples.              Default: 0
+ *     --out      <file>   Write the JSON result to this file instead of stdout.
+ *
+ * Progress is logged to stderr, so that stdout only contains the JSON result. Numbers of threads
+ * larger than 1 need genesis to be compiled with `PTHREADS`, see the `BENCHMARK_PTHREADS` option
+ * of CMake.
+ *
+ * @file
+ * @ingroup main
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "placement/bplace_processor.hpp"
+#include "placement/edge_pca.hpp"
+#include "placement/jplace_processor.hpp"
+#include "placement/placement_filter.hpp"
+#include "placement/placement_map.hpp"
+#include "placement/simulator.hpp"
+#include "placement/squash_clustering.hpp"
+#include "tree/newick_processor.hpp"
+#include "utils/json_document.hpp"
+#include "utils/json_processor.hpp"
+#include "utils/logging.hpp"
+#include "utils/matrix.hpp"
+#include "utils/options.hpp"
+#include "utils/utils.hpp"
+
+using namespace genesis;
+
+// =============================================================================
+//     Settings
+// =============================================================================
+
+/**
+ * @brief Settings of the benchmark, as given on the command line.
+ */
+struct BenchmarkSettings
+{
+    std::vector<size_t> taxa     { 100, 1000 };
+    std::vector<size_t> pqueries { 1000, 10000 };
+    std::vector<size_t> threads  { 1 };
+    size_t              repeats  = 3;
+    unsigned long       seed     = 0;
+    std::string         out;
+};
+
+/**
+ * @brief Parses a comma separated list of numbers.
+ */
+std::vector<size_t> parse_list (const std::string& str)
+{
+    std::vector<size_t> res;
+    size_t pos = 0;
+    while (pos < str.size()) {
+        size_t end = str.find(',', pos);
+        if (end == std::string::npos) {
+            end = str.size();
+        }
+        res.push_back(std::stoul(str.substr(pos, end - pos)));
+        pos = end + 1;
+    }
+    return res;
+}
+
+/**
+ * @brief Parses the command line into the settings. Returns false on invalid arguments.
+ */
+bool parse_arguments (int argc, char* argv[], BenchmarkSettings& settings)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            LOG_WARN << "Missing value for argument '" << arg << "'.";
+            return false;
+        }
+        std::string val = argv[++i];
+
+        if (arg == "--taxa") {
+            settings.taxa = parse_list(val);
+        } else if (arg == "--pqueries") {
+            settings.pqueries = parse_list(val);
+        } else if (arg == "--threads") {
+            settings.threads = parse_list(val);
+        } else if (arg == "--repeats") {
+            settings.repeats = std::max(std::stoul(val), 1ul);
+        } else if (arg == "--seed") {
+            settings.seed = std::stoul(val);
+        } else if (arg == "--out") {
+            settings.out = val;
+        } else {
+            LOG_WARN << "Unknown argument '" << arg << "'.";
+            return false;
+        }
+    }
+
+#ifndef PTHREADS
+    for (size_t threads : settings.threads) {
+        if (threads > 1) {
+            LOG_WARN << "Cannot use " << threads << " threads, "
+                     << "as genesis was compiled without PTHREADS.";
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+// =============================================================================
+//     Data Generation
+// =============================================================================
+
+/**
+ * @brief Returns a random binary tree with `taxa` many leaves in Newick format.
+ *
+ * The tree is built by repeatedly joining two random subtrees. Branch lengths are uniformly
+ * distributed in (0, 1], and all edges get an edge_num tag, as needed for a PlacementTree.
+ */
+std::string random_tree (const size_t taxa, const unsigned long seed)
+{
+    std::mt19937_64 engine (seed);
+    std::uniform_real_distribution<double> length (0.0, 1.0);
+
+    std::vector<std::string> subtrees;
+    for (size_t i = 0; i < taxa; ++i) {
+        subtrees.push_back("t" + std::to_string(i));
+    }
+
+    size_t edge_num = 0;
+    auto with_edge = [&] (const std::string& subtree) {
+        return subtree + ":" + ToStringPrecise(1.0 - length(engine), 6)
+             + "{" + std::to_string(edge_num++) + "}";
+    };
+
+    // join subtrees until three are left, which form the trifurcation at the root.
+    while (subtrees.size() > 3) {
+        std::uniform_int_distribution<size_t> pick (0, subtrees.size() - 1);
+        size_t a = pick(engine);
+        std::swap(subtrees[a], subtrees.back());
+        std::string lhs = subtrees.back();
+        subtrees.pop_back();
+
+        std::uniform_int_distribution<size_t> pick2 (0, subtrees.size() - 1);
+        size_t b = pick2(engine);
+        std::string rhs = subtrees[b];
+        subtrees[b] = "(" + with_edge(lhs) + "," + with_edge(rhs) + ")";
+    }
+
+    std::string res = "(";
+    for (size_t i = 0; i < subtrees.size(); ++i) {
+        res += (i > 0 ? "," : "") + with_edge(subtrees[i]);
+    }
+    return res + ");";
+}
+
+/**
+ * @brief Fills a PlacementMap with a random tree and `n` many random pqueries.
+ */
+void random_sample (
+    const std::string&  tree,
+    const size_t        n,
+    const unsigned long seed,
+    PlacementMap&       map
+) {
+    map.clear();
+    NewickProcessor::FromString(tree, map.tree);
+
+    PlacementSimulator sim;
+    sim.seed = seed;
+    sim.placement_count.type = PlacementSimulator::DistributionType::kUniform;
+    sim.placement_count.a    = 0.5;
+    sim.placement_count.b    = 3.5;
+    sim.Generate(map, n);
+}
+
+// =============================================================================
+//     Measurement
+// =============================================================================
+
+/**
+ * @brief Runs a function `repeats` many times and adds the timings as a result to the JSON array.
+ *
+ * The given function is called before each repetition to prepare the input data, which is thus not
+ * part of the measurement. It returns the function that is then timed.
+ */
+void measure (
+    JsonValueArray*                                    results,
+    const std::string&                                 name,
+    const size_t                                       taxa,
+    const size_t                                       pqueries,
+    const size_t                                       threads,
+    const size_t                                       repeats,
+    const std::function<std::function<void ()> ()>&    prepare
+) {
+    std::vector<double> times;
+    for (size_t r = 0; r < repeats; ++r) {
+        std::function<void ()> run = prepare();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end   = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double>(end - start).count());
+    }
+    std::sort(times.begin(), times.end());
+
+    double sum = 0.0;
+    for (double t : times) {
+        sum += t;
+    }
+
+    JsonValueObject* obj = new JsonValueObject();
+    obj->Set("name",     new JsonValueString(name));
+    obj->Set("taxa",     new JsonValueNumber(taxa));
+    obj->Set("pqueries", new JsonValueNumber(pqueries));
+    obj->Set("threads",  new JsonValueNumber(threads));
+    obj->Set("repeats",  new JsonValueNumber(repeats));
+    obj->Set("min",      new JsonValueNumber(times.front()));
+    obj->Set("median",   new JsonValueNumber(times[times.size() / 2]));
+    obj->Set("mean",     new JsonValueNumber(sum / times.size()));
+    obj->Set("max",      new JsonValueNumber(times.back()));
+    results->push_back(obj);
+
+    LOG_INFO << name << " (taxa " << taxa << ", pqueries " << pqueries << ", threads "
+             << threads << "): " << times.front() << "s";
+}
+
+/**
+ * @brief Runs all measurements for one combination of tree size, sample size and threads.
+ */
+void run_benchmarks (
+    JsonValueArray*          results,
+    const BenchmarkSettings& settings,
+    const size_t             taxa,
+    const size_t             pqueries,
+    const size_t             threads
+) {
+    const size_t repeats = settings.repeats;
+    const std::string tree = random_tree(taxa, settings.seed);
+
+    PlacementMap sample_a, sample_b;
+    random_sample(tree, pqueries, settings.seed + 1, sample_a);
+    random_sample(tree, pqueries, settings.seed + 2, sample_b);
+    const std::string jplace = JplaceProcessor::ToString(sample_a);
+    const std::string bplace = BplaceProcessor::ToString(sample_a);
+
+    // the functions that are measured operate on a copy of the sample if they change it. the
+    // copy is made in the preparation step, so that it is not included in the measurement.
+    auto bench = [&] (const std::string& name, const std::function<std::function<void ()> ()>& prep) {
+        measure(results, name, taxa, pqueries, threads, repeats, prep);
+    };
+    std::shared_ptr<PlacementMap> tmp;
+
+    bench("JplaceParse", [&] () {
+        tmp = std::make_shared<PlacementMap>();
+        return [&] () { JplaceProcessor::FromString(jplace, *tmp); };
+    });
+    bench("JplaceWrite", [&] () {
+        return [&] () { JplaceProcessor::ToString(sample_a); };
+    });
+    bench("BplaceParse", [&] () {
+        tmp = std::make_shared<PlacementMap>();
+        return [&] () { BplaceProcessor::FromString(bplace, *tmp); };
+    });
+    bench("BplaceWrite", [&] () {
+        return [&] () { BplaceProcessor::ToString(sample_a); };
+    });
+    bench("Simulate", [&] () {
+        tmp = std::make_shared<PlacementMap>();
+        NewickProcessor::FromString(tree, tmp->tree);
+        return [&] () {
+            PlacementSimulator sim;
+            sim.seed = settings.seed;
+            sim.Generate(*tmp, pqueries);
+        };
+    });
+    bench("Merge", [&] () {
+        tmp = std::make_shared<PlacementMap>(sample_a);
+        return [&] () { tmp->Merge(sample_b); };
+    });
+    bench("NormalizeWeightRatios", [&] () {
+        tmp = std::make_shared<PlacementMap>(sample_a);
+        return [&] () { tmp->NormalizeWeightRatios(); };
+    });
+    bench("RestrainToMaxWeightPlacements", [&] () {
+        tmp = std::make_shared<PlacementMap>(sample_a);
+        return [&] () { tmp->RestrainToMaxWeightPlacements(); };
+    });
+    bench("Filter", [&] () {
+        tmp = std::make_shared<PlacementMap>(sample_a);
+        return [&] () {
+            PlacementFilter filter;
+            filter.min_weight_ratio       = 0.05;
+            filter.max_count              = 2;
+            filter.max_accumulated_weight = 0.95;
+            filter.normalize              = true;
+            filter.Apply(*tmp);
+        };
+    });
+    bench("EMD", [&] () {
+        return [&] () { PlacementMap::EMD(sample_a, sample_b); };
+    });
+    bench("EMDMatrix", [&] () {
+        return [&] () {
+            std::vector<const PlacementMap*> maps { &sample_a, &sample_b, &sample_a, &sample_b };
+            PlacementMap::EMDMatrix(maps);
+        };
+    });
+    bench("SquashClustering", [&] () {
+        return [&] () {
+            std::vector<const PlacementMap*> maps { &sample_a, &sample_b, &sample_a, &sample_b };
+            SquashClustering clustering;
+            clustering.Run(maps);
+        };
+    });
+    bench("EdgePCA", [&] () {
+        return [&] () {
+            std::vector<const PlacementMap*> maps { &sample_a, &sample_b, &sample_a, &sample_b };
+            EdgePCA pca;
+            pca.Run(maps);
+        };
+    });
+    bench("Variance", [&] () {
+        return [&] () { sample_a.Variance(); };
+    });
+    if (sample_a.PlacementCount() <= 20000) {
+        bench("VariancePairwise", [&] () {
+            return [&] () { sample_a.VariancePairwise(); };
+        });
+    }
+    bench("ClosestLeafDepthHistogram", [&] () {
+        return [&] () { sample_a.ClosestLeafDepthHistogram(); };
+    });
+    bench("ClosestLeafDistanceHistogram", [&] () {
+        return [&] () { sample_a.ClosestLeafDistanceHistogram(0.0, 1.0, 25); };
+    });
+    bench("ClosestLeafDistanceHistogramAuto", [&] () {
+        return [&] () {
+            double min, max;
+            sample_a.ClosestLeafDistanceHistogramAuto(min, max, 25);
+        };
+    });
+}
+
+// =============================================================================
+//     Main
+// =============================================================================
+
+int main (int argc, char* argv[])
+{
+    // stdout is reserved for the JSON result.
+    Logging::LogToStream(std::cerr);
+    Logging::max_level(Logging::kInfo);
+    Options::Init(argc, argv);
+
+    BenchmarkSettings settings;
+    if (!parse_arguments(argc, argv, settings)) {
+        return 1;
+    }
+
+    JsonDocument doc;
+    JsonValueArray* results = new JsonValueArray();
+
+#ifdef PTHREADS
+    doc.Set("pthreads", new JsonValueBool(true));
+#else
+    doc.Set("pthreads", new JsonValueBool(false));
+#endif
+    doc.Set("seed",     new JsonValueNumber(settings.seed));
+    doc.Set("results",  results);
+
+    for (size_t taxa : settings.taxa) {
+        for (size_t pqueries : settings.pqueries) {
+            for (size_t threads : settings.threads) {
+                Options::number_of_threads = threads;
+                run_benchmarks(results, settings, taxa, pqueries, threads);
+            }
+        }
+    }
+
+    JsonProcessor::precision = 9;
+    if (settings.out.empty()) {
+        std::cout << JsonProcessor::ToString(doc) << std::endl;
+    } else if (!FileWrite(settings.out, JsonProcessor::ToString(doc))) {
+        return 1;
+    }
+    return 0;
+}
@@ -483,23 +483,12 @@ int main (int argc, char* argv[])
         //~ LOG_DBG1 << s;
     //~ }
 
-    PlacementMap place, place_tmp;
-    LOG_DBG;
-    LOG_DBG << "Reading file " << list[0] << "...";
-    JplaceProcessor::FromFile(inpath + list[0], place);
-    //~ LOG_DBG << "Valid: " << place.Validate();
-    LOG_DBG << "with " << place.PlacementCount() << " placements.";
-    LOG_DBG;
-
-    for (size_t i = 1; i < list.size(); ++i) {
-        LOG_DBG1 << "Reading file " << list[i] << "...";
-        JplaceProcessor::FromFile(inpath + list[i], place_tmp);
-        LOG_DBG1 << "...with " << place_tmp.PlacementCount() << " placements...";
-
-        LOG_DBG1 << "... and merging it.";
-        place.Merge(place_tmp);
-        LOG_DBG1;
+    PlacementMap place;
+    LOG_DBG << "Reading and merging files...";
+    for (std::string& fn : list) {
+        fn = inpath + fn;
     }
+    place.MergeFiles(list);
 
     LOG_DBG << "Total of " << place.PlacementCount() << " placements.";
     //~ LOG_DBG << "Validating...";
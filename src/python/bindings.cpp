@@ -6,6 +6,7 @@
  */
 
 #include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
 
 // =============================================================================
 //     Forward declarations of all exported classes
@@ -15,6 +16,7 @@
     //     Placement
     // -------------------------------------------
 
+void BoostPythonExport_BplaceProcessor();
 void BoostPythonExport_JplaceProcessor();
 void BoostPythonExport_PlacementMap();
 void BoostPythonExport_PlacementTree();
@@ -36,10 +38,14 @@ BOOST_PYTHON_MODULE(genesis)
     // show genesis docstrings, python signature, but not c++ signature
     boost::python::docstring_options doc_options(true, true, false);
 
+    // needed for all functions that return numpy arrays
+    boost::python::numpy::initialize();
+
     // -------------------------------------------
     //     Placement
     // -------------------------------------------
 
+    BoostPythonExport_BplaceProcessor();
     BoostPythonExport_JplaceProcessor();
     BoostPythonExport_PlacementMap();
     BoostPythonExport_PlacementTree();
@@ -0,0 +1,50 @@
+/**
+ * @brief
+ *
+ * @file
+ * @ingroup python
+ */
+
+#include <boost/python.hpp>
+
+#include "placement/bplace_processor.hpp"
+#include "placement/placement_map.hpp"
+
+void BoostPythonExport_BplaceProcessor()
+{
+
+    boost::python::class_< ::genesis::BplaceProcessor > ( "BplaceProcessor" )
+
+        // Public Member Functions
+
+        .def(
+            "GetVersion",
+            ( std::string ( * )(  ))( &::genesis::BplaceProcessor::GetVersion ),
+            "Returns the version number of the binary format that this class writes."
+        )
+        .staticmethod("GetVersion")
+        .def(
+            "CheckVersion",
+            ( bool ( * )( const std::string ))( &::genesis::BplaceProcessor::CheckVersion ),
+            ( boost::python::arg("version") ),
+            "Checks whether the version of the binary format works with this parser."
+        )
+        .staticmethod("CheckVersion")
+        .def(
+            "FromFile",
+            ( bool ( * )( const std::string &, ::genesis::PlacementMap & ))( &::genesis::BplaceProcessor::FromFile ),
+            ( boost::python::arg("fn"), boost::python::arg("placements") ),
+            "Reads a file in the binary format into a PlacementMap object."
+        )
+        .staticmethod("FromFile")
+
+        .def(
+            "ToFile",
+            ( bool ( * )( const std::string, const ::genesis::PlacementMap & ))( &::genesis::BplaceProcessor::ToFile ),
+            ( boost::python::arg("fn"), boost::python::arg("placements") ),
+            "Writes a PlacementMap to a file in the binary format."
+        )
+        .staticmethod("ToFile")
+    ;
+
+}
@@ -57,8 +57,8 @@ void BoostPythonExport_JplaceProcessor()
         .staticmethod("FromDocument")
         .def(
             "ToFile",
-            ( bool ( * )( const std::string, const ::genesis::PlacementMap & ))( &::genesis::JplaceProcessor::ToFile ),
-            ( boost::python::arg("fn"), boost::python::arg("placements") )
+            ( bool ( * )( const std::string, const ::genesis::PlacementMap &, const bool ))( &::genesis::JplaceProcessor::ToFile ),
+            ( boost::python::arg("fn"), boost::python::arg("placements"), boost::python::arg("compress")=false )
         )
         .staticmethod("ToFile")
         .def(
@@ -120,8 +120,8 @@ void BoostPythonExport_JplaceProcessor()
 
         .def(
             "ToFile",
-            ( bool ( * )( const std::string, const ::genesis::PlacementMap & ))( &::genesis::JplaceProcessor::ToFile ),
-            ( boost::python::arg("fn"), boost::python::arg("placements") )
+            ( bool ( * )( const std::string, const ::genesis::PlacementMap &, const bool ))( &::genesis::JplaceProcessor::ToFile ),
+            ( boost::python::arg("fn"), boost::python::arg("placements"), boost::python::arg("compress")=false )
         )
         .staticmethod("ToFile")
         .def(
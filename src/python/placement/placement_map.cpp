@@ -6,8 +6,187 @@
  */
 
 #include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+#include <vector>
 
 #include "placement/placement_map.hpp"
+#include "placement/pquery.hpp"
+
+#include "../utils/numpy.hpp"
+
+namespace np = boost::python::numpy;
+
+// =============================================================================
+//     Columnar Data
+// =============================================================================
+
+/**
+ * @brief Returns the placements of the map as a dict of NumPy arrays, with one entry per placement.
+ *
+ * The arrays are collected in one pass over the pqueries while the GIL is released, and are then
+ * handed to NumPy without copying them again.
+ */
+boost::python::dict PlacementMap_PlacementColumns (const ::genesis::PlacementMap& map)
+{
+    std::vector<unsigned long> pquery;
+    std::vector<int>           edge_num;
+    std::vector<double>        like_weight_ratio;
+    std::vector<double>        proximal_length;
+    std::vector<double>        pendant_length;
+    std::vector<double>        likelihood;
+
+    {
+        ScopedGilRelease release;
+
+        const size_t count = map.PlacementCount();
+        pquery.reserve(count);
+        edge_num.reserve(count);
+        like_weight_ratio.reserve(count);
+        proximal_length.reserve(count);
+        pendant_length.reserve(count);
+        likelihood.reserve(count);
+
+        for (size_t i = 0; i < map.pqueries.size(); ++i) {
+            for (const ::genesis::PqueryPlacement* place : map.pqueries[i]->placements) {
+                pquery.push_back(i);
+                edge_num.push_back(place->edge_num);
+                like_weight_ratio.push_back(place->like_weight_ratio);
+                proximal_length.push_back(place->proximal_length);
+                pendant_length.push_back(place->pendant_length);
+                likelihood.push_back(place->likelihood);
+            }
+        }
+    }
+
+    boost::python::dict result;
+    result["pquery"]            = VectorToNumpy(std::move(pquery));
+    result["edge_num"]          = VectorToNumpy(std::move(edge_num));
+    result["like_weight_ratio"] = VectorToNumpy(std::move(like_weight_ratio));
+    result["proximal_length"]   = VectorToNumpy(std::move(proximal_length));
+    result["pendant_length"]    = VectorToNumpy(std::move(pendant_length));
+    result["likelihood"]        = VectorToNumpy(std::move(likelihood));
+    return result;
+}
+
+/**
+ * @brief Returns the edges of the tree of the map as a dict of NumPy arrays, indexed by
+ * Edge::Index().
+ */
+boost::python::dict PlacementMap_EdgeColumns (const ::genesis::PlacementMap& map)
+{
+    const size_t count = map.tree.EdgeCount();
+    std::vector<int>           edge_num        (count);
+    std::vector<double>        branch_length   (count);
+    std::vector<unsigned long> placement_count (count);
+    std::vector<double>        placement_mass  (count, 0.0);
+
+    {
+        ScopedGilRelease release;
+
+        for (size_t i = 0; i < count; ++i) {
+            const ::genesis::PlacementTree::EdgeType* edge = map.tree.EdgeAt(i);
+            edge_num[i]        = edge->edge_num;
+            branch_length[i]   = edge->branch_length;
+            placement_count[i] = edge->placements.size();
+            for (const ::genesis::PqueryPlacement* place : edge->placements) {
+                placement_mass[i] += place->like_weight_ratio;
+            }
+        }
+    }
+
+    boost::python::dict result;
+    result["edge_num"]        = VectorToNumpy(std::move(edge_num));
+    result["branch_length"]   = VectorToNumpy(std::move(branch_length));
+    result["placement_count"] = VectorToNumpy(std::move(placement_count));
+    result["placement_mass"]  = VectorToNumpy(std::move(placement_mass));
+    return result;
+}
+
+// =============================================================================
+//     Analysis
+// =============================================================================
+
+// The following wrappers release the GIL while the calculation runs, and return NumPy arrays
+// instead of lists.
+
+np::ndarray PlacementMap_ClosestLeafDepthHistogram (const ::genesis::PlacementMap& map)
+{
+    std::vector<int> hist;
+    {
+        ScopedGilRelease release;
+        hist = map.ClosestLeafDepthHistogram();
+    }
+    return VectorToNumpy(std::move(hist));
+}
+
+np::ndarray PlacementMap_ClosestLeafDistanceHistogram (
+    const ::genesis::PlacementMap& map, const double min, const double max, const int bins
+) {
+    std::vector<int> hist;
+    {
+        ScopedGilRelease release;
+        hist = map.ClosestLeafDistanceHistogram(min, max, bins);
+    }
+    return VectorToNumpy(std::move(hist));
+}
+
+/**
+ * @brief Returns a tuple of the histogram and the boundaries that were determined for it.
+ */
+boost::python::tuple PlacementMap_ClosestLeafDistanceHistogramAuto (
+    const ::genesis::PlacementMap& map, const int bins
+) {
+    std::vector<int> hist;
+    double min, max;
+    {
+        ScopedGilRelease release;
+        hist = map.ClosestLeafDistanceHistogramAuto(min, max, bins);
+    }
+    return boost::python::make_tuple(VectorToNumpy(std::move(hist)), min, max);
+}
+
+double PlacementMap_EMD (
+    const ::genesis::PlacementMap& map, const ::genesis::PlacementMap& other,
+    const bool with_pendant_length
+) {
+    ScopedGilRelease release;
+    return map.EMD(other, with_pendant_length);
+}
+
+/**
+ * @brief Returns the pairwise EMDs between the maps of a Python sequence as a NumPy array.
+ */
+np::ndarray PlacementMap_EMDMatrix (
+    const boost::python::object& maps, const bool with_pendant_length
+) {
+    std::vector<const ::genesis::PlacementMap*> pointers;
+    for (boost::python::ssize_t i = 0; i < boost::python::len(maps); ++i) {
+        pointers.push_back(&boost::python::extract<const ::genesis::PlacementMap&>(maps[i])());
+    }
+
+    ::genesis::SymmetricMatrix<double> result;
+    {
+        ScopedGilRelease release;
+        result = ::genesis::PlacementMap::EMDMatrix(pointers, with_pendant_length);
+    }
+    return MatrixToNumpy(result);
+}
+
+double PlacementMap_Variance (const ::genesis::PlacementMap& map)
+{
+    ScopedGilRelease release;
+    return map.Variance();
+}
+
+double PlacementMap_VariancePairwise (const ::genesis::PlacementMap& map)
+{
+    ScopedGilRelease release;
+    return map.VariancePairwise();
+}
+
+// =============================================================================
+//     Class PlacementMap
+// =============================================================================
 
 void BoostPythonExport_PlacementMap()
 {
@@ -52,29 +231,46 @@ void BoostPythonExport_PlacementMap()
             ( double ( ::genesis::PlacementMap::* )(  ) const )( &::genesis::PlacementMap::PlacementMass ),
             "Get the summed mass of all placements on the tree, given by their like_weight_ratio."
         )
+        .def(
+            "PlacementColumns",
+            &PlacementMap_PlacementColumns,
+            "Returns a dict of NumPy arrays with the pquery index, edge_num, like_weight_ratio, proximal_length, pendant_length and likelihood of all placements."
+        )
+        .def(
+            "EdgeColumns",
+            &PlacementMap_EdgeColumns,
+            "Returns a dict of NumPy arrays with the edge_num, branch_length, placement count and placement mass of all edges, indexed by edge index."
+        )
         .def(
             "ClosestLeafDepthHistogram",
-            ( std::vector< int > ( ::genesis::PlacementMap::* )(  ) const )( &::genesis::PlacementMap::ClosestLeafDepthHistogram ),
+            &PlacementMap_ClosestLeafDepthHistogram,
             "Returns a histogram representing how many placements have which depth with respect to their closest leaf node."
         )
         .def(
             "ClosestLeafDistanceHistogram",
-            ( std::vector< int > ( ::genesis::PlacementMap::* )( const double, const double, const int ) const )( &::genesis::PlacementMap::ClosestLeafDistanceHistogram ),
+            &PlacementMap_ClosestLeafDistanceHistogram,
             ( boost::python::arg("min"), boost::python::arg("max"), boost::python::arg("bins")=(const int)(10) ),
             "Returns a histogram counting the number of placements that have a certain distance to their closest leaf node, divided into equally large intervals between a min and a max distance."
         )
         .def(
             "ClosestLeafDistanceHistogramAuto",
-            ( std::vector< int > ( ::genesis::PlacementMap::* )( double &, double &, const int ) const )( &::genesis::PlacementMap::ClosestLeafDistanceHistogramAuto ),
-            ( boost::python::arg("min"), boost::python::arg("max"), boost::python::arg("bins")=(const int)(10) ),
-            "Returns the same type of histogram as ClosestLeafDistanceHistogram(), but automatically determines the needed boundaries."
+            &PlacementMap_ClosestLeafDistanceHistogramAuto,
+            ( boost::python::arg("bins")=(const int)(10) ),
+            "Returns the same type of histogram as ClosestLeafDistanceHistogram(), but automatically determines the needed boundaries. Returns a tuple of the histogram, min and max."
         )
         .def(
             "EMD",
-            ( double ( ::genesis::PlacementMap::* )( const ::genesis::PlacementMap &, const bool ) const )( &::genesis::PlacementMap::EMD ),
+            &PlacementMap_EMD,
             ( boost::python::arg("other"), boost::python::arg("with_pendant_length")=(const bool)(true) ),
             "Calculates the Earth Movers Distance to another sets of placements on a fixed reference tree."
         )
+        .def(
+            "EMDMatrix",
+            &PlacementMap_EMDMatrix,
+            ( boost::python::arg("maps"), boost::python::arg("with_pendant_length")=(const bool)(true) ),
+            "Calculates the pairwise Earth Movers Distances between a list of sets of placements on a fixed reference tree, and returns them as a NumPy array."
+        )
+        .staticmethod("EMDMatrix")
         .def(
             "COG",
             ( void ( ::genesis::PlacementMap::* )(  ) const )( &::genesis::PlacementMap::COG ),
@@ -82,9 +278,14 @@ void BoostPythonExport_PlacementMap()
         )
         .def(
             "Variance",
-            ( double ( ::genesis::PlacementMap::* )(  ) const )( &::genesis::PlacementMap::Variance ),
+            &PlacementMap_Variance,
             "Calculate the Variance of the placements on a tree."
         )
+        .def(
+            "VariancePairwise",
+            &PlacementMap_VariancePairwise,
+            "Calculate the Variance of the placements on a tree, using a pairwise comparison of all placements."
+        )
         .def(
             "Dump",
             ( std::string ( ::genesis::PlacementMap::* )(  ) const )( &::genesis::PlacementMap::Dump ),
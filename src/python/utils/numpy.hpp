@@ -0,0 +1,114 @@
+#ifndef GENESIS_PYTHON_UTILS_NUMPY_H_
+#define GENESIS_PYTHON_UTILS_NUMPY_H_
+
+/**
+ * @brief Helper functions for exchanging data with NumPy and for releasing the GIL.
+ *
+ * @file
+ * @ingroup python
+ */
+
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+#include <utility>
+#include <vector>
+
+#include "utils/matrix.hpp"
+
+// =============================================================================
+//     GIL
+// =============================================================================
+
+/**
+ * @brief Releases the Python Global Interpreter Lock for the lifetime of this object.
+ *
+ * Use this in wrapper functions around long-running calculations, so that other Python threads
+ * can run in the meantime. The wrapped code must not access any Python objects.
+ */
+class ScopedGilRelease
+{
+public:
+    ScopedGilRelease () : state_(PyEval_SaveThread()) {}
+
+    ~ScopedGilRelease ()
+    {
+        PyEval_RestoreThread(state_);
+    }
+
+    ScopedGilRelease (const ScopedGilRelease&) = delete;
+    ScopedGilRelease& operator = (const ScopedGilRelease&) = delete;
+
+private:
+    PyThreadState* state_;
+};
+
+// =============================================================================
+//     NumPy Arrays
+// =============================================================================
+
+/**
+ * @brief Returns a Python object that owns the given heap object and deletes it when it is
+ * garbage collected.
+ */
+template <typename T>
+boost::python::object NumpyOwner (T* ptr)
+{
+    PyObject* capsule = PyCapsule_New(ptr, nullptr, [] (PyObject* cap) {
+        delete static_cast<T*>(PyCapsule_GetPointer(cap, nullptr));
+    });
+    return boost::python::object(boost::python::handle<>(capsule));
+}
+
+/**
+ * @brief Moves a vector into a one-dimensional NumPy array, without copying its elements.
+ *
+ * The array uses the memory of the vector, which is kept alive for as long as the array exists.
+ */
+template <typename T>
+boost::python::numpy::ndarray VectorToNumpy (std::vector<T>&& vec)
+{
+    std::vector<T>* owner = new std::vector<T>(std::move(vec));
+    return boost::python::numpy::from_data(
+        owner->data(),
+        boost::python::numpy::dtype::get_builtin<T>(),
+        boost::python::make_tuple(owner->size()),
+        boost::python::make_tuple(sizeof(T)),
+        NumpyOwner(owner)
+    );
+}
+
+/**
+ * @brief Moves a Matrix into a two-dimensional NumPy array, without copying its elements.
+ *
+ * The array uses the memory of the matrix, which is kept alive for as long as the array exists.
+ */
+template <typename T>
+boost::python::numpy::ndarray MatrixToNumpy (::genesis::Matrix<T>&& mat)
+{
+    ::genesis::Matrix<T>* owner = new ::genesis::Matrix<T>(std::move(mat));
+    return boost::python::numpy::from_data(
+        owner->data(),
+        boost::python::numpy::dtype::get_builtin<T>(),
+        boost::python::make_tuple(owner->Rows(), owner->Cols()),
+        boost::python::make_tuple(owner->Cols() * sizeof(T), sizeof(T)),
+        NumpyOwner(owner)
+    );
+}
+
+/**
+ * @brief Copies a SymmetricMatrix into a two-dimensional NumPy array, as the packed storage of the
+ * matrix cannot be represented by NumPy.
+ */
+template <typename T>
+boost::python::numpy::ndarray MatrixToNumpy (const ::genesis::SymmetricMatrix<T>& mat)
+{
+    ::genesis::Matrix<T> dense (mat.Rows(), mat.Cols());
+    for (size_t i = 0; i < mat.Rows(); ++i) {
+        for (size_t j = 0; j < mat.Cols(); ++j) {
+            dense(i, j) = mat(i, j);
+        }
+    }
+    return MatrixToNumpy(std::move(dense));
+}
+
+#endif // include guard